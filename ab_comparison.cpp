@@ -0,0 +1,133 @@
+#include "ab_comparison.h"
+
+#include <vector>
+
+#include "retire_queue.h"
+
+// Frames between full frame measurements of both sides.
+static const unsigned measure_interval = 60;
+
+void ab_comparison::replace_pinned(const quad_program& program, const std::string& name, uint64_t topology)
+{
+   retire_program(pinned.program);
+   pinned = program;
+   pinned_name = name;
+   pinned_topology = topology;
+   ++pin;
+}
+
+void ab_comparison::destroy()
+{
+   glDeleteProgram(pinned.program);
+   pinned = {};
+}
+
+void ab_drawing::destroy()
+{
+   timers[0].destroy();
+   timers[1].destroy();
+   targets[0].destroy();
+   targets[1].destroy();
+   measure_timer.destroy();
+}
+
+void ab_drawing::set_mode(ab_mode next)
+{
+   if (next == mode)
+      return;
+   if (next != ab_mode::off)
+   {
+      timers[0].init();
+      timers[1].init();
+   }
+   mode = next;
+}
+
+void ab_drawing::measure(const quad_program* sides[2], unsigned pin, const frame_values& values, GLuint framebuffer)
+{
+   if (!targets[0].fbo)
+   {
+      targets[0].init({ GL_RGBA8 });
+      targets[1].init({ GL_RGBA8 });
+      measure_timer.init(2);
+   }
+   for (int i = 0; i < 2; ++i)
+   {
+      targets[i].resize(values.width, values.height);
+      targets[i].bind();
+      glUseProgram(sides[i]->program);
+      set_frame_uniforms(*sides[i], values.width, values.height, values.mouse_x, values.mouse_y, values.shininess,
+                         values.object_color);
+      measure_timer.begin();
+      draw_fullscreen();
+      measure_timer.end();
+   }
+   measure_drawn = true;
+   measure_pin = pin;
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+   glViewport(0, 0, values.width, values.height);
+}
+
+void ab_drawing::draw(const quad_program& a, const quad_program& b, float split, unsigned pin,
+                      const frame_values& values, GLuint framebuffer)
+{
+   const quad_program* sides[2] = { &a, &b };
+   if (frame % measure_interval == 0)
+      measure(sides, pin, values, framebuffer);
+   const int width = values.width;
+   const int height = values.height;
+   const int divider = int(split * width);
+   for (int i = 0; i < 2; ++i)
+   {
+      if (mode == ab_mode::alternate && int(frame & 1) != i)
+         continue;
+      if (mode == ab_mode::split)
+      {
+         glEnable(GL_SCISSOR_TEST);
+         glScissor(i ? divider : 0, 0, i ? width - divider : divider, height);
+      }
+      glUseProgram(sides[i]->program);
+      set_frame_uniforms(*sides[i], width, height, values.mouse_x, values.mouse_y, values.shininess,
+                         values.object_color);
+      timers[i].begin();
+      draw_fullscreen();
+      timers[i].end();
+   }
+   if (mode == ab_mode::split)
+   {
+      glScissor(divider - 1, 0, 2, height);
+      glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+      glDisable(GL_SCISSOR_TEST);
+   }
+   ++frame;
+}
+
+void ab_drawing::finish_measurement()
+{
+   if (!measure_drawn)
+      return;
+   measure_drawn = false;
+   static std::vector<float> pixels[2];
+   const std::vector<double> ms = measure_timer.collect();
+   for (int i = 0; i < 2; ++i)
+   {
+      const render_target& target = targets[i];
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+      read_pixels(GL_COLOR_ATTACHMENT0, target.width, target.height, pixels[i]);
+      last.full_ms[i] = i < int(ms.size()) ? ms[i] : 0.0;
+   }
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+   last.diff = compare_images(pixels[1], pixels[0]);
+   last.measured = true;
+   last.measured_pin = measure_pin;
+}
+
+ab_measurement ab_drawing::results() const
+{
+   ab_measurement out = last;
+   for (int i = 0; i < 2; ++i)
+      out.live_ms[i] = timers[i].average_ms();
+   return out;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+#include <string>
+
+#include "benchmark.h"
+#include "frame_values.h"
+#include "quad_program.h"
+#include "render_target.h"
+
+// Live comparison of the shown program (A) with a pinned build (B).
+enum class ab_mode
+{
+   off,
+   // A left of the divider, B right of it.
+   split,
+   // A on even frames, B on odd ones.
+   alternate,
+};
+
+// The UI thread's side of the comparison.
+struct ab_comparison
+{
+   ab_mode mode = ab_mode::off;
+   // Built from the sources and defines shown when it was pinned. Reloads
+   // leave it alone, so after saving an edit A is the new version and B the
+   // old one.
+   quad_program pinned = {};
+   std::string pinned_name;
+   // Scene code compiled into pinned; B is not drawn once the scene differs.
+   uint64_t pinned_topology = 0;
+   // Fraction of the width that shows A in split mode.
+   float split = 0.5f;
+   // Counts the pins, so measurements of an earlier B are not shown.
+   unsigned pin = 0;
+
+   // Make program B, retiring the one pinned before.
+   void replace_pinned(const quad_program& program, const std::string& name, uint64_t topology);
+   void destroy();
+};
+
+// What the render thread measured of the comparison.
+struct ab_measurement
+{
+   // Live GPU time of each side. In split mode that is only its part of the
+   // screen.
+   double live_ms[2] = {};
+   // Last full frame measurement, of pin measured_pin.
+   bool measured = false;
+   unsigned measured_pin = 0;
+   double full_ms[2] = {};
+   image_diff diff;
+};
+
+// The render thread's side, which draws and times both.
+class ab_drawing
+{
+public:
+   void destroy();
+
+   // Mode of the frame about to be drawn. Creates the timers when it turns
+   // on, as queries are not shared between contexts.
+   void set_mode(ab_mode mode);
+   // Draw a and b compared as set_mode() into framebuffer, split at split of
+   // the width. Every few frames both are also drawn offscreen at full size
+   // for finish_measurement().
+   void draw(const quad_program& a, const quad_program& b, float split, unsigned pin, const frame_values& frame,
+             GLuint framebuffer);
+   // Time and compare the images draw() measured. Waits for the GPU and
+   // reads pixels back, so the render thread calls it once the frame is
+   // submitted.
+   void finish_measurement();
+   ab_measurement results() const;
+
+private:
+   void measure(const quad_program* sides[2], unsigned pin, const frame_values& frame, GLuint framebuffer);
+
+   // Mode the timers were created for.
+   ab_mode mode = ab_mode::off;
+   unsigned frame = 0;
+   frame_timer timers[2];
+   // Both sides drawn offscreen at full size, for time and difference.
+   render_target targets[2];
+   gpu_timer measure_timer;
+   // Set once targets hold a measurement to read back, of pin measure_pin.
+   bool measure_drawn = false;
+   unsigned measure_pin = 0;
+   ab_measurement last;
+};
@@ -0,0 +1,135 @@
+#include "single_quad_app.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "compute_raymarch.h"
+#include "quad_program.h"
+#include "render_target.h"
+
+// Shader variants compared by --benchmark. The first is the reference the
+// images of the others are compared to; variants with a tolerance fail the
+// benchmark if their RMS error exceeds it.
+static const struct
+{
+   const char* name;
+   const char* defines;
+   double tolerance;
+   raymarch_backend backend;
+   bool quad_vertices;
+} benchmark_variants[] = {
+   { "reference", nullptr, 0.0, raymarch_backend::fragment, false },
+   // Estimates penumbrae differently, so shadows only stay close to the
+   // reference's.
+   { "shadow: improved", "#define IMPROVED_SHADOW", 0.05, raymarch_backend::fragment, false },
+   { "normals: tetrahedral", "#define TETRAHEDRAL_NORMALS", 0.005, raymarch_backend::fragment, false },
+   { "normals: analytic", "#define ANALYTIC_NORMALS", 0.005, raymarch_backend::fragment, false },
+   // Same image as the reference up to rounding to 8 bits.
+   { "compute: 8x8 tiles", nullptr, 0.005, raymarch_backend::compute_tiles, false },
+   { "compute: persistent", nullptr, 0.005, raymarch_backend::compute_persistent, false },
+   // Shades the pixels along the diagonal twice, but produces the same image.
+   { "quad: two triangles", nullptr, 1e-6, raymarch_backend::fragment, true },
+};
+
+void single_quad_app::run_raymarcher(const quad_program& prog, const render_target& target) const
+{
+   if (prog.backend == raymarch_backend::fragment)
+      draw_fullscreen();
+   else
+      compute.dispatch(prog, target, raymarcher.modes.persistent_groups);
+}
+
+bool single_quad_app::run_benchmark()
+{
+   const int width = screen_w;
+   const int height = screen_h;
+   // Warm up frames let lazily finished compilation and clocks settle.
+   const int warmup_frames = 5;
+
+   render_target fragment_target;
+   fragment_target.init({ GL_RGBA32F, GL_RGBA32F });
+   fragment_target.resize(width, height);
+   // Compute variants store colors through an rgba8 image.
+   render_target compute_benchmark_target;
+   compute_benchmark_target.init({ GL_RGBA8, GL_RGBA32F });
+   compute_benchmark_target.resize(width, height);
+   gpu_timer timer;
+   timer.init(benchmark_frames);
+   quad_program timed = {};
+   quad_program counted = {};
+   std::vector<benchmark_result> results;
+   std::vector<float> reference, pixels;
+   // One iTime for every variant, so their images are comparable.
+   const float no_drag[4] = {};
+   begin_frame_uniforms(glfwGetTime(), no_drag, false);
+
+   glBindVertexArray(vao);
+   for (const auto& variant : benchmark_variants)
+   {
+      if (variant.backend != raymarch_backend::fragment && !compute_available())
+      {
+         fprintf(stderr, "Skipping benchmark variant %s, compute shaders are not supported\n", variant.name);
+         continue;
+      }
+      quad_vertices = variant.quad_vertices;
+      // Counting steps slows the shader down, so it gets its own build.
+      std::string counting = variant.defines ? std::string(variant.defines) + "\n" : std::string();
+      counting += "#define COUNT_STEPS\n";
+      if (!raymarcher.build(timed, variant.defines, variant.backend)
+          || !raymarcher.build(counted, counting.c_str(), variant.backend))
+      {
+         fprintf(stderr, "Skipping benchmark variant %s\n", variant.name);
+         continue;
+      }
+      const render_target& target =
+         variant.backend == raymarch_backend::fragment ? fragment_target : compute_benchmark_target;
+
+      benchmark_result result;
+      result.name = variant.name;
+      result.tolerance = variant.tolerance;
+      target.bind();
+      glUseProgram(timed.program);
+      set_frame_uniforms(timed, width, height, mouse_x, mouse_y, shininess, object_color);
+      for (int i = 0; i < warmup_frames; ++i)
+         run_raymarcher(timed, target);
+      for (int i = 0; i < benchmark_frames; ++i)
+      {
+         timer.begin();
+         run_raymarcher(timed, target);
+         timer.end();
+      }
+      const std::vector<double> ms = timer.collect();
+      result.median_ms = median(ms);
+      result.min_ms = ms.empty() ? 0.0 : *std::min_element(ms.begin(), ms.end());
+
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+      read_pixels(GL_COLOR_ATTACHMENT0, width, height, pixels);
+      if (results.empty())
+         reference = pixels;
+      result.diff = compare_images(pixels, reference);
+
+      glUseProgram(counted.program);
+      set_frame_uniforms(counted, width, height, mouse_x, mouse_y, shininess, object_color);
+      run_raymarcher(counted, target);
+      read_pixels(GL_COLOR_ATTACHMENT1, width, height, pixels);
+      result.steps = average_steps(pixels);
+      results.push_back(result);
+   }
+   quad_vertices = false;
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+   print_benchmark(stdout, results, width, height, benchmark_frames);
+   glDeleteProgram(timed.program);
+   glDeleteProgram(counted.program);
+   timer.destroy();
+   fragment_target.destroy();
+   compute_benchmark_target.destroy();
+   bool within_tolerance = true;
+   for (const benchmark_result& result : results)
+      within_tolerance &= !result.failed();
+   return !results.empty() && within_tolerance;
+}
@@ -0,0 +1,125 @@
+#include "single_quad_app.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shader_corpus.h"
+#include "shader_source.h"
+
+bool single_quad_app::run_corpus()
+{
+   std::vector<corpus_resolution> resolutions;
+   if (!parse_resolutions(corpus_resolutions, resolutions))
+   {
+      fprintf(stderr, "Invalid resolutions %s, expected e.g. 640x360,1280x720\n", corpus_resolutions);
+      return false;
+   }
+   const std::vector<std::string> paths = list_shader_files(corpus_dir);
+   if (paths.empty())
+   {
+      fprintf(stderr, "No .glsl files in %s\n", corpus_dir);
+      return false;
+   }
+   const std::shared_ptr<const mapped_file> vertex_file = map_shader_file(vertex_shader_path);
+   if (!vertex_file)
+      return false;
+   const std::string vertex_source(vertex_file->data(), vertex_file->size());
+
+   // Windows can only be created on this thread. Shaders are built in
+   // parallel on workers whose contexts share objects with the one here,
+   // then timed one after another in it alone, so no other context's work
+   // lands in the timer queries.
+   glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+   GLFWwindow* timing_context = glfwCreateWindow(16, 16, "SDF corpus", nullptr, nullptr);
+   if (!timing_context)
+   {
+      fprintf(stderr, "Failed to create a context for the corpus\n");
+      return false;
+   }
+   int threads = corpus_threads > 0 ? corpus_threads : int(std::thread::hardware_concurrency());
+   threads = std::max(1, std::min(threads, int(paths.size())));
+   std::vector<GLFWwindow*> contexts;
+   for (int i = 0; i < threads; ++i)
+   {
+      GLFWwindow* context = glfwCreateWindow(16, 16, "SDF corpus", nullptr, timing_context);
+      if (!context)
+         break;
+      contexts.push_back(context);
+   }
+   if (contexts.empty())
+      contexts.push_back(timing_context);
+
+   std::vector<corpus_result> results(paths.size());
+   std::vector<GLuint> programs(paths.size(), 0);
+   std::atomic<size_t> next(0);
+   std::mutex progress_mutex;
+   size_t done = 0;
+   auto work = [&](GLFWwindow* context) {
+      glfwMakeContextCurrent(context);
+      corpus_runner runner;
+      runner.init(vertex_source);
+      for (size_t i = next++; i < paths.size(); i = next++)
+      {
+         programs[i] = runner.build(paths[i], results[i]);
+         std::lock_guard<std::mutex> lock(progress_mutex);
+         fprintf(stderr, "[%zu/%zu] built %s %s\n", ++done, paths.size(), paths[i].c_str(),
+                 results[i].failure.empty() ? "ok" : results[i].failure.c_str());
+      }
+      runner.destroy();
+      // The programs are used by the timing context once this returns.
+      glFinish();
+      glfwMakeContextCurrent(nullptr);
+   };
+   const auto start = std::chrono::steady_clock::now();
+   std::vector<std::thread> workers;
+   for (GLFWwindow* context : contexts)
+      workers.emplace_back(work, context);
+   for (std::thread& worker : workers)
+      worker.join();
+   const double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   glfwMakeContextCurrent(timing_context);
+   corpus_runner runner;
+   runner.resolutions = resolutions;
+   runner.frames = benchmark_frames;
+   runner.init(vertex_source);
+   for (size_t i = 0; i < paths.size(); ++i)
+   {
+      if (!programs[i])
+         continue;
+      runner.time(programs[i], results[i]);
+      fprintf(stderr, "[%zu/%zu] timed %s %s\n", i + 1, paths.size(), paths[i].c_str(),
+              results[i].failure.empty() ? "ok" : results[i].failure.c_str());
+   }
+   runner.destroy();
+   const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   glfwMakeContextCurrent(nullptr);
+   for (GLFWwindow* context : contexts)
+   {
+      if (context != timing_context)
+         glfwDestroyWindow(context);
+   }
+   glfwDestroyWindow(timing_context);
+   glfwMakeContextCurrent(window);
+
+   FILE* out = corpus_out ? fopen(corpus_out, "w") : stdout;
+   if (!out)
+   {
+      fprintf(stderr, "Failed to write %s\n", corpus_out);
+      return false;
+   }
+   print_corpus(out, results, resolutions, benchmark_frames);
+   if (out != stdout)
+      fclose(out);
+   fprintf(stderr, "%zu shaders built on %zu contexts in %.1f s, timed in %.1f s\n", paths.size(), contexts.size(),
+           build_seconds, seconds - build_seconds);
+   return true;
+}
@@ -0,0 +1,101 @@
+#include "single_quad_app.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "benchmark.h"
+#include "compute_raymarch.h"
+#include "input_log.h"
+#include "render_target.h"
+
+bool single_quad_app::apply_recorded_settings(const recorded_frame& frame)
+{
+   const uint64_t mode_bits = frame.program_key & 31;
+   if ((frame.program_key >> 5) >= raymarcher.permutations.count())
+      return false;
+   raymarcher.permutations.select(frame.program_key >> 5);
+   raymarch_modes& modes = raymarcher.modes;
+   modes.cone_prepass = mode_bits & 1;
+   modes.temporal = mode_bits & 2;
+   modes.interleave_cells = mode_bits & 4 ? std::max(frame.interleave_cells, 2) : 1;
+   modes.backend = raymarch_backend((mode_bits >> 3) & 3);
+   if (modes.backend != raymarch_backend::fragment && !compute_available())
+   {
+      fprintf(stderr, "Compute shaders are not supported, replaying with the fragment backend\n");
+      modes.backend = raymarch_backend::fragment;
+   }
+   modes.cone_prepass_scale = std::max(frame.cone_prepass_scale, 1);
+   modes.history_blend = frame.history_blend;
+   change_modes();
+   // A failed build leaves the previous variant selected.
+   return raymarcher.built(raymarcher.key());
+}
+
+bool single_quad_app::run_replay()
+{
+   std::vector<recorded_frame> recorded;
+   if (!read_input_log(replay_path, recorded))
+      return false;
+   if (recorded.empty())
+   {
+      fprintf(stderr, "%s has no frames\n", replay_path);
+      return false;
+   }
+
+   render_target target;
+   target.init({ GL_RGBA8 });
+   gpu_timer timer;
+   timer.init(int(recorded.size()));
+   bool ok = true;
+   render_settings settings;
+   scene.bind();
+   for (size_t i = 0; i < recorded.size() && ok; ++i)
+   {
+      const recorded_frame& r = recorded[i];
+      if (i == 0 || !same_settings(r, recorded[i - 1]))
+      {
+         ok = apply_recorded_settings(r);
+         if (!ok)
+         {
+            fprintf(stderr, "Failed to build the shader variant of frame %d\n", int(i));
+            break;
+         }
+         take_settings(settings);
+      }
+      frame_values values;
+      values.width = r.width;
+      values.height = r.height;
+      values.mouse_x = r.mouse_x;
+      values.mouse_y = r.mouse_y;
+      values.shininess = r.shininess;
+      std::copy(r.object_color, r.object_color + 4, values.object_color);
+      std::copy(r.drag, r.drag + 4, values.drag);
+      values.time = r.time;
+      values.repeat = r.repeat;
+      target.resize(r.width, r.height);
+      output_framebuffer = target.fbo;
+      target.bind();
+      glClear(GL_COLOR_BUFFER_BIT);
+      timer.begin();
+      draw_quad(values, settings);
+      timer.end();
+   }
+   output_framebuffer = 0;
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+   const std::vector<double> ms = timer.collect();
+   if (ok && !ms.empty())
+   {
+      const double total = std::accumulate(ms.begin(), ms.end(), 0.0);
+      printf("Replayed %d frames of %s over %.2f s\n", int(ms.size()), replay_path,
+             recorded.back().time - recorded.front().time);
+      printf("GPU ms/frame  median %.3f   min %.3f   max %.3f   total %.1f\n", median(ms),
+             *std::min_element(ms.begin(), ms.end()), *std::max_element(ms.begin(), ms.end()), total);
+   }
+   timer.destroy();
+   target.destroy();
+   return ok;
+}
@@ -0,0 +1,277 @@
+#include "benchmark.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+void gpu_timer::init(int count)
+{
+   destroy();
+   queries.resize(count);
+   glGenQueries(GLsizei(queries.size()), queries.data());
+}
+
+void gpu_timer::destroy()
+{
+   if (!queries.empty())
+      glDeleteQueries(GLsizei(queries.size()), queries.data());
+   queries.clear();
+   used = 0;
+}
+
+void gpu_timer::begin()
+{
+   if (used < queries.size())
+      glBeginQuery(GL_TIME_ELAPSED, queries[used]);
+}
+
+void gpu_timer::end()
+{
+   if (used < queries.size())
+   {
+      glEndQuery(GL_TIME_ELAPSED);
+      ++used;
+   }
+}
+
+std::vector<double> gpu_timer::collect()
+{
+   std::vector<double> ms(used);
+   for (size_t i = 0; i < used; ++i)
+   {
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+      ms[i] = double(ns) * 1e-6;
+   }
+   used = 0;
+   return ms;
+}
+
+void frame_timer::init()
+{
+   destroy();
+   glGenQueries(latency, queries);
+}
+
+void frame_timer::destroy()
+{
+   if (queries[0])
+      glDeleteQueries(latency, queries);
+   for (int i = 0; i < latency; ++i)
+   {
+      queries[i] = 0;
+      pending[i] = false;
+   }
+   next = 0;
+   average = 0.0;
+}
+
+void frame_timer::begin()
+{
+   const unsigned slot = next % latency;
+   if (pending[slot])
+   {
+      GLuint64 ns = 0;
+      glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &ns);
+      const double ms = double(ns) * 1e-6;
+      average = average > 0.0 ? average + (ms - average) * 0.05 : ms;
+      pending[slot] = false;
+   }
+   glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+}
+
+void frame_timer::end()
+{
+   glEndQuery(GL_TIME_ELAPSED);
+   pending[next % latency] = true;
+   ++next;
+}
+
+void latency_probe::init()
+{
+   destroy();
+   // A few frames in flight at most, since the render thread waits for the
+   // previous frame before drawing the next.
+   slots.resize(4);
+   for (slot& s : slots)
+      glGenQueries(1, &s.query);
+}
+
+void latency_probe::destroy()
+{
+   for (slot& s : slots)
+      glDeleteQueries(1, &s.query);
+   slots.clear();
+   next = 0;
+   calibrated = false;
+   gpu_ms.clear();
+   swap_ms.clear();
+   written = 0;
+}
+
+void latency_probe::frame_submitted(double input_time)
+{
+   collect();
+   slot& s = slots[next % slots.size()];
+   if (s.pending)
+      return;
+   glQueryCounter(s.query, GL_TIMESTAMP);
+   s.input_time = input_time;
+   s.swap_time = 0.0;
+   s.pending = true;
+   ++next;
+}
+
+void latency_probe::frame_swapped(double now)
+{
+   if (slots.empty())
+      return;
+   GLint64 gpu_ns = 0;
+   glGetInteger64v(GL_TIMESTAMP, &gpu_ns);
+   clock_offset = now - double(gpu_ns) * 1e-9;
+   calibrated = true;
+   slot& s = slots[(next + slots.size() - 1) % slots.size()];
+   if (s.pending && s.swap_time == 0.0)
+      s.swap_time = now;
+}
+
+void latency_probe::collect()
+{
+   for (slot& s : slots)
+   {
+      if (!s.pending || s.swap_time == 0.0 || !calibrated)
+         continue;
+      GLint available = GL_FALSE;
+      glGetQueryObjectiv(s.query, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (!available)
+         continue;
+      GLuint64 gpu_ns = 0;
+      glGetQueryObjectui64v(s.query, GL_QUERY_RESULT, &gpu_ns);
+      const double done = double(gpu_ns) * 1e-9 + clock_offset;
+      add(gpu_ms, (done - s.input_time) * 1000.0);
+      add(swap_ms, (s.swap_time - s.input_time) * 1000.0);
+      ++written;
+      s.pending = false;
+   }
+}
+
+void latency_probe::add(std::vector<float>& samples, double ms)
+{
+   if (samples.size() < history)
+      samples.push_back(float(ms));
+   else
+      samples[written % history] = float(ms);
+}
+
+latency_summary latency_probe::summarize(std::vector<float> samples)
+{
+   latency_summary summary;
+   summary.frames = samples.size();
+   if (samples.empty())
+      return summary;
+   std::sort(samples.begin(), samples.end());
+   summary.median = samples[samples.size() / 2];
+   summary.p95 = samples[std::min(samples.size() - 1, samples.size() * 95 / 100)];
+   summary.max = samples.back();
+   return summary;
+}
+
+std::vector<float> latency_probe::recent_swapped() const
+{
+   if (swap_ms.size() < history)
+      return swap_ms;
+   std::vector<float> ordered(swap_ms.begin() + written % history, swap_ms.end());
+   ordered.insert(ordered.end(), swap_ms.begin(), swap_ms.begin() + written % history);
+   return ordered;
+}
+
+void print_latency(FILE* out, const latency_summary& gpu_done, const latency_summary& swapped)
+{
+   fprintf(out, "Input latency over %zu frames, ms\n", swapped.frames);
+   fprintf(out, "%-16s %8s %8s %8s\n", "until", "median", "p95", "max");
+   fprintf(out, "%-16s %8.2f %8.2f %8.2f\n", "GPU done", gpu_done.median, gpu_done.p95, gpu_done.max);
+   fprintf(out, "%-16s %8.2f %8.2f %8.2f\n", "swap returned", swapped.median, swapped.p95, swapped.max);
+}
+
+void read_pixels(GLenum attachment, int width, int height, std::vector<float>& out)
+{
+   out.resize(size_t(width) * height * 4);
+   glReadBuffer(attachment);
+   glPixelStorei(GL_PACK_ALIGNMENT, 4);
+   glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, out.data());
+}
+
+double median(std::vector<double> samples)
+{
+   if (samples.empty())
+      return 0.0;
+   const size_t mid = samples.size() / 2;
+   std::nth_element(samples.begin(), samples.begin() + mid, samples.end());
+   return samples[mid];
+}
+
+double percentile(std::vector<double> samples, double fraction)
+{
+   if (samples.empty())
+      return 0.0;
+   const size_t rank = std::min(samples.size() - 1, size_t(fraction * double(samples.size())));
+   std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+   return samples[rank];
+}
+
+step_counts average_steps(const std::vector<float>& rgba)
+{
+   step_counts steps;
+   const size_t pixels = rgba.size() / 4;
+   if (!pixels)
+      return steps;
+   for (size_t i = 0; i < pixels; ++i)
+   {
+      steps.primary += rgba[i * 4 + 0];
+      steps.shadow += rgba[i * 4 + 1];
+      steps.normal += rgba[i * 4 + 2];
+   }
+   steps.primary /= pixels;
+   steps.shadow /= pixels;
+   steps.normal /= pixels;
+   return steps;
+}
+
+image_diff compare_images(const std::vector<float>& rgba, const std::vector<float>& reference)
+{
+   image_diff diff;
+   const size_t pixels = std::min(rgba.size(), reference.size()) / 4;
+   if (!pixels)
+      return diff;
+   double sum = 0.0;
+   for (size_t i = 0; i < pixels; ++i)
+   {
+      bool differs = false;
+      // Alpha is not displayed.
+      for (size_t c = 0; c < 3; ++c)
+      {
+         const double a = std::min(std::max(rgba[i * 4 + c], 0.0f), 1.0f);
+         const double b = std::min(std::max(reference[i * 4 + c], 0.0f), 1.0f);
+         const double error = fabs(a - b);
+         diff.max_error = std::max(diff.max_error, error);
+         sum += error * error;
+         differs |= error > 1.0 / 255.0;
+      }
+      diff.differing += differs;
+   }
+   diff.rms_error = sqrt(sum / (pixels * 3));
+   return diff;
+}
+
+void print_benchmark(FILE* out, const std::vector<benchmark_result>& results, int width, int height, int frames)
+{
+   fprintf(out, "%dx%d, %d frames per variant, steps are per pixel\n", width, height, frames);
+   fprintf(out, "%-28s %9s %9s %9s %9s %9s %9s %9s %9s\n", "variant", "median ms", "min ms", "primary", "shadow",
+           "normal", "max err", "rms err", "diff px");
+   for (const benchmark_result& r : results)
+   {
+      fprintf(out, "%-28s %9.3f %9.3f %9.2f %9.2f %9.2f %9.4f %9.5f %9zu%s\n", r.name.c_str(), r.median_ms,
+              r.min_ms, r.steps.primary, r.steps.shadow, r.steps.normal, r.diff.max_error, r.diff.rms_error,
+              r.diff.differing, r.failed() ? " FAILED" : "");
+   }
+}
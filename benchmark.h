@@ -0,0 +1,157 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// GPU time of the commands between begin() and end(), measured with
+// GL_TIME_ELAPSED queries. Results are only read by collect(), after every
+// frame has been issued, so timing never stalls the frames being timed.
+class gpu_timer
+{
+public:
+   void init(int count);
+   void destroy();
+
+   // Pairs past the count given to init() are not timed.
+   void begin();
+   void end();
+   // Milliseconds of each begin()/end() pair since the last collect(). Waits
+   // for the GPU.
+   std::vector<double> collect();
+
+private:
+   std::vector<GLuint> queries;
+   size_t used = 0;
+};
+
+// GPU time of a pass drawn every frame. Each query is read back
+// frame_timer::latency frames after it was issued, by which time it is done,
+// so timing does not stall the pipeline.
+class frame_timer
+{
+public:
+   void init();
+   void destroy();
+
+   void begin();
+   void end();
+   // Moving average over the last few dozen frames, 0 before the first
+   // result.
+   double average_ms() const { return average; }
+
+private:
+   static const int latency = 4;
+   GLuint queries[latency] = {};
+   bool pending[latency] = {};
+   unsigned next = 0;
+   double average = 0.0;
+};
+
+// Distribution of a latency over recent frames, in milliseconds.
+struct latency_summary
+{
+   double median = 0.0;
+   double p95 = 0.0;
+   double max = 0.0;
+   size_t frames = 0;
+};
+
+// Input-to-display latency of frames tagged with the time their input was
+// sampled, all times in seconds of one CPU clock. A GL_TIMESTAMP query after
+// each frame tells when the GPU finished it; the GPU clock is mapped to the
+// CPU clock by reading both right after each swap. Queries are read once
+// available, so probing never stalls the frames probed.
+class latency_probe
+{
+public:
+   // Frames the summaries cover.
+   static const size_t history = 240;
+
+   void init();
+   void destroy();
+   bool active() const { return !slots.empty(); }
+
+   // After the commands of a frame whose input was sampled at input_time.
+   void frame_submitted(double input_time);
+   // Right after the swap of that frame returned, at now.
+   void frame_swapped(double now);
+
+   // From the input sample until the GPU finished the frame.
+   latency_summary gpu_done() const { return summarize(gpu_ms); }
+   // From the input sample until the swap returned, the closest the
+   // application sees to the frame reaching the display.
+   latency_summary swapped() const { return summarize(swap_ms); }
+   // Input to swap latency of the last frames, oldest first, for plotting.
+   std::vector<float> recent_swapped() const;
+
+private:
+   struct slot
+   {
+      GLuint query = 0;
+      double input_time = 0.0;
+      double swap_time = 0.0;
+      bool pending = false;
+   };
+
+   void collect();
+   void add(std::vector<float>& samples, double ms);
+   static latency_summary summarize(std::vector<float> samples);
+
+   std::vector<slot> slots;
+   unsigned next = 0;
+   // CPU time minus GPU time, in seconds.
+   double clock_offset = 0.0;
+   bool calibrated = false;
+   std::vector<float> gpu_ms;
+   std::vector<float> swap_ms;
+   size_t written = 0;
+};
+
+void print_latency(FILE* out, const latency_summary& gpu_done, const latency_summary& swapped);
+
+// Per pixel averages of the COUNT_STEPS output of raymarch.glsl.
+struct step_counts
+{
+   double primary = 0.0;
+   double shadow = 0.0;
+   double normal = 0.0;
+};
+
+// Difference of an image to a reference, compared as displayed.
+struct image_diff
+{
+   double max_error = 0.0;
+   double rms_error = 0.0;
+   // Pixels with any channel off by more than one 8 bit step.
+   size_t differing = 0;
+};
+
+struct benchmark_result
+{
+   std::string name;
+   double median_ms = 0.0;
+   double min_ms = 0.0;
+   step_counts steps;
+   image_diff diff;
+   // Largest acceptable diff.rms_error, 0 if any is.
+   double tolerance = 0.0;
+
+   bool failed() const { return tolerance > 0.0 && diff.rms_error > tolerance; }
+};
+
+// Read attachment of the bound read framebuffer as RGBA floats.
+void read_pixels(GLenum attachment, int width, int height, std::vector<float>& out);
+
+double median(std::vector<double> samples);
+// Sample below which fraction of samples lie, e.g. 0.9 for the 90th
+// percentile. 0 without samples.
+double percentile(std::vector<double> samples, double fraction);
+step_counts average_steps(const std::vector<float>& rgba);
+image_diff compare_images(const std::vector<float>& rgba, const std::vector<float>& reference);
+
+void print_benchmark(FILE* out, const std::vector<benchmark_result>& results, int width, int height, int frames);
@@ -3,6 +3,13 @@
 
 #include <GLFW/glfw3.h>
 
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
 class ticker
 {
 public:
@@ -17,4 +24,73 @@ public:
    }
 };
 
+// Wall-clock timings of named phases relative to a common origin. Phases may
+// be recorded from several threads and may overlap, so each one keeps its own
+// start and end offsets. Uses std::chrono since glfwGetTime() is not valid
+// before glfwInit().
+class phase_timer
+{
+public:
+   typedef std::chrono::steady_clock clock;
+
+   struct phase
+   {
+      const char* name;
+      double start_ms;
+      double end_ms;
+   };
+
+   clock::time_point origin = clock::now();
+
+   void reset() { origin = clock::now(); }
+
+   double now_ms() const
+   {
+      return std::chrono::duration<double, std::milli>(clock::now() - origin).count();
+   }
+
+   void record(const char* name, double start_ms, double end_ms)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      phases.push_back({ name, start_ms, end_ms });
+   }
+
+   void report(FILE* out)
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::sort(phases.begin(), phases.end(), [](const phase& a, const phase& b) { return a.start_ms < b.start_ms; });
+      double total = 0;
+      fprintf(out, "%-24s %10s %10s\n", "phase", "start ms", "time ms");
+      for (const phase& p : phases)
+      {
+         fprintf(out, "%-24s %10.2f %10.2f\n", p.name, p.start_ms, p.end_ms - p.start_ms);
+         total = std::max(total, p.end_ms);
+      }
+      fprintf(out, "%-24s %10s %10.2f\n", "total", "", total);
+   }
+
+private:
+   std::mutex mutex;
+   std::vector<phase> phases;
+};
+
+// Records the lifetime of the enclosing scope as a phase.
+class scoped_phase
+{
+public:
+   scoped_phase(phase_timer& timer, const char* name)
+      : timer(timer)
+      , name(name)
+      , start_ms(timer.now_ms())
+   {
+   }
+
+   ~scoped_phase() { timer.record(name, start_ms, timer.now_ms()); }
+
+private:
+   phase_timer& timer;
+   const char* name;
+   double start_ms;
+};
+
 #endif
@@ -0,0 +1,90 @@
+#include "compute_raymarch.h"
+
+#include <algorithm>
+#include <string>
+
+// Lets raymarch.glsl stay at #version 410 for the fragment path.
+static const char* compute_extensions = "#extension GL_ARB_compute_shader : require\n"
+                                        "#extension GL_ARB_shader_image_load_store : require\n"
+                                        "#extension GL_ARB_shader_atomic_counters : require\n";
+
+bool compute_available()
+{
+   return GLEW_VERSION_4_3
+          || (GLEW_ARB_compute_shader && GLEW_ARB_shader_image_load_store && GLEW_ARB_shader_atomic_counters);
+}
+
+bool build_compute_program(quad_program& out, const scene_inputs& scene, const char* defines, raymarch_backend which)
+{
+   std::string prelude = std::string(compute_extensions) + "#define COMPUTE_BACKEND\n";
+   if (which == raymarch_backend::compute_persistent)
+      prelude += "#define PERSISTENT_THREADS\n";
+   if (defines)
+      prelude += defines;
+   GLuint shader = scene.compile_shader(fragment_shader_path, prelude.c_str(), GL_COMPUTE_SHADER);
+   GLuint linked = 0;
+   if (shader)
+   {
+      linked = glCreateProgram();
+      glAttachShader(linked, shader);
+      glDeleteShader(shader);
+      glLinkProgram(linked);
+   }
+   if (!finish_quad_link(out.program, linked))
+      return false;
+   out.backend = which;
+   scene.bind_program(out);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iOutput"), output_image_unit);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iStepsOutput"), steps_image_unit);
+   return true;
+}
+
+void compute_raymarcher::init()
+{
+   target.init({ GL_RGBA8 });
+   if (compute_available())
+   {
+      glGenBuffers(1, &tile_counter);
+      glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, tile_counter);
+      glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_DRAW);
+      glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+   }
+}
+
+void compute_raymarcher::destroy()
+{
+   target.destroy();
+   glDeleteBuffers(1, &tile_counter);
+   tile_counter = 0;
+}
+
+void compute_raymarcher::dispatch(const quad_program& prog, const render_target& target, int groups) const
+{
+   glBindImageTexture(output_image_unit, target.textures[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+   if (target.textures.size() > 1)
+      glBindImageTexture(steps_image_unit, target.textures[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+   const GLuint tiles_x = GLuint(target.width + 7) / 8;
+   const GLuint tiles_y = GLuint(target.height + 7) / 8;
+   if (prog.backend == raymarch_backend::compute_persistent)
+   {
+      const GLuint zero = 0;
+      glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, tile_counter);
+      glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(zero), &zero);
+      glDispatchCompute(std::min(GLuint(groups), tiles_x * tiles_y), 1, 1);
+   }
+   else
+      glDispatchCompute(tiles_x, tiles_y, 1);
+   // The image is read back through framebuffers.
+   glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void compute_raymarcher::draw(const quad_program& prog, int width, int height, int groups, GLuint framebuffer)
+{
+   target.resize(width, height);
+   dispatch(prog, target, groups);
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+   glReadBuffer(GL_COLOR_ATTACHMENT0);
+   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+   glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "quad_program.h"
+#include "render_target.h"
+#include "scene_inputs.h"
+
+// Whether the compute backends can run in this context.
+bool compute_available();
+
+// Build a variant of the raymarcher as a compute shader for a compute
+// backend. On failure out is left alone.
+bool build_compute_program(quad_program& out, const scene_inputs& scene, const char* defines, raymarch_backend which);
+
+// Runs compute builds of the raymarcher over 8x8 tiles of an image.
+class compute_raymarcher
+{
+public:
+   void init();
+   void destroy();
+
+   // Run prog over target, writing its first attachment and with COUNT_STEPS
+   // its second. prog is bound with its frame uniforms set. The persistent
+   // backend launches up to groups work groups.
+   void dispatch(const quad_program& prog, const render_target& target, int groups) const;
+   // Run prog over an image of width by height pixels and copy it into
+   // framebuffer, which is left bound.
+   void draw(const quad_program& prog, int width, int height, int groups, GLuint framebuffer);
+
+private:
+   // Image the compute backends write, blitted to the window.
+   render_target target;
+   // Tile queue head of the persistent backend.
+   GLuint tile_counter = 0;
+};
@@ -9,10 +9,14 @@
 // https://github.com/ocornut/imgui
 
 struct GLFWwindow;
+struct ImDrawData;
+struct ImVec2;
 
 IMGUI_API bool        ImGui_ImplGlfwGL3_Init(GLFWwindow* window, bool install_callbacks);
 IMGUI_API void        ImGui_ImplGlfwGL3_Shutdown();
 IMGUI_API void        ImGui_ImplGlfwGL3_NewFrame();
+// Render draw data captured earlier, e.g. on another thread with this binding's context current.
+IMGUI_API void        ImGui_ImplGlfwGL3_RenderDrawData(const ImDrawData* draw_data, const ImVec2& display_size, const ImVec2& framebuffer_scale);
 
 // Use if you want to reset your rendering device without losing ImGui state.
 IMGUI_API void        ImGui_ImplGlfwGL3_InvalidateDeviceObjects();
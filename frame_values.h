@@ -0,0 +1,24 @@
+#pragma once
+
+// Per frame inputs of draw_quad(), taken by the UI thread.
+struct frame_values
+{
+   int width = 0;
+   int height = 0;
+   double mouse_x = 0;
+   double mouse_y = 0;
+   float shininess = 10.0f;
+   float object_color[4] = {};
+   // iTime, in seconds.
+   double time = 0;
+   // glfwGetTime() when the mouse position was sampled.
+   double input_time = 0;
+   // Shadertoy's iMouse, in framebuffer pixels from the bottom left: xy
+   // where the left button was last held down, zw where it was pressed,
+   // negated while it is up.
+   float drag[4] = {};
+   // Set when the render thread draws the frame it last drew again because
+   // no newer one was published. iFrame, iTimeDelta and the Shadertoy
+   // buffers then stay as they are.
+   bool repeat = false;
+};
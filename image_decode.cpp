@@ -0,0 +1,1074 @@
+#include "image_decode.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+   // Larger images are rejected before anything is allocated for them.
+   const int max_image_side = 16384;
+
+   // Reads the next header number of a PNM file, skipping whitespace and
+   // comments. Returns false at the end of data.
+   bool pnm_number(const char*& p, const char* end, int& value)
+   {
+      while (p < end && (isspace((unsigned char)*p) || *p == '#'))
+      {
+         if (*p == '#')
+         {
+            while (p < end && *p != '\n')
+               ++p;
+         }
+         else
+            ++p;
+      }
+      if (p == end || !isdigit((unsigned char)*p))
+         return false;
+      value = 0;
+      while (p < end && isdigit((unsigned char)*p) && value < (1 << 24))
+         value = value * 10 + (*p++ - '0');
+      return true;
+   }
+
+   uint32_t big_endian32(const unsigned char* p)
+   {
+      return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+   }
+
+   // Canonical Huffman code of a deflate block, decoded a bit at a time.
+   struct deflate_code
+   {
+      short counts[16];
+      short symbols[288];
+
+      // Returns false if lengths describe no prefix code.
+      bool build(const unsigned char* lengths, int n)
+      {
+         memset(counts, 0, sizeof(counts));
+         for (int i = 0; i < n; ++i)
+            ++counts[lengths[i]];
+         counts[0] = 0;
+         int left = 1;
+         for (int len = 1; len < 16; ++len)
+         {
+            left = left * 2 - counts[len];
+            if (left < 0)
+               return false;
+         }
+         short offsets[16];
+         offsets[1] = 0;
+         for (int len = 1; len < 15; ++len)
+            offsets[len + 1] = short(offsets[len] + counts[len]);
+         for (int i = 0; i < n; ++i)
+         {
+            if (lengths[i])
+               symbols[offsets[lengths[i]]++] = short(i);
+         }
+         return true;
+      }
+   };
+
+   // zlib stream as used by PNG's IDAT chunks.
+   class inflater
+   {
+   public:
+      inflater(const unsigned char* data, size_t len) : p(data), end(data + len) {}
+
+      // Inflate into out, which must end up exactly expected bytes long.
+      bool inflate(std::vector<unsigned char>& out, size_t expected)
+      {
+         if (end - p < 2 || (p[0] & 15) != 8 || (p[0] << 8 | p[1]) % 31 || p[1] & 32)
+            return false;
+         p += 2;
+         out.clear();
+         out.reserve(expected);
+         bool last = false;
+         while (!last)
+         {
+            last = bits(1) != 0;
+            const unsigned type = bits(2);
+            bool ok = false;
+            if (type == 0)
+               ok = stored(out, expected);
+            else if (type == 1)
+               ok = fixed_block(out, expected);
+            else if (type == 2)
+               ok = dynamic_block(out, expected);
+            if (!ok || overrun)
+               return false;
+         }
+         return out.size() == expected;
+      }
+
+   private:
+      unsigned bits(int n)
+      {
+         while (count < n)
+         {
+            unsigned byte = 0;
+            if (p < end)
+               byte = *p++;
+            else
+               overrun = true;
+            buffer |= byte << count;
+            count += 8;
+         }
+         const unsigned value = buffer & ((1u << n) - 1);
+         buffer >>= n;
+         count -= n;
+         return value;
+      }
+
+      int decode(const deflate_code& code)
+      {
+         int value = 0;
+         int first = 0;
+         int index = 0;
+         for (int len = 1; len < 16; ++len)
+         {
+            value |= int(bits(1));
+            const int n = code.counts[len];
+            if (value - n < first)
+               return code.symbols[index + value - first];
+            index += n;
+            first = (first + n) << 1;
+            value <<= 1;
+         }
+         return -1;
+      }
+
+      bool stored(std::vector<unsigned char>& out, size_t expected)
+      {
+         // Whole bytes never stay in the bit buffer, so dropping it aligns.
+         buffer = 0;
+         count = 0;
+         if (end - p < 4)
+            return false;
+         const size_t len = size_t(p[0] | p[1] << 8);
+         if (size_t(p[2] | p[3] << 8) != (~len & 0xffff))
+            return false;
+         p += 4;
+         if (size_t(end - p) < len || out.size() + len > expected)
+            return false;
+         out.insert(out.end(), p, p + len);
+         p += len;
+         return true;
+      }
+
+      bool fixed_block(std::vector<unsigned char>& out, size_t expected)
+      {
+         unsigned char lengths[288 + 30];
+         std::fill(lengths, lengths + 144, 8);
+         std::fill(lengths + 144, lengths + 256, 9);
+         std::fill(lengths + 256, lengths + 280, 7);
+         std::fill(lengths + 280, lengths + 288, 8);
+         std::fill(lengths + 288, lengths + 318, 5);
+         deflate_code literals, distances;
+         literals.build(lengths, 288);
+         distances.build(lengths + 288, 30);
+         return codes(out, expected, literals, distances);
+      }
+
+      bool dynamic_block(std::vector<unsigned char>& out, size_t expected)
+      {
+         static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+         const int literal_count = int(bits(5)) + 257;
+         const int distance_count = int(bits(5)) + 1;
+         const int length_count = int(bits(4)) + 4;
+         if (literal_count > 286 || distance_count > 30)
+            return false;
+         unsigned char lengths[288 + 30] = {};
+         for (int i = 0; i < length_count; ++i)
+            lengths[order[i]] = (unsigned char)bits(3);
+         deflate_code code_lengths;
+         if (!code_lengths.build(lengths, 19))
+            return false;
+
+         const int total = literal_count + distance_count;
+         int i = 0;
+         while (i < total)
+         {
+            const int symbol = decode(code_lengths);
+            if (symbol < 0)
+               return false;
+            if (symbol < 16)
+            {
+               lengths[i++] = (unsigned char)symbol;
+               continue;
+            }
+            unsigned char value = 0;
+            int repeat;
+            if (symbol == 16)
+            {
+               if (!i)
+                  return false;
+               value = lengths[i - 1];
+               repeat = 3 + int(bits(2));
+            }
+            else if (symbol == 17)
+               repeat = 3 + int(bits(3));
+            else
+               repeat = 11 + int(bits(7));
+            if (i + repeat > total)
+               return false;
+            std::fill(lengths + i, lengths + i + repeat, value);
+            i += repeat;
+         }
+         if (!lengths[256])
+            return false;
+         deflate_code literals, distances;
+         if (!literals.build(lengths, literal_count) || !distances.build(lengths + literal_count, distance_count))
+            return false;
+         return codes(out, expected, literals, distances);
+      }
+
+      bool codes(std::vector<unsigned char>& out, size_t expected, const deflate_code& literals,
+                 const deflate_code& distances)
+      {
+         static const short length_base[29] = { 3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                                31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+         static const unsigned char length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                                         2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+         static const unsigned short distance_base[30] = { 1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                                           33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                                           1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+         static const unsigned char distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                                           6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+         for (;;)
+         {
+            int symbol = decode(literals);
+            if (symbol < 0 || overrun)
+               return false;
+            if (symbol < 256)
+            {
+               if (out.size() == expected)
+                  return false;
+               out.push_back((unsigned char)symbol);
+               continue;
+            }
+            if (symbol == 256)
+               return true;
+            symbol -= 257;
+            if (symbol >= 29)
+               return false;
+            const size_t len = size_t(length_base[symbol]) + bits(length_extra[symbol]);
+            const int distance_symbol = decode(distances);
+            if (distance_symbol < 0 || distance_symbol >= 30)
+               return false;
+            const size_t distance = size_t(distance_base[distance_symbol]) + bits(distance_extra[distance_symbol]);
+            if (distance > out.size() || out.size() + len > expected)
+               return false;
+            // Copies may overlap what they write.
+            for (size_t i = 0; i < len; ++i)
+               out.push_back(out[out.size() - distance]);
+         }
+      }
+
+      const unsigned char* p;
+      const unsigned char* end;
+      unsigned buffer = 0;
+      int count = 0;
+      bool overrun = false;
+   };
+
+   unsigned char paeth(int a, int b, int c)
+   {
+      const int p = a + b - c;
+      const int pa = abs(p - a);
+      const int pb = abs(p - b);
+      const int pc = abs(p - c);
+      if (pa <= pb && pa <= pc)
+         return (unsigned char)a;
+      return (unsigned char)(pb <= pc ? b : c);
+   }
+
+   // Undo the filter of each of height rows of row_bytes, each preceded by
+   // its filter type.
+   bool unfilter(unsigned char* rows, size_t row_bytes, int height, size_t pixel_bytes)
+   {
+      const unsigned char* prior = nullptr;
+      for (int y = 0; y < height; ++y)
+      {
+         const unsigned char type = rows[0];
+         unsigned char* row = rows + 1;
+         for (size_t i = 0; i < row_bytes; ++i)
+         {
+            const int a = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+            const int b = prior ? prior[i] : 0;
+            const int c = prior && i >= pixel_bytes ? prior[i - pixel_bytes] : 0;
+            switch (type)
+            {
+            case 0:
+               break;
+            case 1:
+               row[i] = (unsigned char)(row[i] + a);
+               break;
+            case 2:
+               row[i] = (unsigned char)(row[i] + b);
+               break;
+            case 3:
+               row[i] = (unsigned char)(row[i] + (a + b) / 2);
+               break;
+            case 4:
+               row[i] = (unsigned char)(row[i] + paeth(a, b, c));
+               break;
+            default:
+               return false;
+            }
+         }
+         prior = row;
+         rows += row_bytes + 1;
+      }
+      return true;
+   }
+
+   struct png_info
+   {
+      int width = 0;
+      int height = 0;
+      int depth = 0;
+      int color = 0;
+      int channels = 0;
+      bool interlaced = false;
+      unsigned char palette[256][4];
+      int palette_size = 0;
+      // Colour key of greyscale and RGB images, in raw samples.
+      bool keyed = false;
+      unsigned key[3] = {};
+   };
+
+   // Sample c of pixel x of an unfiltered row, at the image's bit depth.
+   unsigned png_sample(const png_info& info, const unsigned char* row, int x, int c)
+   {
+      if (info.depth == 8)
+         return row[x * info.channels + c];
+      if (info.depth == 16)
+      {
+         const unsigned char* s = row + (x * info.channels + c) * 2;
+         return unsigned(s[0]) << 8 | s[1];
+      }
+      // Bit depths below 8 only occur with a single channel.
+      const int bit = x * info.depth;
+      return (row[bit >> 3] >> (8 - info.depth - (bit & 7))) & ((1 << info.depth) - 1);
+   }
+
+   void png_pixel(const png_info& info, const unsigned char* row, int x, unsigned char* dst)
+   {
+      if (info.color == 3)
+      {
+         const unsigned index = png_sample(info, row, x, 0);
+         static const unsigned char black[4] = { 0, 0, 0, 255 };
+         memcpy(dst, int(index) < info.palette_size ? info.palette[index] : black, 4);
+         return;
+      }
+      unsigned raw[4];
+      for (int c = 0; c < info.channels; ++c)
+         raw[c] = png_sample(info, row, x, c);
+      unsigned char value[4];
+      for (int c = 0; c < info.channels; ++c)
+      {
+         if (info.depth == 16)
+            value[c] = (unsigned char)(raw[c] >> 8);
+         else
+            value[c] = (unsigned char)(raw[c] * 255 / ((1u << info.depth) - 1));
+      }
+      const bool grey = info.color == 0 || info.color == 4;
+      dst[0] = value[0];
+      dst[1] = value[grey ? 0 : 1];
+      dst[2] = value[grey ? 0 : 2];
+      if (info.color == 4 || info.color == 6)
+         dst[3] = value[info.channels - 1];
+      else if (info.keyed && raw[0] == info.key[0] && (grey || (raw[1] == info.key[1] && raw[2] == info.key[2])))
+         dst[3] = 0;
+      else
+         dst[3] = 255;
+   }
+
+   bool png_header(png_info& info, const unsigned char* chunk, uint32_t len)
+   {
+      if (len != 13)
+         return false;
+      const uint32_t width = big_endian32(chunk);
+      const uint32_t height = big_endian32(chunk + 4);
+      if (!width || !height || width > uint32_t(max_image_side) || height > uint32_t(max_image_side))
+         return false;
+      info.width = int(width);
+      info.height = int(height);
+      info.depth = chunk[8];
+      info.color = chunk[9];
+      info.interlaced = chunk[12] == 1;
+      if (chunk[10] || chunk[11] || chunk[12] > 1)
+         return false;
+      const int d = info.depth;
+      switch (info.color)
+      {
+      case 0:
+         info.channels = 1;
+         return d == 1 || d == 2 || d == 4 || d == 8 || d == 16;
+      case 3:
+         info.channels = 1;
+         return d == 1 || d == 2 || d == 4 || d == 8;
+      case 2:
+      case 4:
+      case 6:
+         info.channels = info.color == 2 ? 3 : info.color == 4 ? 2 : 4;
+         return d == 8 || d == 16;
+      default:
+         return false;
+      }
+   }
+
+   // Huffman table of a JPEG scan.
+   struct jpeg_code
+   {
+      int max_code[17];
+      int offsets[17];
+      unsigned char symbols[256];
+      bool defined = false;
+
+      // counts[i] codes of length i + 1. Returns false if they overflow.
+      bool build(const unsigned char* counts, const unsigned char* values, int n)
+      {
+         memcpy(symbols, values, size_t(n));
+         int code = 0;
+         int k = 0;
+         for (int len = 1; len <= 16; ++len)
+         {
+            const int count = counts[len - 1];
+            offsets[len] = k - code;
+            code += count;
+            k += count;
+            if (code > (1 << len))
+               return false;
+            max_code[len] = count ? code - 1 : -1;
+            code <<= 1;
+         }
+         defined = true;
+         return true;
+      }
+   };
+
+   struct jpeg_component
+   {
+      int id = 0;
+      int h = 1;
+      int v = 1;
+      int quant = 0;
+      int dc_table = 0;
+      int ac_table = 0;
+      int dc = 0;
+      // Samples of whole MCUs, stride wide.
+      std::vector<unsigned char> samples;
+      int stride = 0;
+   };
+
+   // Entropy coded segment of a scan. Reads zeros once it reaches a marker.
+   class jpeg_bits
+   {
+   public:
+      jpeg_bits(const unsigned char* data, const unsigned char* end) : p(data), end(end) {}
+
+      unsigned bits(int n)
+      {
+         if (!n)
+            return 0;
+         fill();
+         const unsigned value = buffer >> (32 - n);
+         buffer <<= n;
+         count -= n;
+         return value;
+      }
+
+      int decode(const jpeg_code& code)
+      {
+         fill();
+         int value = 0;
+         for (int len = 1; len <= 16; ++len)
+         {
+            value = value << 1 | int(buffer >> 31);
+            buffer <<= 1;
+            --count;
+            if (value <= code.max_code[len])
+               return code.symbols[code.offsets[len] + value];
+         }
+         return -1;
+      }
+
+      // Value of an n bit coefficient.
+      int receive(int n)
+      {
+         const int value = int(bits(n));
+         return n && value < (1 << (n - 1)) ? value - (1 << n) + 1 : value;
+      }
+
+      // Skip to the restart marker after the current interval. Returns false
+      // if there is none.
+      bool restart()
+      {
+         buffer = 0;
+         count = 0;
+         while (p + 1 < end && !(p[0] == 0xff && p[1] >= 0xd0 && p[1] <= 0xd7))
+            ++p;
+         if (p + 1 >= end)
+            return false;
+         p += 2;
+         return true;
+      }
+
+      // Where the scan's data ends.
+      const unsigned char* position()
+      {
+         while (p + 1 < end && !(p[0] == 0xff && p[1] && (p[1] < 0xd0 || p[1] > 0xd7)))
+            ++p;
+         return p;
+      }
+
+   private:
+      void fill()
+      {
+         while (count <= 24)
+         {
+            unsigned byte = 0;
+            if (p < end && *p != 0xff)
+               byte = *p++;
+            else if (p + 1 < end && p[1] == 0)
+            {
+               byte = 0xff;
+               p += 2;
+            }
+            buffer |= byte << (24 - count);
+            count += 8;
+         }
+      }
+
+      const unsigned char* p;
+      const unsigned char* end;
+      uint32_t buffer = 0;
+      int count = 0;
+   };
+
+   // Natural order of the coefficients in zigzag order.
+   const unsigned char zigzag[64] = { 0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                      12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                      35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                      58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+   // Scaled cosines of the inverse DCT, by sample and frequency.
+   struct idct_basis
+   {
+      float weights[8][8];
+
+      idct_basis()
+      {
+         for (int x = 0; x < 8; ++x)
+         {
+            for (int u = 0; u < 8; ++u)
+               weights[x][u] = float((u ? 1.0 : sqrt(0.5)) * cos((2 * x + 1) * u * M_PI / 16.0) / 2.0);
+         }
+      }
+   };
+
+   // Separable inverse DCT of coefficients into an 8x8 block of samples.
+   void jpeg_idct(const float* coefficients, unsigned char* out, int stride)
+   {
+      // Images are decoded on the channel worker and the UI thread.
+      static const idct_basis idct;
+      const auto& basis = idct.weights;
+      float rows[64];
+      for (int v = 0; v < 8; ++v)
+      {
+         for (int x = 0; x < 8; ++x)
+         {
+            float sum = 0.0f;
+            for (int u = 0; u < 8; ++u)
+               sum += basis[x][u] * coefficients[v * 8 + u];
+            rows[v * 8 + x] = sum;
+         }
+      }
+      for (int y = 0; y < 8; ++y)
+      {
+         for (int x = 0; x < 8; ++x)
+         {
+            float sum = 128.0f;
+            for (int v = 0; v < 8; ++v)
+               sum += basis[y][v] * rows[v * 8 + x];
+            out[y * stride + x] = (unsigned char)std::min(std::max(int(lrintf(sum)), 0), 255);
+         }
+      }
+   }
+
+   struct jpeg_decoder
+   {
+      unsigned short quant[4][64];
+      jpeg_code dc_codes[4];
+      jpeg_code ac_codes[4];
+      jpeg_component components[3];
+      int component_count = 0;
+      int width = 0;
+      int height = 0;
+      int h_max = 1;
+      int v_max = 1;
+      int mcus_x = 0;
+      int mcus_y = 0;
+      int restart_interval = 0;
+
+      bool frame(const unsigned char* p, size_t len)
+      {
+         if (len < 6 || p[0] != 8)
+            return false;
+         height = p[1] << 8 | p[2];
+         width = p[3] << 8 | p[4];
+         component_count = p[5];
+         // A height of 0 would be given by a DNL marker after the scan.
+         if (!width || !height || width > max_image_side || height > max_image_side
+             || (component_count != 1 && component_count != 3) || len < size_t(6 + 3 * component_count))
+            return false;
+         for (int i = 0; i < component_count; ++i)
+         {
+            jpeg_component& c = components[i];
+            c.id = p[6 + i * 3];
+            c.h = p[7 + i * 3] >> 4;
+            c.v = p[7 + i * 3] & 15;
+            c.quant = p[8 + i * 3];
+            if (c.h < 1 || c.h > 4 || c.v < 1 || c.v > 4 || c.quant > 3)
+               return false;
+            h_max = std::max(h_max, c.h);
+            v_max = std::max(v_max, c.v);
+         }
+         mcus_x = (width + 8 * h_max - 1) / (8 * h_max);
+         mcus_y = (height + 8 * v_max - 1) / (8 * v_max);
+         for (int i = 0; i < component_count; ++i)
+         {
+            jpeg_component& c = components[i];
+            c.stride = mcus_x * c.h * 8;
+            c.samples.assign(size_t(c.stride) * mcus_y * c.v * 8, 0);
+         }
+         return true;
+      }
+
+      bool quant_tables(const unsigned char* p, size_t len)
+      {
+         while (len)
+         {
+            const int precision = p[0] >> 4;
+            const int id = p[0] & 15;
+            const size_t size = 1 + 64 * (precision ? 2 : 1);
+            if (id > 3 || precision > 1 || len < size)
+               return false;
+            for (int k = 0; k < 64; ++k)
+               quant[id][k] = precision ? (unsigned short)(p[1 + k * 2] << 8 | p[2 + k * 2]) : p[1 + k];
+            p += size;
+            len -= size;
+         }
+         return true;
+      }
+
+      bool huffman_tables(const unsigned char* p, size_t len)
+      {
+         while (len)
+         {
+            if (len < 17)
+               return false;
+            const int type = p[0] >> 4;
+            const int id = p[0] & 15;
+            int n = 0;
+            for (int i = 0; i < 16; ++i)
+               n += p[1 + i];
+            if (type > 1 || id > 3 || n > 256 || len < size_t(17 + n))
+               return false;
+            jpeg_code& code = type ? ac_codes[id] : dc_codes[id];
+            if (!code.build(p + 1, p + 17, n))
+               return false;
+            p += 17 + n;
+            len -= size_t(17 + n);
+         }
+         return true;
+      }
+
+      bool block(jpeg_bits& in, jpeg_component& c, int block_x, int block_y)
+      {
+         const jpeg_code& dc = dc_codes[c.dc_table];
+         const jpeg_code& ac = ac_codes[c.ac_table];
+         const unsigned short* q = quant[c.quant];
+         float coefficients[64] = {};
+         const int dc_bits = in.decode(dc);
+         if (dc_bits < 0 || dc_bits > 11)
+            return false;
+         c.dc += in.receive(dc_bits);
+         coefficients[0] = float(c.dc * q[0]);
+         for (int k = 1; k < 64;)
+         {
+            const int rs = in.decode(ac);
+            if (rs < 0)
+               return false;
+            const int run = rs >> 4;
+            const int size = rs & 15;
+            if (!size)
+            {
+               if (run != 15)
+                  break;
+               k += 16;
+               continue;
+            }
+            k += run;
+            if (k > 63)
+               return false;
+            coefficients[zigzag[k]] = float(in.receive(size) * q[k]);
+            ++k;
+         }
+         jpeg_idct(coefficients, c.samples.data() + size_t(block_y) * 8 * c.stride + block_x * 8, c.stride);
+         return true;
+      }
+
+      // Decode the scan whose header is p and return where its data ends, or
+      // null on error.
+      const unsigned char* scan(const unsigned char* p, size_t len, const unsigned char* end)
+      {
+         if (!width || len < 1)
+            return nullptr;
+         const int count = p[0];
+         if (count < 1 || count > component_count || len != size_t(4 + 2 * count))
+            return nullptr;
+         jpeg_component* scanned[3];
+         for (int i = 0; i < count; ++i)
+         {
+            const int id = p[1 + i * 2];
+            const int tables = p[2 + i * 2];
+            scanned[i] = nullptr;
+            for (int j = 0; j < component_count; ++j)
+            {
+               if (components[j].id == id)
+                  scanned[i] = &components[j];
+            }
+            if (!scanned[i] || (tables >> 4) > 3 || (tables & 15) > 3)
+               return nullptr;
+            scanned[i]->dc_table = tables >> 4;
+            scanned[i]->ac_table = tables & 15;
+            scanned[i]->dc = 0;
+            if (!dc_codes[tables >> 4].defined || !ac_codes[tables & 15].defined)
+               return nullptr;
+         }
+
+         jpeg_bits in(p + len, end);
+         // A scan of one component covers only its own blocks, one per MCU.
+         const jpeg_component& first = *scanned[0];
+         const int units_x = count == 1 ? ((width * first.h + h_max - 1) / h_max + 7) / 8 : mcus_x;
+         const int units_y = count == 1 ? ((height * first.v + v_max - 1) / v_max + 7) / 8 : mcus_y;
+         int until_restart = restart_interval;
+         for (int y = 0; y < units_y; ++y)
+         {
+            for (int x = 0; x < units_x; ++x)
+            {
+               if (restart_interval && !until_restart--)
+               {
+                  if (!in.restart())
+                     return nullptr;
+                  for (int i = 0; i < count; ++i)
+                     scanned[i]->dc = 0;
+                  until_restart = restart_interval - 1;
+               }
+               if (count == 1)
+               {
+                  if (!block(in, *scanned[0], x, y))
+                     return nullptr;
+                  continue;
+               }
+               for (int i = 0; i < count; ++i)
+               {
+                  jpeg_component& c = *scanned[i];
+                  for (int v = 0; v < c.v; ++v)
+                  {
+                     for (int h = 0; h < c.h; ++h)
+                     {
+                        if (!block(in, c, x * c.h + h, y * c.v + v))
+                           return nullptr;
+                     }
+                  }
+               }
+            }
+         }
+         return in.position();
+      }
+
+      void convert(std::vector<unsigned char>& rgba) const
+      {
+         rgba.resize(size_t(width) * height * 4);
+         for (int y = 0; y < height; ++y)
+         {
+            unsigned char* dst = rgba.data() + size_t(height - 1 - y) * width * 4;
+            for (int x = 0; x < width; ++x)
+            {
+               // Subsampled components are upsampled by repeating samples.
+               float sample[3];
+               for (int i = 0; i < component_count; ++i)
+               {
+                  const jpeg_component& c = components[i];
+                  sample[i] = c.samples[size_t(y * c.v / v_max) * c.stride + x * c.h / h_max];
+               }
+               if (component_count == 1)
+                  dst[0] = dst[1] = dst[2] = (unsigned char)sample[0];
+               else
+               {
+                  const float cb = sample[1] - 128.0f;
+                  const float cr = sample[2] - 128.0f;
+                  const float rgb[3] = { sample[0] + 1.402f * cr, sample[0] - 0.344136f * cb - 0.714136f * cr,
+                                         sample[0] + 1.772f * cb };
+                  for (int c = 0; c < 3; ++c)
+                     dst[c] = (unsigned char)std::min(std::max(int(lrintf(rgb[c])), 0), 255);
+               }
+               dst[3] = 255;
+               dst += 4;
+            }
+         }
+      }
+   };
+}
+
+bool decode_pnm(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+   if (len < 2 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+      return false;
+   const int channels = data[1] == '6' ? 3 : 1;
+   const char* p = data + 2;
+   const char* end = data + len;
+   int maxval = 0;
+   if (!pnm_number(p, end, width) || !pnm_number(p, end, height) || !pnm_number(p, end, maxval))
+      return false;
+   // A single whitespace character separates the header from the samples.
+   ++p;
+   if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535)
+      return false;
+   const size_t sample_bytes = maxval > 255 ? 2 : 1;
+   const size_t row_bytes = size_t(width) * channels * sample_bytes;
+   if (p > end || size_t(end - p) < row_bytes * height)
+      return false;
+
+   rgba.resize(size_t(width) * height * 4);
+   for (int y = 0; y < height; ++y)
+   {
+      const unsigned char* src = reinterpret_cast<const unsigned char*>(p) + row_bytes * y;
+      unsigned char* dst = rgba.data() + size_t(height - 1 - y) * width * 4;
+      for (int x = 0; x < width; ++x)
+      {
+         unsigned char rgb[3];
+         for (int c = 0; c < channels; ++c)
+         {
+            unsigned value = *src++;
+            if (sample_bytes == 2)
+               value = value << 8 | *src++;
+            rgb[c] = maxval == 255 ? (unsigned char)value : (unsigned char)(value * 255 / maxval);
+         }
+         dst[0] = rgb[0];
+         dst[1] = rgb[channels == 3 ? 1 : 0];
+         dst[2] = rgb[channels == 3 ? 2 : 0];
+         dst[3] = 255;
+         dst += 4;
+      }
+   }
+   return true;
+}
+
+bool decode_png(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+   static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+   const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+   const unsigned char* end = p + len;
+   if (len < 8 || memcmp(p, signature, 8))
+      return false;
+   p += 8;
+
+   png_info info;
+   std::vector<unsigned char> compressed;
+   bool ended = false;
+   while (!ended)
+   {
+      if (end - p < 12)
+         return false;
+      const uint32_t chunk_len = big_endian32(p);
+      const unsigned char* type = p + 4;
+      const unsigned char* chunk = p + 8;
+      if (chunk_len > size_t(end - chunk) - 4)
+         return false;
+      p = chunk + chunk_len + 4;
+      // The header has to come first.
+      if (!info.width && memcmp(type, "IHDR", 4))
+         return false;
+      if (!memcmp(type, "IHDR", 4))
+      {
+         if (info.width || !png_header(info, chunk, chunk_len))
+            return false;
+      }
+      else if (!memcmp(type, "PLTE", 4))
+      {
+         if (chunk_len % 3 || chunk_len > 768)
+            return false;
+         info.palette_size = int(chunk_len / 3);
+         for (int i = 0; i < info.palette_size; ++i)
+         {
+            memcpy(info.palette[i], chunk + i * 3, 3);
+            info.palette[i][3] = 255;
+         }
+      }
+      else if (!memcmp(type, "tRNS", 4))
+      {
+         if (info.color == 3)
+         {
+            for (uint32_t i = 0; i < chunk_len && int(i) < info.palette_size; ++i)
+               info.palette[i][3] = chunk[i];
+         }
+         else if ((info.color == 0 && chunk_len == 2) || (info.color == 2 && chunk_len == 6))
+         {
+            info.keyed = true;
+            for (uint32_t i = 0; i < chunk_len / 2; ++i)
+               info.key[i] = unsigned(chunk[i * 2]) << 8 | chunk[i * 2 + 1];
+         }
+      }
+      else if (!memcmp(type, "IDAT", 4))
+         compressed.insert(compressed.end(), chunk, chunk + chunk_len);
+      else if (!memcmp(type, "IEND", 4))
+         ended = true;
+      // Other critical chunks change how the image is read.
+      else if (!(type[0] & 32))
+         return false;
+   }
+   if (info.color == 3 && !info.palette_size)
+      return false;
+
+   // Adam7 passes, or the whole image at once.
+   static const int pass_x[7] = { 0, 4, 0, 2, 0, 1, 0 };
+   static const int pass_y[7] = { 0, 0, 4, 0, 2, 0, 1 };
+   static const int step_x[7] = { 8, 8, 4, 4, 2, 2, 1 };
+   static const int step_y[7] = { 8, 8, 8, 4, 4, 2, 2 };
+   const int passes = info.interlaced ? 7 : 1;
+   const size_t pixel_bits = size_t(info.channels) * info.depth;
+   size_t expected = 0;
+   int pass_width[7], pass_height[7];
+   for (int pass = 0; pass < passes; ++pass)
+   {
+      const int x0 = info.interlaced ? pass_x[pass] : 0;
+      const int y0 = info.interlaced ? pass_y[pass] : 0;
+      const int dx = info.interlaced ? step_x[pass] : 1;
+      const int dy = info.interlaced ? step_y[pass] : 1;
+      pass_width[pass] = info.width > x0 ? (info.width - x0 + dx - 1) / dx : 0;
+      pass_height[pass] = info.height > y0 ? (info.height - y0 + dy - 1) / dy : 0;
+      if (pass_width[pass] && pass_height[pass])
+         expected += ((pass_width[pass] * pixel_bits + 7) / 8 + 1) * pass_height[pass];
+   }
+
+   std::vector<unsigned char> raw;
+   inflater stream(compressed.data(), compressed.size());
+   if (!stream.inflate(raw, expected))
+      return false;
+
+   width = info.width;
+   height = info.height;
+   rgba.resize(size_t(width) * height * 4);
+   unsigned char* rows = raw.data();
+   for (int pass = 0; pass < passes; ++pass)
+   {
+      if (!pass_width[pass] || !pass_height[pass])
+         continue;
+      const size_t row_bytes = (pass_width[pass] * pixel_bits + 7) / 8;
+      if (!unfilter(rows, row_bytes, pass_height[pass], std::max<size_t>(1, pixel_bits / 8)))
+         return false;
+      const int x0 = info.interlaced ? pass_x[pass] : 0;
+      const int y0 = info.interlaced ? pass_y[pass] : 0;
+      const int dx = info.interlaced ? step_x[pass] : 1;
+      const int dy = info.interlaced ? step_y[pass] : 1;
+      for (int y = 0; y < pass_height[pass]; ++y)
+      {
+         const unsigned char* row = rows + y * (row_bytes + 1) + 1;
+         unsigned char* dst = rgba.data() + (size_t(height - 1 - (y0 + y * dy)) * width + x0) * 4;
+         for (int x = 0; x < pass_width[pass]; ++x)
+            png_pixel(info, row, x, dst + size_t(x) * dx * 4);
+      }
+      rows += (row_bytes + 1) * pass_height[pass];
+   }
+   return true;
+}
+
+bool decode_jpeg(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+   const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+   const unsigned char* end = p + len;
+   if (len < 4 || p[0] != 0xff || p[1] != 0xd8)
+      return false;
+   p += 2;
+
+   std::unique_ptr<jpeg_decoder> decoder(new jpeg_decoder);
+   bool scanned = false;
+   for (;;)
+   {
+      // Markers may be padded with any number of 0xff.
+      if (p >= end || *p != 0xff)
+         return false;
+      while (p < end && *p == 0xff)
+         ++p;
+      if (p >= end)
+         return false;
+      const unsigned char marker = *p++;
+      if (marker == 0xd9)
+         break;
+      if (marker >= 0xd0 && marker <= 0xd7)
+         continue;
+      if (end - p < 2)
+         return false;
+      const size_t segment = size_t(p[0] << 8 | p[1]);
+      if (segment < 2 || size_t(end - p) < segment)
+         return false;
+      const unsigned char* body = p + 2;
+      const size_t body_len = segment - 2;
+      p += segment;
+      bool ok = true;
+      switch (marker)
+      {
+      case 0xc0:
+      case 0xc1:
+         ok = !decoder->width && decoder->frame(body, body_len);
+         break;
+      case 0xc4:
+         ok = decoder->huffman_tables(body, body_len);
+         break;
+      case 0xdb:
+         ok = decoder->quant_tables(body, body_len);
+         break;
+      case 0xdd:
+         ok = body_len == 2;
+         if (ok)
+            decoder->restart_interval = body[0] << 8 | body[1];
+         break;
+      case 0xda:
+         p = decoder->scan(body, body_len, end);
+         ok = p != nullptr;
+         scanned = true;
+         break;
+      default:
+         // Progressive, lossless and arithmetic coded frames.
+         if (marker >= 0xc2 && marker <= 0xcf)
+            ok = false;
+         break;
+      }
+      if (!ok)
+         return false;
+   }
+   if (!scanned)
+      return false;
+   width = decoder->width;
+   height = decoder->height;
+   decoder->convert(rgba);
+   return true;
+}
+
+bool decode_image(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba)
+{
+   if (len >= 8 && !memcmp(data, "\x89PNG", 4))
+      return decode_png(data, len, width, height, rgba);
+   if (len >= 2 && (unsigned char)data[0] == 0xff && (unsigned char)data[1] == 0xd8)
+      return decode_jpeg(data, len, width, height, rgba);
+   return decode_pnm(data, len, width, height, rgba);
+}
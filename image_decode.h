@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <vector>
+
+// Image decoders for the channel and Shadertoy textures. Each one writes
+// RGBA8 rows, bottom row first as glTexImage2D expects, and returns false if
+// data is no such image or one it cannot decode. rgba keeps its capacity, so
+// reused buffers do not allocate for the pixels themselves.
+
+// Binary PGM (P5) or PPM (P6).
+bool decode_pnm(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba);
+
+// PNG of any colour type and bit depth, interlaced or not. 16 bit samples
+// are cut to 8 bits and gamma and colour profile chunks are ignored.
+bool decode_png(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba);
+
+// Baseline JPEG in greyscale or YCbCr with any chroma subsampling.
+// Progressive and arithmetic coded JPEGs are not supported.
+bool decode_jpeg(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba);
+
+// Any of the above, picked by the leading bytes of data.
+bool decode_image(const char* data, size_t len, int& width, int& height, std::vector<unsigned char>& rgba);
@@ -0,0 +1,76 @@
+#include "input_latency.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <thread>
+
+const double input_sampler::poll_interval = 0.001;
+
+void input_sampler::publish(double mouse_x, double mouse_y, double time)
+{
+   samples.write_buffer() = { mouse_x, mouse_y, time };
+   samples.publish();
+}
+
+void input_sampler::poll_until(GLFWwindow* window, double deadline)
+{
+   while (glfwGetTime() < deadline)
+   {
+      std::this_thread::sleep_for(std::chrono::duration<double>(poll_interval));
+      glfwPollEvents();
+      double x, y;
+      glfwGetCursorPos(window, &x, &y);
+      publish(x, y, glfwGetTime());
+   }
+}
+
+void input_sampler::take(frame_values& values)
+{
+   samples.update();
+   const input_sample& input = samples.read_buffer();
+   values.mouse_x = input.mouse_x;
+   values.mouse_y = input.mouse_y;
+   values.input_time = input.time;
+}
+
+void latency_monitor::set_probing(bool probing)
+{
+   if (probing == probe.active())
+      return;
+   if (probing)
+      probe.init();
+   else
+      probe.destroy();
+}
+
+void latency_monitor::frame_submitted(double input_time)
+{
+   if (probe.active())
+      probe.frame_submitted(input_time);
+}
+
+void latency_monitor::frame_swapped(double swap_time)
+{
+   if (probe.active())
+      probe.frame_swapped(swap_time);
+}
+
+void latency_monitor::results(latency_results& out) const
+{
+   out.probing = probe.active();
+   if (!out.probing)
+      return;
+   out.gpu_done = probe.gpu_done();
+   out.swapped = probe.swapped();
+   out.recent_swapped = probe.recent_swapped();
+}
+
+void latency_monitor::finish(bool report)
+{
+   if (!probe.active())
+      return;
+   if (report)
+      print_latency(stdout, probe.gpu_done(), probe.swapped());
+   probe.destroy();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include <vector>
+
+#include "benchmark.h"
+#include "frame_values.h"
+#include "triple_buffer.h"
+
+// The cursor as read at some moment.
+struct input_sample
+{
+   double mouse_x = 0.0;
+   double mouse_y = 0.0;
+   // glfwGetTime() when the cursor was read.
+   double time = 0.0;
+};
+
+// The newest cursor sample, handed from the UI thread to the render thread.
+// Sampling input late, the UI thread keeps polling events while it waits for
+// the next frame and the render thread takes the newest sample just before
+// it draws instead of the one of the UI frame.
+class input_sampler
+{
+public:
+   // UI thread: publish a sample.
+   void publish(double mouse_x, double mouse_y, double time);
+   // UI thread: keep polling events and sampling the cursor of window until
+   // deadline.
+   void poll_until(GLFWwindow* window, double deadline);
+   // Render thread: replace the mouse and input time of values with the
+   // newest sample.
+   void take(frame_values& values);
+
+private:
+   static const double poll_interval;
+
+   triple_buffer<input_sample> samples;
+};
+
+// What the render thread measured of input-to-display latency.
+struct latency_results
+{
+   bool probing = false;
+   latency_summary gpu_done;
+   latency_summary swapped;
+   std::vector<float> recent_swapped;
+};
+
+// The render thread's latency probe, on while frames ask for it.
+class latency_monitor
+{
+public:
+   // Start or stop probing.
+   void set_probing(bool probing);
+   // The frame tagged with input_time was submitted and then swapped at
+   // swap_time. Ignored unless probing.
+   void frame_submitted(double input_time);
+   void frame_swapped(double swap_time);
+   // Copy the results into out; only the flag unless probing.
+   void results(latency_results& out) const;
+   // Stop probing, printing the results first if report is set.
+   void finish(bool report);
+
+private:
+   latency_probe probe;
+};
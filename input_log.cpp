@@ -0,0 +1,213 @@
+#include "input_log.h"
+
+#include <string.h>
+
+namespace {
+   const char log_magic[4] = { 'S', 'D', 'F', 'I' };
+   // Version 1 had no drag, version 2 no repeat flag.
+   const uint32_t log_version = 3;
+
+   enum changed_fields : uint8_t
+   {
+      changed_time = 1 << 0,
+      changed_mouse = 1 << 1,
+      changed_size = 1 << 2,
+      changed_shininess = 1 << 3,
+      changed_color = 1 << 4,
+      changed_settings = 1 << 5,
+      changed_drag = 1 << 6,
+      // Not a group of fields, set on frames drawn again.
+      repeated_frame = 1 << 7,
+   };
+
+   template <typename T>
+   void put(std::vector<unsigned char>& out, T value)
+   {
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+      out.insert(out.end(), bytes, bytes + sizeof(T));
+   }
+
+   // Reads a T at p, returning false past end.
+   template <typename T>
+   bool get(const unsigned char*& p, const unsigned char* end, T& value)
+   {
+      if (size_t(end - p) < sizeof(T))
+         return false;
+      memcpy(&value, p, sizeof(T));
+      p += sizeof(T);
+      return true;
+   }
+
+   // Size is stored as 16 bit, which covers any window.
+   uint16_t clamp_size(int size) { return uint16_t(size < 0 ? 0 : size > 65535 ? 65535 : size); }
+}
+
+bool input_log_writer::open(const char* path)
+{
+   close();
+   file = fopen(path, "wb");
+   if (!file)
+   {
+      fprintf(stderr, "Failed to write %s\n", path);
+      return false;
+   }
+   fwrite(log_magic, 1, sizeof(log_magic), file);
+   fwrite(&log_version, sizeof(log_version), 1, file);
+   last = recorded_frame();
+   count = 0;
+   return true;
+}
+
+void input_log_writer::close()
+{
+   if (file)
+      fclose(file);
+   file = nullptr;
+}
+
+void input_log_writer::write(const recorded_frame& frame)
+{
+   if (!file)
+      return;
+   std::vector<unsigned char> fields;
+   uint8_t changed = 0;
+   // Every frame after the first takes time; the first has no delta.
+   const float delta = float(frame.time - last.time);
+   if (delta != 0.0f || count == 0)
+   {
+      changed |= changed_time;
+      put(fields, delta);
+      last.time += delta;
+   }
+   if (frame.mouse_x != last.mouse_x || frame.mouse_y != last.mouse_y || count == 0)
+   {
+      changed |= changed_mouse;
+      put(fields, frame.mouse_x);
+      put(fields, frame.mouse_y);
+   }
+   if (frame.width != last.width || frame.height != last.height || count == 0)
+   {
+      changed |= changed_size;
+      put(fields, clamp_size(frame.width));
+      put(fields, clamp_size(frame.height));
+   }
+   if (frame.shininess != last.shininess || count == 0)
+   {
+      changed |= changed_shininess;
+      put(fields, frame.shininess);
+   }
+   if (memcmp(frame.object_color, last.object_color, sizeof(frame.object_color)) != 0 || count == 0)
+   {
+      changed |= changed_color;
+      for (float c : frame.object_color)
+         put(fields, c);
+   }
+   if (!same_settings(frame, last) || count == 0)
+   {
+      changed |= changed_settings;
+      put(fields, frame.program_key);
+      put(fields, uint8_t(frame.interleave_cells));
+      put(fields, uint8_t(frame.cone_prepass_scale));
+      put(fields, frame.history_blend);
+   }
+   if (memcmp(frame.drag, last.drag, sizeof(frame.drag)) != 0 || count == 0)
+   {
+      changed |= changed_drag;
+      for (float d : frame.drag)
+         put(fields, d);
+   }
+   if (frame.repeat)
+      changed |= repeated_frame;
+   fputc(changed, file);
+   fwrite(fields.data(), 1, fields.size(), file);
+
+   const double time = last.time;
+   last = frame;
+   last.time = time;
+   last.width = clamp_size(frame.width);
+   last.height = clamp_size(frame.height);
+   ++count;
+}
+
+bool read_input_log(const char* path, std::vector<recorded_frame>& frames)
+{
+   frames.clear();
+   FILE* file = fopen(path, "rb");
+   if (!file)
+   {
+      fprintf(stderr, "Failed to read %s\n", path);
+      return false;
+   }
+   std::vector<unsigned char> data;
+   unsigned char buffer[4096];
+   size_t read;
+   while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+      data.insert(data.end(), buffer, buffer + read);
+   fclose(file);
+
+   const unsigned char* p = data.data();
+   const unsigned char* end = p + data.size();
+   uint32_t version = 0;
+   if (data.size() < sizeof(log_magic) || memcmp(p, log_magic, sizeof(log_magic)) != 0)
+   {
+      fprintf(stderr, "%s is no input log\n", path);
+      return false;
+   }
+   p += sizeof(log_magic);
+   if (!get(p, end, version) || version < 1 || version > log_version)
+   {
+      fprintf(stderr, "%s has unsupported input log version %u\n", path, version);
+      return false;
+   }
+
+   recorded_frame frame;
+   while (p < end)
+   {
+      const uint8_t changed = *p++;
+      bool ok = true;
+      if (changed & changed_time)
+      {
+         float delta = 0.0f;
+         ok &= get(p, end, delta);
+         frame.time += delta;
+      }
+      if (changed & changed_mouse)
+         ok &= get(p, end, frame.mouse_x) && get(p, end, frame.mouse_y);
+      if (changed & changed_size)
+      {
+         uint16_t width = 0, height = 0;
+         ok &= get(p, end, width) && get(p, end, height);
+         frame.width = width;
+         frame.height = height;
+      }
+      if (changed & changed_shininess)
+         ok &= get(p, end, frame.shininess);
+      if (changed & changed_color)
+      {
+         for (float& c : frame.object_color)
+            ok &= get(p, end, c);
+      }
+      if (changed & changed_settings)
+      {
+         uint8_t cells = 1, scale = 1;
+         ok &= get(p, end, frame.program_key) && get(p, end, cells) && get(p, end, scale)
+               && get(p, end, frame.history_blend);
+         frame.interleave_cells = cells;
+         frame.cone_prepass_scale = scale;
+      }
+      if (changed & changed_drag)
+      {
+         for (float& d : frame.drag)
+            ok &= get(p, end, d);
+      }
+      frame.repeat = (changed & repeated_frame) != 0;
+      if (!ok)
+      {
+         // A recording cut short, e.g. by a crash, keeps its whole frames.
+         fprintf(stderr, "%s ends within a frame, replaying %zu frames\n", path, frames.size());
+         break;
+      }
+      frames.push_back(frame);
+   }
+   return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+// Inputs of one drawn frame: what draw_quad() was given and the rendering
+// settings the properties window had selected.
+struct recorded_frame
+{
+   // iTime of the frame, in seconds.
+   double time = 0.0;
+   int width = 0;
+   int height = 0;
+   float mouse_x = 0.0f;
+   float mouse_y = 0.0f;
+   float shininess = 0.0f;
+   float object_color[4] = {};
+   // Shadertoy's iMouse, see frame_values::drag.
+   float drag[4] = {};
+   // See frame_values::repeat.
+   bool repeat = false;
+   // main_program_key() and the mode parameters it does not cover.
+   uint64_t program_key = 0;
+   int interleave_cells = 1;
+   int cone_prepass_scale = 1;
+   float history_blend = 0.0f;
+};
+
+// Whether a and b draw with the same shader variant and mode parameters.
+inline bool same_settings(const recorded_frame& a, const recorded_frame& b)
+{
+   return a.program_key == b.program_key && a.interleave_cells == b.interleave_cells
+          && a.cone_prepass_scale == b.cone_prepass_scale && a.history_blend == b.history_blend;
+}
+
+// Writes frames to a compact binary log. After a small header each frame is
+// a byte of flags saying which groups of fields changed since the previous
+// frame, followed by those fields in native byte order. Frame times are
+// stored as float deltas and accumulated the same way on both ends, so a
+// replay sees exactly the times recorded.
+class input_log_writer
+{
+public:
+   input_log_writer() = default;
+   input_log_writer(const input_log_writer&) = delete;
+   input_log_writer& operator=(const input_log_writer&) = delete;
+   ~input_log_writer() { close(); }
+
+   // Returns false if path cannot be written.
+   bool open(const char* path);
+   void close();
+   bool is_open() const { return file != nullptr; }
+   size_t frames() const { return count; }
+
+   void write(const recorded_frame& frame);
+
+private:
+   FILE* file = nullptr;
+   recorded_frame last;
+   size_t count = 0;
+};
+
+// Read every frame of the log at path, times as the writer accumulated them.
+// Returns false if it cannot be read or is no input log.
+bool read_input_log(const char* path, std::vector<recorded_frame>& frames);
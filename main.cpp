@@ -4,11 +4,76 @@
 
 #include "single_quad_app.h"
 
-int main()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parse a count argument of option. Returns false on anything but a
+// positive integer.
+static bool parse_count(const char* option, const char* text, int& out)
+{
+   char* end;
+   const long value = strtol(text, &end, 10);
+   if (end == text || *end || value <= 0 || value > 1000000)
+   {
+      fprintf(stderr, "%s takes a positive number, not %s\n", option, text);
+      return false;
+   }
+   out = int(value);
+   return true;
+}
+
+int main(int argc, char** argv)
 {
    single_quad_app app;
-   app.init();
-   app.run();
+   for (int i = 1; i < argc; ++i)
+   {
+      if (!strcmp(argv[i], "--startup-profile"))
+         app.startup_profile = true;
+      else if (!strcmp(argv[i], "--shader") && i + 1 < argc)
+         app.shader = argv[++i];
+      else if (!strcmp(argv[i], "--project") && i + 1 < argc)
+         app.project_path = argv[++i];
+      else if (!strcmp(argv[i], "--latency"))
+         app.latency_report = true;
+      else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+         app.record_path = argv[++i];
+      else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+         app.replay_path = argv[++i];
+      else if (!strcmp(argv[i], "--corpus") && i + 1 < argc)
+         app.corpus_dir = argv[++i];
+      else if (!strcmp(argv[i], "--corpus-out") && i + 1 < argc)
+         app.corpus_out = argv[++i];
+      else if (!strcmp(argv[i], "--corpus-resolutions") && i + 1 < argc)
+         app.corpus_resolutions = argv[++i];
+      else if (!strcmp(argv[i], "--corpus-threads") && i + 1 < argc)
+      {
+         if (!parse_count(argv[i], argv[i + 1], app.corpus_threads))
+            return 1;
+         ++i;
+      }
+      else if (!strcmp(argv[i], "--benchmark"))
+         app.benchmark = true;
+      else if (!strcmp(argv[i], "--benchmark-frames") && i + 1 < argc)
+      {
+         if (!parse_count(argv[i], argv[i + 1], app.benchmark_frames))
+            return 1;
+         ++i;
+      }
+      else
+         fprintf(stderr, "Unknown argument %s\n", argv[i]);
+   }
+   if (!app.init())
+      return 1;
+   bool ok = true;
+   if (app.corpus_dir)
+      ok = app.run_corpus();
+   else if (app.replay_path)
+      ok = app.run_replay();
+   else if (app.benchmark)
+      ok = app.run_benchmark();
+   else
+      app.run();
    app.destroy();
-   return 0;
+   return ok ? 0 : 1;
 }
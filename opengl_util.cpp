@@ -0,0 +1,102 @@
+#include "opengl_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spirv_cache.h"
+
+bool compile_to_spirv = false;
+bool defer_compile_status = false;
+std::string last_info_log;
+std::vector<shader_diagnostic> shader_errors;
+
+GLuint compile_shader(GLenum shader_type, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+{
+   GLuint shader = glCreateShader(shader_type);
+   glShaderSource(shader, count, strings, lengths);
+   glCompileShader(shader);
+   if (defer_compile_status)
+      return shader;
+   GLint success = 0;
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+   if (success == GL_FALSE)
+   {
+      GLint lsize = 0;
+      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &lsize);
+      last_info_log.clear();
+      if (lsize)
+      {
+         GLchar* errorLog = new GLchar[lsize];
+         glGetShaderInfoLog(shader, lsize, &lsize, errorLog);
+         fprintf(stderr, "Error with shader %s\n", errorLog);
+         last_info_log.assign(errorLog, size_t(lsize));
+         delete[] errorLog;
+      }
+      glDeleteShader(shader);
+      return 0;
+   }
+   return shader;
+}
+
+GLuint compile_shader(GLenum shader_type, const GLchar* shaderSource, GLint len)
+{
+   return compile_shader(shader_type, 1, &shaderSource, &len);
+}
+
+GLuint compile_shader(GLenum shader_type, const shader_source_list& sources)
+{
+   return compile_shader(shader_type, sources.count(), sources.strings.data(), sources.lengths.data());
+}
+
+GLuint compile_shader_from_source(GLenum shader_type, const char* name, const char* src, size_t len,
+                                  const char* prelude, const char* trailer)
+{
+   static source_arena arena;
+   static shader_source_list sources;
+   arena.reset();
+   last_info_log.clear();
+   GLuint shader;
+   if (compile_to_spirv)
+   {
+      std::vector<spirv_constant> constants;
+      const std::string kept = extract_spec_constants(prelude, constants);
+      assemble_shader(sources, arena, src, len, kept.c_str(), trailer);
+      shader = compile_spirv_shader(shader_type, sources, constants);
+   }
+   else
+   {
+      assemble_shader(sources, arena, src, len, prelude, trailer);
+      shader = compile_shader(shader_type, sources);
+   }
+   if (!shader)
+   {
+      fprintf(stderr, "Failed to load shader %s\n", name);
+      shader_source_map map;
+      map.names[source_file] = name;
+      map.texts[source_file] = src;
+      map.lengths[source_file] = len;
+      map.names[source_prelude] = "<prelude>";
+      map.texts[source_prelude] = prelude;
+      map.lengths[source_prelude] = prelude ? strlen(prelude) : 0;
+      map.names[source_trailer] = "<generated>";
+      map.texts[source_trailer] = trailer;
+      map.lengths[source_trailer] = trailer ? strlen(trailer) : 0;
+      parse_info_log(last_info_log.c_str(), &map, shader_errors);
+   }
+   return shader;
+}
+
+GLuint compile_shader_from_file(GLenum shader_type, const char* filename, const char* prelude, const char* trailer)
+{
+   const std::shared_ptr<const mapped_file> file = map_shader_file(filename);
+   if (!file)
+   {
+      shader_diagnostic missing;
+      missing.file = filename;
+      missing.message = "cannot be read";
+      shader_errors.push_back(missing);
+      return 0;
+   }
+   return compile_shader_from_source(shader_type, filename, file->data(), file->size(), prelude, trailer);
+}
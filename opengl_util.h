@@ -1,60 +1,47 @@
+#pragma once
+
 #include <GL/glew.h>
 
-#include <stdio.h>
-#include <stdlib.h>
-
-#include <cctype>
-
-// Compile shader from a file. Return 0 on error.
-GLuint compile_shader(GLenum shader_type, const GLchar* shaderSource, GLint len)
-{
-   GLuint shader = glCreateShader(shader_type);
-   glShaderSource(shader, 1, &shaderSource, &len);
-   glCompileShader(shader);
-   GLint success = 0;
-   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-   if (success == GL_FALSE)
-   {
-      GLint lsize = 0;
-      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &lsize);
-      if (lsize)
-      {
-         GLchar* errorLog = new GLchar[lsize];
-         glGetShaderInfoLog(shader, lsize, &lsize, errorLog);
-         fprintf(stderr, "Error with shader %s\n", errorLog);
-         delete[] errorLog;
-         return 0;
-      }
-   }
-   return shader;
-}
-
-// Compile shader from a file. Return 0 on error.
-GLuint compile_shader_from_file(GLenum shader_type, const char* filename)
-{
-   FILE* fp = fopen(filename, "rb");
-   if (!fp)
-   {
-      fprintf(stderr, "Failed to load shader file %s\n", filename);
-      return 0;
-   }
-   fseek(fp, 0, SEEK_END);
-   const size_t file_size = ftell(fp);
-   rewind(fp);
-   if (!file_size)
-   {
-      fclose(fp);
-      fprintf(stderr, "File is empty %s\n", filename);
-   }
-   char* buffer = new char[file_size + 1];
-   fread(buffer, file_size, 1, fp);
-   buffer[file_size] = '\0';
-   GLuint shader = compile_shader(shader_type, buffer, GLint(file_size));
-   if (!shader)
-   {
-      fprintf(stderr, "Failed to load shader %s\n", filename);
-   }
-   fclose(fp);
-   delete[] buffer;
-   return shader;
-}
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "shader_diagnostics.h"
+#include "shader_source.h"
+
+// Compile files through compile_spirv_shader() instead of the driver's GLSL
+// compiler. Set around the build of a whole program, as SPIR-V and GLSL
+// shaders cannot be linked together.
+extern bool compile_to_spirv;
+
+// Return shaders without waiting for their compile status, so drivers with
+// GL_KHR_parallel_shader_compile can finish them in the background. Errors
+// then only show up as a failed link.
+extern bool defer_compile_status;
+
+// Info log of the last shader that failed to compile.
+extern std::string last_info_log;
+
+// Diagnostics of failed compiles and links since the application last
+// cleared them.
+extern std::vector<shader_diagnostic> shader_errors;
+
+// Compile shader from a list of source strings. Return 0 on error.
+GLuint compile_shader(GLenum shader_type, GLsizei count, const GLchar* const* strings, const GLint* lengths);
+
+// Compile shader from source. Return 0 on error.
+GLuint compile_shader(GLenum shader_type, const GLchar* shaderSource, GLint len);
+
+GLuint compile_shader(GLenum shader_type, const shader_source_list& sources);
+
+// Compile shader from src with prelude injected after its #version line and
+// trailer appended; either may be null. name stands for src in diagnostics.
+// Return 0 on error, with the compile log parsed into shader_errors.
+GLuint compile_shader_from_source(GLenum shader_type, const char* name, const char* src, size_t len,
+                                  const char* prelude = nullptr, const char* trailer = nullptr);
+
+// Compile shader from a file, as compile_shader_from_source() does. The
+// file stays mapped and is only remapped once it changes on disk.
+GLuint compile_shader_from_file(GLenum shader_type, const char* filename, const char* prelude = nullptr,
+                                const char* trailer = nullptr);
@@ -0,0 +1,209 @@
+#include "project_passes.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "image_decode.h"
+#include "opengl_util.h"
+#include "retire_queue.h"
+#include "shader_source.h"
+
+static void delete_project_passes(std::vector<project_pass>& passes)
+{
+   for (project_pass& pass : passes)
+   {
+      glDeleteProgram(pass.program.program);
+      glDeleteTextures(texture_cache::channel_count, pass.textures);
+      glDeleteSamplers(texture_cache::channel_count, pass.samplers);
+   }
+   passes.clear();
+}
+
+// Load the image of a texture input with mipmaps. Returns 0 if it cannot be
+// loaded, which leaves the channel black.
+static GLuint load_project_texture(const shadertoy_input& input, int* size)
+{
+   mapped_file file;
+   std::vector<unsigned char> rgba;
+   int width, height;
+   if (!file.map(input.path.c_str()) || !decode_image(file.data(), file.size(), width, height, rgba))
+   {
+      fprintf(stderr, "Failed to load image %s\n", input.path.c_str());
+      return 0;
+   }
+   // decode_image() gives the bottom row first, which is Shadertoy's vflip.
+   if (!input.vflip)
+   {
+      const size_t row_bytes = size_t(width) * 4;
+      for (int y = 0; y < height / 2; ++y)
+         std::swap_ranges(rgba.begin() + row_bytes * y, rgba.begin() + row_bytes * (y + 1),
+                          rgba.begin() + row_bytes * (height - 1 - y));
+   }
+   GLuint texture;
+   glGenTextures(1, &texture);
+   glBindTexture(GL_TEXTURE_2D, texture);
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+   glGenerateMipmap(GL_TEXTURE_2D);
+   glBindTexture(GL_TEXTURE_2D, 0);
+   size[0] = width;
+   size[1] = height;
+   return texture;
+}
+
+static GLuint create_project_sampler(const shadertoy_input& input)
+{
+   // Buffers have no mipmaps.
+   const bool mipmap = input.mipmap && input.type == shadertoy_input::kind::texture;
+   GLuint sampler;
+   glGenSamplers(1, &sampler);
+   glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER,
+                       input.nearest ? GL_NEAREST : mipmap ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+   glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, input.nearest ? GL_NEAREST : GL_LINEAR);
+   glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, input.repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+   glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, input.repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+   return sampler;
+}
+
+bool project_passes::load(const char* file)
+{
+   shader_errors.clear();
+   shadertoy_project loaded;
+   std::string error;
+   if (!load_shadertoy_project(file, loaded, error))
+   {
+      fprintf(stderr, "Failed to import %s: %s\n", file, error.c_str());
+      shader_diagnostic failed;
+      failed.file = file;
+      failed.message = error;
+      shader_errors.push_back(failed);
+      return false;
+   }
+   const std::string prelude = shadertoy_prelude + loaded.common;
+   std::vector<project_pass> built(loaded.passes.size());
+   for (size_t i = 0; i < built.size(); ++i)
+   {
+      const shadertoy_pass& pass = loaded.passes[i];
+      const std::string name = std::string(file) + ": " + pass.name;
+      const GLuint shader = compile_shader_from_source(GL_FRAGMENT_SHADER, name.c_str(), pass.code.data(),
+                                                       pass.code.size(), prelude.c_str(), shadertoy_trailer);
+      if (!link_quad_program(built[i].program.program, shader))
+      {
+         delete_project_passes(built);
+         return false;
+      }
+      get_frame_uniforms(built[i].program);
+      built[i].buffer = pass.buffer;
+      for (int c = 0; c < texture_cache::channel_count; ++c)
+      {
+         const shadertoy_input& input = pass.inputs[c];
+         built[i].samplers[c] = create_project_sampler(input);
+         if (input.type == shadertoy_input::kind::texture)
+            built[i].textures[c] = load_project_texture(input, built[i].texture_sizes[c]);
+         else if (input.type == shadertoy_input::kind::buffer)
+            built[i].buffer_inputs[c] = input.buffer;
+      }
+   }
+   unload();
+   path = file;
+   source = std::move(loaded);
+   passes = std::move(built);
+   return true;
+}
+
+void project_passes::unload()
+{
+   std::vector<project_pass> retired;
+   retired.swap(passes);
+   if (!retired.empty())
+      retire([retired]() mutable { delete_project_passes(retired); });
+   source = shadertoy_project();
+   path.clear();
+   ++generation;
+}
+
+void project_drawing::destroy()
+{
+   for (auto& targets : buffers)
+   {
+      targets[0].destroy();
+      targets[1].destroy();
+   }
+   std::fill(current, current + 4, 0);
+}
+
+void project_drawing::update(unsigned project_generation)
+{
+   if (project_generation == generation)
+      return;
+   destroy();
+   generation = project_generation;
+}
+
+void project_drawing::draw(const std::vector<project_pass>& passes, const frame_values& frame, GLuint framebuffer)
+{
+   for (const project_pass& pass : passes)
+   {
+      if (pass.buffer < 0)
+         continue;
+      for (render_target& target : buffers[pass.buffer])
+      {
+         if (!target.fbo)
+            target.init({ GL_RGBA32F });
+         if (target.resize(frame.width, frame.height))
+         {
+            target.bind();
+            glClear(GL_COLOR_BUFFER_BIT);
+         }
+      }
+   }
+   for (const project_pass& pass : passes)
+   {
+      // Buffers step once per frame, a repeat only draws the image again.
+      if (pass.buffer >= 0 && frame.repeat)
+         continue;
+      float resolution[texture_cache::channel_count][3] = {};
+      for (int c = 0; c < texture_cache::channel_count; ++c)
+      {
+         const int input = pass.buffer_inputs[c];
+         GLuint texture = pass.textures[c];
+         resolution[c][0] = float(pass.texture_sizes[c][0]);
+         resolution[c][1] = float(pass.texture_sizes[c][1]);
+         resolution[c][2] = 1.0f;
+         if (input >= 0)
+         {
+            const render_target& read = buffers[input][current[input]];
+            texture = read.textures.empty() ? 0 : read.textures[0];
+            resolution[c][0] = float(read.width);
+            resolution[c][1] = float(read.height);
+         }
+         glActiveTexture(GL_TEXTURE0 + first_channel_unit + c);
+         glBindTexture(GL_TEXTURE_2D, texture);
+         glBindSampler(first_channel_unit + c, pass.samplers[c]);
+      }
+      glActiveTexture(GL_TEXTURE0);
+
+      int written = 0;
+      if (pass.buffer >= 0)
+      {
+         written = 1 - current[pass.buffer];
+         buffers[pass.buffer][written].bind();
+      }
+      else
+      {
+         glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+         glViewport(0, 0, frame.width, frame.height);
+      }
+      glUseProgram(pass.program.program);
+      set_frame_uniforms(pass.program, frame.width, frame.height, frame.mouse_x, frame.mouse_y, frame.shininess,
+                         frame.object_color);
+      glUniform3fv(pass.program.channel_resolution_uniform, texture_cache::channel_count, resolution[0]);
+      draw_fullscreen();
+      if (pass.buffer >= 0)
+         current[pass.buffer] = written;
+   }
+   for (int c = 0; c < texture_cache::channel_count; ++c)
+      glBindSampler(first_channel_unit + c, 0);
+}
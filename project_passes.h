@@ -0,0 +1,71 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "frame_values.h"
+#include "quad_program.h"
+#include "render_target.h"
+#include "shadertoy.h"
+#include "texture_channels.h"
+
+// A pass of the imported Shadertoy project.
+struct project_pass
+{
+   quad_program program = {};
+   // Buffer the pass writes, -1 for the image pass.
+   int buffer = -1;
+   // Buffer each channel reads, -1 for the other inputs.
+   int buffer_inputs[texture_cache::channel_count] = { -1, -1, -1, -1 };
+   // Images of the texture inputs, by channel, and their sizes.
+   GLuint textures[texture_cache::channel_count] = {};
+   int texture_sizes[texture_cache::channel_count][2] = {};
+   // Filter and wrap modes of every input.
+   GLuint samplers[texture_cache::channel_count] = {};
+};
+
+// Shadertoy project drawn instead of the active shader while it has passes.
+// Loaded by the UI thread.
+class project_passes
+{
+public:
+   std::string path;
+   shadertoy_project source;
+   std::vector<project_pass> passes;
+   // Counts loads and unloads, so the render thread knows when to start the
+   // buffers over.
+   unsigned generation = 0;
+
+   // Import the Shadertoy project at path and build its passes, replacing
+   // the loaded one. On failure the loaded project is kept and the errors
+   // are added to shader_errors.
+   bool load(const char* file);
+   // Retire the passes once the render thread is done with them.
+   void unload();
+};
+
+// The render thread's targets of the project's buffers, as framebuffers are
+// not shared between contexts. Each buffer is drawn into one of two float
+// targets in turn, so reading it gives this frame's image if its pass
+// already ran and the last frame's otherwise, as on Shadertoy.
+class project_drawing
+{
+public:
+   void destroy();
+
+   // Start the buffers over if generation is not the one they were drawn
+   // for.
+   void update(unsigned generation);
+   // Draw the buffer passes of a project and then its image pass into
+   // framebuffer.
+   void draw(const std::vector<project_pass>& passes, const frame_values& frame, GLuint framebuffer);
+
+private:
+   render_target buffers[4][2];
+   // Target of each buffer written last.
+   int current[4] = {};
+   // project_passes::generation the targets were drawn for.
+   unsigned generation = 0;
+};
@@ -0,0 +1,197 @@
+#include "quad_program.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "opengl_util.h"
+#include "retire_queue.h"
+#include "texture_channels.h"
+
+// Values of the frame being drawn, see begin_frame_uniforms().
+static double frame_time = 0.0;
+static double frame_delta = 0.0;
+static int frame_index = 0;
+static int drawn_frames = 0;
+static float frame_date[4] = {};
+static float frame_drag[4] = {};
+static float channel_resolution[texture_cache::channel_count][3] = {};
+
+bool quad_vertices = false;
+
+void draw_fullscreen()
+{
+   glDrawArrays(GL_TRIANGLES, 0, quad_vertices ? 6 : 3);
+}
+
+// Set frame_date to the local date: year, month from 0, day and seconds
+// since midnight.
+static void update_date()
+{
+   const auto now = std::chrono::system_clock::now();
+   const time_t seconds = std::chrono::system_clock::to_time_t(now);
+   tm local;
+   localtime_r(&seconds, &local);
+   const double fraction =
+      std::chrono::duration<double>(now - std::chrono::system_clock::from_time_t(seconds)).count();
+   frame_date[0] = float(local.tm_year + 1900);
+   frame_date[1] = float(local.tm_mon);
+   frame_date[2] = float(local.tm_mday);
+   frame_date[3] = float(local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec + fraction);
+}
+
+void begin_frame_uniforms(double time, const float* drag, bool repeat)
+{
+   if (!repeat)
+   {
+      frame_delta = drawn_frames ? time - frame_time : 0.0;
+      frame_index = drawn_frames++;
+   }
+   frame_time = time;
+   std::copy(drag, drag + 4, frame_drag);
+   update_date();
+}
+
+void set_channel_resolution(const float (*resolution)[3])
+{
+   memcpy(channel_resolution, resolution, sizeof(channel_resolution));
+}
+
+GLuint start_quad_link(GLuint frag_shader)
+{
+   auto vert_shader =
+      compile_shader_from_file(GL_VERTEX_SHADER, vertex_shader_path, quad_vertices ? "#define QUAD_VERTICES" : nullptr);
+   if (!vert_shader || !frag_shader)
+   {
+      fprintf(stderr, "Failed to load shaders\n");
+      glDeleteShader(vert_shader);
+      glDeleteShader(frag_shader);
+      return 0;
+   }
+   GLuint linked = glCreateProgram();
+   glAttachShader(linked, vert_shader);
+   glAttachShader(linked, frag_shader);
+   glDeleteShader(vert_shader);
+   glDeleteShader(frag_shader);
+   glBindFragDataLocation(linked, 0, "outColor");
+   glBindFragDataLocation(linked, 1, "outDepth");
+   glBindFragDataLocation(linked, 1, "outSteps");
+   glLinkProgram(linked);
+   return linked;
+}
+
+bool finish_quad_link(GLuint& program, GLuint linked)
+{
+   if (!linked)
+      return false;
+   GLint success = GL_FALSE;
+   glGetProgramiv(linked, GL_LINK_STATUS, &success);
+   if (success == GL_FALSE)
+   {
+      GLint lsize = 0;
+      glGetProgramiv(linked, GL_INFO_LOG_LENGTH, &lsize);
+      std::vector<GLchar> log(lsize + 1);
+      glGetProgramInfoLog(linked, lsize, &lsize, log.data());
+      fprintf(stderr, "Error linking program %s\n", log.data());
+      const size_t before = shader_errors.size();
+      parse_info_log(log.data(), nullptr, shader_errors);
+      if (shader_errors.size() == before)
+      {
+         shader_diagnostic unparsed;
+         unparsed.message = lsize ? log.data() : "link failed";
+         shader_errors.push_back(unparsed);
+      }
+      for (size_t i = before; i < shader_errors.size(); ++i)
+      {
+         if (shader_errors[i].file.empty())
+            shader_errors[i].file = "link";
+      }
+      glDeleteProgram(linked);
+      return false;
+   }
+   retire_program(program);
+   program = linked;
+   return true;
+}
+
+bool link_quad_program(GLuint& program, GLuint frag_shader)
+{
+   return finish_quad_link(program, start_quad_link(frag_shader));
+}
+
+// Type of the active uniform name, 0 if there is none.
+static GLenum uniform_type(GLuint program, const char* name)
+{
+   GLuint index = GL_INVALID_INDEX;
+   glGetUniformIndices(program, 1, &name, &index);
+   if (index == GL_INVALID_INDEX)
+      return 0;
+   GLint type = 0;
+   glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_TYPE, &type);
+   return GLenum(type);
+}
+
+void get_frame_uniforms(quad_program& out)
+{
+   out.elapsed_time_uniform = glGetUniformLocation(out.program, "iTime");
+   // The name fragment.glsl uses.
+   if (out.elapsed_time_uniform < 0)
+      out.elapsed_time_uniform = glGetUniformLocation(out.program, "iElapsedTime");
+   out.resolution_uniform = glGetUniformLocation(out.program, "iResolution");
+   out.mouse_uniform = glGetUniformLocation(out.program, "iMouse");
+   out.resolution_vec3 = uniform_type(out.program, "iResolution") == GL_FLOAT_VEC3;
+   out.mouse_vec4 = uniform_type(out.program, "iMouse") == GL_FLOAT_VEC4;
+   out.color_uniform = glGetUniformLocation(out.program, "iColor");
+   out.shininess_uniform = glGetUniformLocation(out.program, "iShininess");
+   out.time_delta_uniform = glGetUniformLocation(out.program, "iTimeDelta");
+   out.frame_rate_uniform = glGetUniformLocation(out.program, "iFrameRate");
+   out.frame_uniform = glGetUniformLocation(out.program, "iFrame");
+   out.date_uniform = glGetUniformLocation(out.program, "iDate");
+   out.channel_resolution_uniform = glGetUniformLocation(out.program, "iChannelResolution");
+   out.channel_time_uniform = glGetUniformLocation(out.program, "iChannelTime");
+   glProgramUniform1f(out.program, glGetUniformLocation(out.program, "iSampleRate"), 44100.0f);
+   for (int i = 0; i < texture_cache::channel_count; ++i)
+   {
+      const std::string name = "iChannel" + std::to_string(i);
+      glProgramUniform1i(out.program, glGetUniformLocation(out.program, name.c_str()), first_channel_unit + i);
+   }
+}
+
+void set_frame_uniforms(const quad_program& prog, int width, int height, double mouse_x, double mouse_y,
+                        float shininess, const float* object_color)
+{
+   glUniform1f(prog.elapsed_time_uniform, GLfloat(frame_time));
+   GLfloat res[3] = { GLfloat(width), GLfloat(height), 1.0f };
+   if (prog.resolution_vec3)
+      glUniform3fv(prog.resolution_uniform, 1, res);
+   else
+      glUniform2fv(prog.resolution_uniform, 1, res);
+   float mouse_pos[2] = { float(mouse_x), float(mouse_y) };
+   if (prog.mouse_vec4)
+      glUniform4fv(prog.mouse_uniform, 1, frame_drag);
+   else
+      glUniform2fv(prog.mouse_uniform, 1, mouse_pos);
+   glUniform1f(prog.time_delta_uniform, GLfloat(frame_delta));
+   glUniform1f(prog.frame_rate_uniform, frame_delta > 0.0 ? GLfloat(1.0 / frame_delta) : 60.0f);
+   glUniform1i(prog.frame_uniform, frame_index);
+   glUniform4fv(prog.date_uniform, 1, frame_date);
+   glUniform3fv(prog.channel_resolution_uniform, texture_cache::channel_count, channel_resolution[0]);
+   const GLfloat channel_times[texture_cache::channel_count] = { GLfloat(frame_time), GLfloat(frame_time),
+                                                                 GLfloat(frame_time), GLfloat(frame_time) };
+   glUniform1fv(prog.channel_time_uniform, texture_cache::channel_count, channel_times);
+   // Material uniforms are sent every frame so they survive shader reloads.
+   glUniform1f(prog.shininess_uniform, shininess);
+   glUniform4fv(prog.color_uniform, 1, object_color);
+}
+
+bool program_usable(GLuint program)
+{
+   GLint linked = GL_FALSE;
+   glGetProgramiv(program, GL_LINK_STATUS, &linked);
+   return linked == GL_TRUE && glGetUniformLocation(program, "iResolution") >= 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// How the raymarcher runs: rasterized over the quad, or as a compute shader
+// over 8x8 tiles, either one work group per tile or a fixed number of
+// persistent groups taking tiles from a queue.
+enum class raymarch_backend
+{
+   fragment,
+   compute_tiles,
+   compute_persistent,
+};
+
+// A linked raymarcher variant and the uniforms the app drives.
+struct quad_program
+{
+   GLuint program;
+   raymarch_backend backend;
+   GLint elapsed_time_uniform;
+   GLint resolution_uniform;
+   GLint mouse_uniform;
+   // Shadertoy declares iResolution as a vec3 and iMouse as a vec4, the
+   // shaders here as vec2s.
+   bool resolution_vec3;
+   bool mouse_vec4;
+   GLint time_delta_uniform;
+   GLint frame_rate_uniform;
+   GLint frame_uniform;
+   GLint date_uniform;
+   GLint channel_resolution_uniform;
+   GLint channel_time_uniform;
+   GLint color_uniform;
+   GLint shininess_uniform;
+   GLint prev_resolution_uniform;
+   GLint prev_mouse_uniform;
+   GLint history_valid_uniform;
+   GLint history_blend_uniform;
+   GLint jitter_uniform;
+   GLint generation_uniform;
+   GLint start_depth_scale_uniform;
+};
+
+// Uniform buffer binding of the SceneParams block.
+const GLuint scene_params_binding = 0;
+// Texture units of iBVHNodes and iBVHPrimitives.
+const GLint bvh_nodes_unit = 1;
+const GLint bvh_primitives_unit = 2;
+// Texture units of iBakedBricks and iBakedAtlas.
+const GLint volume_bricks_unit = 3;
+const GLint volume_atlas_unit = 4;
+// Texture unit of iStartDepth.
+const GLint start_depth_unit = 5;
+// Texture units of iPrevColor and iPrevDepth.
+const GLint prev_color_unit = 6;
+const GLint prev_depth_unit = 7;
+// Texture unit of iShaded.
+const GLint interleave_shaded_unit = 8;
+// Texture unit of iChannel0, the other channels follow.
+const GLint first_channel_unit = 9;
+// Image units of iOutput and iStepsOutput of the compute backends.
+const GLuint output_image_unit = 0;
+const GLuint steps_image_unit = 1;
+
+const char* const vertex_shader_path = "shaders/vertex.glsl";
+const char* const fragment_shader_path = "shaders/raymarch.glsl";
+const char* const interleave_shader_path = "shaders/interleave.glsl";
+const char* const shader_directory = "shaders";
+
+// Cover the viewport with two triangles instead of one large triangle. The
+// pixel quads along their shared edge are shaded by both, so this is only
+// kept to compare the two with --benchmark.
+extern bool quad_vertices;
+
+// Draw the viewport with the program bound. Every program is linked with the
+// attribute-less vertex shader, so this needs no vertex buffer.
+void draw_fullscreen();
+
+// Start linking frag_shader with the quad vertex shader. Takes ownership of
+// frag_shader. Returns 0 if either shader failed to compile.
+GLuint start_quad_link(GLuint frag_shader);
+// Replace program with linked if it linked, waiting for the link if needed,
+// and retire the old one. On failure program is left alone, linked is
+// deleted and the link log is added to shader_errors.
+bool finish_quad_link(GLuint& program, GLuint linked);
+// Link frag_shader with the quad vertex shader into program, replacing it.
+// Takes ownership of frag_shader. On failure program is left alone and the
+// link log is added to shader_errors.
+bool link_quad_program(GLuint& program, GLuint frag_shader);
+
+// Whether program linked and its uniforms can be looked up by name, which
+// for SPIR-V depends on the driver reflecting names.
+bool program_usable(GLuint program);
+
+// Look up the uniforms set_frame_uniforms() sets.
+void get_frame_uniforms(quad_program& out);
+
+// iTime, iTimeDelta, iFrame, iDate, Shadertoy's iMouse and
+// iChannelResolution are the same for every program drawn in a frame and are
+// kept here by the thread drawing. Start a frame at iTime time with iMouse
+// drag, see frame_values. iTimeDelta and iFrame only advance if it is not a
+// repeat.
+void begin_frame_uniforms(double time, const float* drag, bool repeat);
+// iChannelResolution of the channels bound for the frame.
+void set_channel_resolution(const float (*resolution)[3]);
+
+void set_frame_uniforms(const quad_program& prog, int width, int height, double mouse_x, double mouse_y,
+                        float shininess, const float* object_color);
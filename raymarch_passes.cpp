@@ -0,0 +1,190 @@
+#include "raymarch_passes.h"
+
+#include <string.h>
+
+void cone_prepass::init()
+{
+   target.init({ GL_R32F });
+}
+
+void cone_prepass::destroy()
+{
+   target.destroy();
+}
+
+void cone_prepass::draw(const quad_program& prepass, int scale, const frame_values& frame, GLuint framebuffer)
+{
+   // Round up so every full resolution pixel has a cone above it.
+   const int w = (frame.width + scale - 1) / scale;
+   const int h = (frame.height + scale - 1) / scale;
+   target.resize(w, h);
+   target.bind();
+   glUseProgram(prepass.program);
+   // The full resolution, so the cones follow the main pass's camera.
+   set_frame_uniforms(prepass, frame.width, frame.height, frame.mouse_x, frame.mouse_y, frame.shininess,
+                      frame.object_color);
+   glUniform1i(prepass.start_depth_scale_uniform, scale);
+   draw_fullscreen();
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+   glViewport(0, 0, frame.width, frame.height);
+   glActiveTexture(GL_TEXTURE0 + start_depth_unit);
+   glBindTexture(GL_TEXTURE_2D, target.textures[0]);
+   glActiveTexture(GL_TEXTURE0);
+}
+
+void temporal_reprojection::init()
+{
+   for (render_target& target : history)
+   {
+      target.init({ GL_RGBA16F, GL_R32F });
+      // History colors are resampled at reprojected positions.
+      glBindTexture(GL_TEXTURE_2D, target.textures[0]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+   }
+   glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void temporal_reprojection::destroy()
+{
+   history[0].destroy();
+   history[1].destroy();
+}
+
+void temporal_reprojection::draw(const quad_program& main, float blend, const frame_values& values,
+                                 GLuint framebuffer)
+{
+   const render_target& current = history[frame & 1];
+   const render_target& previous = history[(frame + 1) & 1];
+   if (history[0].resize(values.width, values.height) | history[1].resize(values.width, values.height))
+      discard();
+   glActiveTexture(GL_TEXTURE0 + prev_color_unit);
+   glBindTexture(GL_TEXTURE_2D, previous.textures[0]);
+   glActiveTexture(GL_TEXTURE0 + prev_depth_unit);
+   glBindTexture(GL_TEXTURE_2D, previous.textures[1]);
+   glActiveTexture(GL_TEXTURE0);
+
+   // Jitter rays inside the pixel along a Halton(2, 3) sequence so
+   // accumulation converges to an anti-aliased image.
+   float jitter[2] = { 0.0f, 0.0f };
+   if (blend > 0.0f)
+   {
+      for (int axis = 0; axis < 2; ++axis)
+      {
+         const unsigned base = axis ? 3 : 2;
+         float f = 1.0f, r = 0.0f;
+         for (unsigned i = frame % 16 + 1; i; i /= base)
+         {
+            f /= float(base);
+            r += f * float(i % base);
+         }
+         jitter[axis] = r - 0.5f;
+      }
+   }
+   glUniform2fv(main.prev_resolution_uniform, 1, resolution);
+   glUniform2fv(main.prev_mouse_uniform, 1, mouse);
+   glUniform1i(main.history_valid_uniform, valid);
+   glUniform1f(main.history_blend_uniform, blend);
+   glUniform2fv(main.jitter_uniform, 1, jitter);
+
+   current.bind();
+   draw_fullscreen();
+
+   const int width = values.width;
+   const int height = values.height;
+   glBindFramebuffer(GL_READ_FRAMEBUFFER, current.fbo);
+   glReadBuffer(GL_COLOR_ATTACHMENT0);
+   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+   glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+   glViewport(0, 0, width, height);
+
+   valid = true;
+   resolution[0] = float(width);
+   resolution[1] = float(height);
+   mouse[0] = float(values.mouse_x);
+   mouse[1] = float(values.mouse_y);
+   ++frame;
+}
+
+void interleaved_shading::init()
+{
+   target.init({ GL_RGBA16F }, true);
+}
+
+void interleaved_shading::destroy()
+{
+   target.destroy();
+}
+
+void interleaved_shading::discard()
+{
+   // Kept small enough to be exact in a half float.
+   generation = (generation + 1) % 2048;
+}
+
+void interleaved_shading::draw(const quad_program& main, const quad_program& mask, const quad_program& resolve,
+                               int cells, const frame_values& values, GLuint framebuffer)
+{
+   const float frame_inputs[] = { float(values.mouse_x), float(values.mouse_y), values.shininess,
+                                  values.object_color[0], values.object_color[1], values.object_color[2],
+                                  values.object_color[3] };
+   if (memcmp(frame_inputs, inputs, sizeof(inputs)) != 0)
+   {
+      memcpy(inputs, frame_inputs, sizeof(inputs));
+      discard();
+   }
+
+   const int width = values.width;
+   const int height = values.height;
+   if (target.resize(width, height) || mask_cells != cells || mask_program != mask.program)
+   {
+      discard();
+      target.bind();
+      // Alpha -1 matches no generation, so nothing stale is trusted.
+      glClearColor(0.0f, 0.0f, 0.0f, -1.0f);
+      glClearStencil(0);
+      glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+      glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+      // Tag every pixel with its cell once; frames then only test against it.
+      glUseProgram(mask.program);
+      glUniform1i(glGetUniformLocation(mask.program, "iInterleaveCells"), cells);
+      glEnable(GL_STENCIL_TEST);
+      glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+      glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+      for (int cell = 0; cell < cells; ++cell)
+      {
+         glStencilFunc(GL_ALWAYS, cell, 0xff);
+         glUniform1i(glGetUniformLocation(mask.program, "iInterleaveCell"), cell);
+         draw_fullscreen();
+      }
+      glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+      glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+      glDisable(GL_STENCIL_TEST);
+      glUseProgram(main.program);
+      mask_program = mask.program;
+      mask_cells = cells;
+   }
+   // Visit the quarters diagonally first so a still image fills in evenly.
+   static const int quarter_order[4] = { 0, 3, 1, 2 };
+   const int phase = cells == 4 ? quarter_order[frame % 4] : int(frame % 2);
+   target.bind();
+   glUniform1i(main.generation_uniform, generation);
+   // The stencil test runs before shading, so rejected quads cost nothing.
+   glEnable(GL_STENCIL_TEST);
+   glStencilFunc(GL_EQUAL, phase, 0xff);
+   draw_fullscreen();
+   glDisable(GL_STENCIL_TEST);
+
+   glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+   glViewport(0, 0, width, height);
+   glActiveTexture(GL_TEXTURE0 + interleave_shaded_unit);
+   glBindTexture(GL_TEXTURE_2D, target.textures[0]);
+   glActiveTexture(GL_TEXTURE0);
+   glUseProgram(resolve.program);
+   glUniform1i(glGetUniformLocation(resolve.program, "iInterleaveCells"), cells);
+   glUniform1i(resolve.generation_uniform, generation);
+   draw_fullscreen();
+   ++frame;
+}
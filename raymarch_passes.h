@@ -0,0 +1,76 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "frame_values.h"
+#include "quad_program.h"
+#include "render_target.h"
+
+// Conservative start depths for the full resolution march, found by cone
+// marching a low resolution image first.
+class cone_prepass
+{
+public:
+   void init();
+   void destroy();
+
+   // Draw prepass over frame at 1/scale resolution, then bind framebuffer
+   // again and the depths to iStartDepth.
+   void draw(const quad_program& prepass, int scale, const frame_values& frame, GLuint framebuffer);
+
+private:
+   render_target target;
+};
+
+// Temporal reprojection: reuse last frame's depths and colors.
+// history[frame & 1] is rendered to while the other one holds the previous
+// frame.
+class temporal_reprojection
+{
+public:
+   void init();
+   void destroy();
+
+   // Forget the previous frame.
+   void discard() { valid = false; }
+   // Draw main, bound with its frame uniforms set, reprojecting the previous
+   // frame and blending blend of its colors in, and copy the image into
+   // framebuffer, which is left bound.
+   void draw(const quad_program& main, float blend, const frame_values& frame, GLuint framebuffer);
+
+private:
+   render_target history[2];
+   unsigned frame = 0;
+   bool valid = false;
+   float resolution[2] = {};
+   float mouse[2] = {};
+};
+
+// Interleaved rendering: shade one of cells groups of 2x2 quads per frame
+// and fill in the rest from the frames before.
+class interleaved_shading
+{
+public:
+   void init();
+   void destroy();
+
+   // Pixels shaded before now are out of date.
+   void discard();
+   // Shade this frame's cell of the pattern with main, bound with its frame
+   // uniforms set, and resolve the whole image into framebuffer, which is
+   // left bound. Starts over after a resize, a mask change or a change of
+   // the frame's inputs.
+   void draw(const quad_program& main, const quad_program& mask, const quad_program& resolve, int cells,
+             const frame_values& frame, GLuint framebuffer);
+
+private:
+   render_target target;
+   unsigned frame = 0;
+   // Pixels shaded in an older generation may be out of date.
+   int generation = 0;
+   // Program and cells the stencil mask was drawn with.
+   GLuint mask_program = 0;
+   int mask_cells = 0;
+   // Everything besides the scene that changes the image.
+   float inputs[7] = {};
+};
@@ -0,0 +1,132 @@
+#include "raymarcher_programs.h"
+
+#include <stdio.h>
+
+#include <string>
+
+#include "compute_raymarch.h"
+#include "opengl_util.h"
+#include "retire_queue.h"
+#include "spirv_cache.h"
+
+// Build a pass of interleaved rendering from interleave_shader_path.
+static bool build_interleave_program(quad_program& out, const char* defines)
+{
+   if (!link_quad_program(out.program, compile_shader_from_file(GL_FRAGMENT_SHADER, interleave_shader_path, defines)))
+      return false;
+   out.generation_uniform = glGetUniformLocation(out.program, "iGeneration");
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iShaded"), interleave_shaded_unit);
+   return true;
+}
+
+raymarcher_programs::raymarcher_programs(const scene_inputs& scene)
+   : scene(scene)
+{
+   permutations.add_axis("Steps", { { "255", "" }, { "128", "#define STEPS 128" }, { "64", "#define STEPS 64" } });
+   permutations.add_axis("Epsilon", { { "0.001", "" }, { "0.0005", "#define EPSILON 0.0005" }, { "0.005", "#define EPSILON 0.005" } });
+   permutations.add_axis("Max distance", { { "100", "" }, { "20", "#define MAX_DIST 20.0" } });
+   permutations.add_axis("Normals", { { "central", "" }, { "tetrahedral", "#define TETRAHEDRAL_NORMALS" }, { "analytic", "#define ANALYTIC_NORMALS" } });
+   permutations.add_axis("Shadow", { { "naive", "" }, { "improved", "#define IMPROVED_SHADOW" } });
+}
+
+void raymarcher_programs::destroy()
+{
+   for (const auto& entry : programs)
+      glDeleteProgram(entry.second.program);
+   programs.clear();
+   for (GLuint program : stale_programs)
+      glDeleteProgram(program);
+   stale_programs.clear();
+   glDeleteProgram(prepass.program);
+   glDeleteProgram(interleave_mask.program);
+   glDeleteProgram(interleave_resolve.program);
+}
+
+bool raymarcher_programs::build(quad_program& out, const char* defines, raymarch_backend which) const
+{
+   if (which != raymarch_backend::fragment)
+      return build_compute_program(out, scene, defines, which);
+   compile_to_spirv = use_spirv && spirv_available();
+   bool built = link_quad_program(out.program, scene.compile_shader(fragment_shader_path, defines));
+   if (compile_to_spirv && (!built || !program_usable(out.program)))
+   {
+      fprintf(stderr, "Falling back to GLSL\n");
+      compile_to_spirv = false;
+      built = link_quad_program(out.program, scene.compile_shader(fragment_shader_path, defines));
+   }
+   compile_to_spirv = false;
+   if (!built)
+      return false;
+   out.backend = raymarch_backend::fragment;
+   scene.bind_program(out);
+   return true;
+}
+
+uint64_t raymarcher_programs::key() const
+{
+   const uint64_t mode_bits = uint64_t(modes.cone_prepass) | uint64_t(modes.temporal) << 1
+                              | uint64_t(modes.interleave_cells > 1) << 2 | uint64_t(modes.backend) << 3;
+   return permutations.key() << 5 | mode_bits;
+}
+
+bool raymarcher_programs::select()
+{
+   auto found = programs.find(key());
+   if (found == programs.end())
+   {
+      std::string defines = permutations.defines();
+      if (modes.cone_prepass)
+         defines += "#define CONE_START\n";
+      if (modes.temporal)
+         defines += "#define TEMPORAL\n";
+      if (modes.interleave_cells > 1)
+         defines += "#define INTERLEAVED\n";
+      quad_program program = {};
+      if (!build(program, defines.c_str(), modes.backend))
+         return false;
+      found = programs.emplace(key(), program).first;
+   }
+   main = found->second;
+   for (GLuint program : stale_programs)
+      retire_program(program);
+   stale_programs.clear();
+   return true;
+}
+
+void raymarcher_programs::change_modes()
+{
+   if (modes.cone_prepass)
+      build(prepass, "#define CONE_PREPASS");
+   if (modes.interleave_cells > 1)
+   {
+      build_interleave_program(interleave_mask, "#define INTERLEAVE_MASK");
+      build_interleave_program(interleave_resolve, nullptr);
+   }
+   select();
+}
+
+void raymarcher_programs::reload()
+{
+   failed_plain_key = UINT64_MAX;
+   for (const auto& entry : programs)
+      stale_programs.push_back(entry.second.program);
+   programs.clear();
+   change_modes();
+}
+
+const quad_program* raymarcher_programs::plain_variant()
+{
+   const uint64_t plain_key = permutations.key() << 5;
+   auto found = programs.find(plain_key);
+   if (found == programs.end())
+   {
+      quad_program program = {};
+      if (plain_key == failed_plain_key || !build(program, permutations.defines().c_str()))
+      {
+         failed_plain_key = plain_key;
+         return nullptr;
+      }
+      found = programs.emplace(plain_key, program).first;
+   }
+   return &found->second;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "quad_program.h"
+#include "scene_inputs.h"
+#include "shader_permutations.h"
+
+// Rendering modes of the raymarcher. Each one builds the main program with
+// its own defines and adds passes around it.
+struct raymarch_modes
+{
+   // Start the full resolution march at depths found by cone marching a
+   // low resolution image first.
+   bool cone_prepass = false;
+   int cone_prepass_scale = 8;
+   // Reuse last frame's depths and colors.
+   bool temporal = false;
+   float history_blend = 0.0f;
+   // Shade one of interleave_cells groups of 2x2 quads per frame, 1 disables
+   // it, and fill in the rest from the frames before.
+   int interleave_cells = 1;
+   raymarch_backend backend = raymarch_backend::fragment;
+   // Work groups launched by the persistent backend, a few per core of
+   // current GPUs. More only add groups that find the queue empty.
+   int persistent_groups = 256;
+};
+
+// Builds of the raymarcher for the selected permutation and rendering modes,
+// and the passes the modes add. Used by the UI thread.
+class raymarcher_programs
+{
+public:
+   // Quality and speed trade-offs of raymarch.glsl that can be switched at
+   // runtime. Each permutation is compiled once and then cached.
+   shader_permutations permutations;
+   raymarch_modes modes;
+   // Load the raymarcher as SPIR-V where supported, see spirv_cache.h.
+   bool use_spirv = false;
+
+   // Variant selected by select().
+   quad_program main = {};
+   // Writes conservative start depths at 1/cone_prepass_scale resolution.
+   quad_program prepass = {};
+   // Stencil mask and resolve passes of interleaved rendering.
+   quad_program interleave_mask = {};
+   quad_program interleave_resolve = {};
+
+   explicit raymarcher_programs(const scene_inputs& scene);
+   void destroy();
+
+   // Build one variant of the raymarcher for backend which into out. On
+   // failure out is left alone.
+   bool build(quad_program& out, const char* defines,
+              raymarch_backend which = raymarch_backend::fragment) const;
+
+   // Permutation in the high bits, rendering modes in the low ones.
+   uint64_t key() const;
+   // Whether the variant for key is built.
+   bool built(uint64_t key) const { return programs.count(key) != 0; }
+   size_t built_count() const { return programs.size(); }
+
+   // Point main at the variant for the selected permutation and modes,
+   // building it on first use. On failure main is left alone.
+   bool select();
+   // Build the passes the enabled modes add and select the main program for
+   // them. Cached variants stay valid.
+   void change_modes();
+   // Build everything again from the current sources and scene. The old
+   // variants are deleted once a new one links, so a broken shader leaves
+   // the last good one running.
+   void reload();
+
+   // Variant for the selected permutation without the rendering modes,
+   // whose passes keep per-window targets. Built on first use; null if it
+   // fails, and then not retried until reload().
+   const quad_program* plain_variant();
+
+private:
+   const scene_inputs& scene;
+   // Linked variants of the main program by key(). Emptied by reload().
+   std::unordered_map<uint64_t, quad_program> programs;
+   // Programs from before the last reload.
+   std::vector<GLuint> stale_programs;
+   // Key of the plain variant build that failed.
+   uint64_t failed_plain_key = UINT64_MAX;
+};
@@ -0,0 +1,52 @@
+#include "render_handoff.h"
+
+#include "single_quad_app.h"
+
+void single_quad_app::take_settings(render_settings& out)
+{
+   const registered_shader& shader = registry.shown();
+   out.shown = shown_program();
+   out.raymarcher = is_raymarcher(shader);
+   const raymarch_modes& modes = raymarcher.modes;
+   out.prepass = raymarcher.prepass;
+   out.interleave_mask = raymarcher.interleave_mask;
+   out.interleave_resolve = raymarcher.interleave_resolve;
+   out.program_key = raymarcher.key();
+   out.cone_prepass = modes.cone_prepass;
+   out.cone_prepass_scale = modes.cone_prepass_scale;
+   out.temporal = modes.temporal;
+   out.history_blend = modes.history_blend;
+   out.interleave_cells = modes.interleave_cells;
+   out.persistent_groups = modes.persistent_groups;
+   out.history_generation = history_generation;
+
+   // Both sides are drawn as a single fragment pass.
+   const bool ab_drawable = ab.pinned.program && ab.pinned_topology == scene.topology && out.shown.program
+                            && out.shown.backend == raymarch_backend::fragment && !modes.cone_prepass && !modes.temporal
+                            && modes.interleave_cells == 1;
+   out.ab = ab_drawable ? ab.mode : ab_mode::off;
+   out.ab_split = ab.split;
+   out.ab_pinned = ab.pinned;
+   out.ab_pin = ab.pin;
+
+   out.project = project.passes;
+   out.project_generation = project.generation;
+   out.views = views.views;
+   const quad_program* view = views.views.empty() ? nullptr : view_program();
+   out.view_program = view ? *view : quad_program();
+
+   channels.take(out.channels);
+
+   out.probe_latency = probing_latency;
+   out.late_input = late_input;
+   out.recording = recording;
+}
+
+void single_quad_app::publish_report()
+{
+   render_report& out = reports.write_buffer();
+   out.ab = ab_pass.results();
+   latency.results(out.latency);
+   out.recording = recorder.status();
+   reports.publish();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "ab_comparison.h"
+#include "frame_values.h"
+#include "input_latency.h"
+#include "project_passes.h"
+#include "quad_program.h"
+#include "session_recording.h"
+#include "shader_channels.h"
+#include "ui_snapshot.h"
+#include "view_windows.h"
+
+// What the UI thread and the render thread hand each other through triple
+// buffers: frames one way, measurements the other.
+
+// Everything the render thread draws with besides a frame's inputs, taken
+// from the UI thread's state by single_quad_app::take_settings() when it
+// publishes the frame. Objects named here are retired rather than deleted,
+// see retire().
+struct render_settings
+{
+   // shown_program(), and whether it is drawn by the raymarcher's pipeline.
+   quad_program shown = {};
+   bool raymarcher = true;
+   quad_program prepass = {};
+   quad_program interleave_mask = {};
+   quad_program interleave_resolve = {};
+   // raymarcher_programs::key() and the mode parameters it does not cover.
+   uint64_t program_key = 0;
+   bool cone_prepass = false;
+   int cone_prepass_scale = 1;
+   bool temporal = false;
+   float history_blend = 0.0f;
+   int interleave_cells = 1;
+   int persistent_groups = 1;
+   unsigned history_generation = 0;
+   // Off unless B can be drawn next to the shown program.
+   ab_mode ab = ab_mode::off;
+   float ab_split = 0.5f;
+   quad_program ab_pinned = {};
+   unsigned ab_pin = 0;
+   // Passes of the Shadertoy project, drawn instead of the shown program
+   // unless empty.
+   std::vector<project_pass> project;
+   unsigned project_generation = 0;
+   std::vector<view_window> views;
+   // view_program(), zero if there is none.
+   quad_program view_program = {};
+   // iChannel textures, with the video over its channel, and their sizes.
+   channel_bindings channels;
+   bool probe_latency = false;
+   bool late_input = false;
+   recording_request recording;
+};
+
+// What the UI thread hands the render thread each frame.
+struct frame_state
+{
+   frame_values values;
+   render_settings settings;
+   ui_snapshot ui;
+   // Signalled once the GL work the UI thread did for the frame, like
+   // builds and uploads, is done.
+   GLsync uploads = nullptr;
+   uint64_t sequence = 0;
+};
+
+// What the render thread measured, published after every frame it draws for
+// the properties window.
+struct render_report
+{
+   ab_measurement ab;
+   latency_results latency;
+   recording_status recording;
+};
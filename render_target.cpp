@@ -0,0 +1,103 @@
+#include "render_target.h"
+
+#include <stdio.h>
+
+// Client format and type accepted by glTexImage2D for an internal format.
+static void upload_format(GLenum internal_format, GLenum& format, GLenum& type)
+{
+   switch (internal_format)
+   {
+   case GL_R32F:
+   case GL_R16F:
+      format = GL_RED;
+      type = GL_FLOAT;
+      break;
+   case GL_RG32F:
+   case GL_RG16F:
+      format = GL_RG;
+      type = GL_FLOAT;
+      break;
+   case GL_RGBA32F:
+   case GL_RGBA16F:
+      format = GL_RGBA;
+      type = GL_FLOAT;
+      break;
+   default:
+      format = GL_RGBA;
+      type = GL_UNSIGNED_BYTE;
+      break;
+   }
+}
+
+void render_target::init(std::initializer_list<GLenum> color_formats, bool with_depth_stencil)
+{
+   destroy();
+   formats = color_formats;
+   textures.resize(formats.size());
+   glGenFramebuffers(1, &fbo);
+   glGenTextures(GLsizei(textures.size()), textures.data());
+   for (GLuint texture : textures)
+   {
+      glBindTexture(GL_TEXTURE_2D, texture);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   }
+   glBindTexture(GL_TEXTURE_2D, 0);
+   if (with_depth_stencil)
+      glGenRenderbuffers(1, &depth_stencil);
+   width = height = 0;
+}
+
+bool render_target::resize(int w, int h)
+{
+   if (w == width && h == height)
+      return false;
+   width = w;
+   height = h;
+   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   for (size_t i = 0; i < textures.size(); ++i)
+   {
+      GLenum format, type;
+      upload_format(formats[i], format, type);
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
+      glTexImage2D(GL_TEXTURE_2D, 0, formats[i], w, h, 0, format, type, nullptr);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GLenum(GL_COLOR_ATTACHMENT0 + i), GL_TEXTURE_2D, textures[i], 0);
+   }
+   glBindTexture(GL_TEXTURE_2D, 0);
+   if (depth_stencil)
+   {
+      glBindRenderbuffer(GL_RENDERBUFFER, depth_stencil);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, w, h);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_stencil);
+      glBindRenderbuffer(GL_RENDERBUFFER, 0);
+   }
+   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      fprintf(stderr, "Incomplete framebuffer %dx%d\n", w, h);
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   return true;
+}
+
+void render_target::destroy()
+{
+   if (fbo)
+      glDeleteFramebuffers(1, &fbo);
+   if (!textures.empty())
+      glDeleteTextures(GLsizei(textures.size()), textures.data());
+   if (depth_stencil)
+      glDeleteRenderbuffers(1, &depth_stencil);
+   fbo = 0;
+   depth_stencil = 0;
+   textures.clear();
+   formats.clear();
+   width = height = 0;
+}
+
+void render_target::bind() const
+{
+   static const GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+   glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+   glDrawBuffers(GLsizei(textures.size()), attachments);
+   glViewport(0, 0, width, height);
+}
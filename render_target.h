@@ -0,0 +1,28 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <initializer_list>
+#include <vector>
+
+// Framebuffer with one texture per color attachment and an optional
+// depth/stencil renderbuffer. Storage is (re)allocated by resize().
+class render_target
+{
+public:
+   GLuint fbo = 0;
+   GLuint depth_stencil = 0;
+   std::vector<GLuint> textures;
+   std::vector<GLenum> formats;
+   int width = 0;
+   int height = 0;
+
+   // Internal formats of the color attachments, in attachment order.
+   void init(std::initializer_list<GLenum> color_formats, bool with_depth_stencil = false);
+   // Returns true if the storage was reallocated, which clears the contents.
+   bool resize(int w, int h);
+   void destroy();
+
+   // Bind for drawing to every attachment and set the viewport to match.
+   void bind() const;
+};
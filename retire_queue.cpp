@@ -0,0 +1,62 @@
+#include "retire_queue.h"
+
+#include <atomic>
+#include <deque>
+#include <utility>
+
+struct retired_object
+{
+   // Sequence of the first frame that no longer names the object.
+   uint64_t sequence;
+   std::function<void()> release;
+};
+
+static uint64_t next_sequence = 1;
+static std::atomic<uint64_t> render_taken(0);
+static bool render_running = false;
+static std::deque<retired_object> retired;
+
+uint64_t next_frame_sequence()
+{
+   return next_sequence++;
+}
+
+void frame_taken(uint64_t sequence)
+{
+   render_taken = sequence;
+}
+
+void begin_render_thread()
+{
+   render_running = true;
+}
+
+void end_render_thread()
+{
+   render_running = false;
+   release_retired();
+}
+
+void retire(std::function<void()> release)
+{
+   if (render_running)
+      retired.push_back({ next_sequence, std::move(release) });
+   else
+      release();
+}
+
+void retire_program(GLuint program)
+{
+   if (program)
+      retire([program] { glDeleteProgram(program); });
+}
+
+void release_retired()
+{
+   const uint64_t taken = render_running ? render_taken.load() : UINT64_MAX;
+   while (!retired.empty() && retired.front().sequence <= taken)
+   {
+      retired.front().release();
+      retired.pop_front();
+   }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+#include <functional>
+
+// Deferred deletion of objects the render thread may still draw with. Every
+// frame the UI thread publishes is numbered; an object retired while frame n
+// is the next one to publish is released once the render thread took frame n
+// or a later one, as only earlier frames can name it. Everything but
+// frame_taken() is called by the UI thread.
+
+// Number the frame about to be published.
+uint64_t next_frame_sequence();
+// The render thread took the frame numbered sequence and never draws an
+// earlier one again.
+void frame_taken(uint64_t sequence);
+
+// Between these objects wait for the render thread, otherwise they are
+// released right away. end_render_thread() releases what is still waiting.
+void begin_render_thread();
+void end_render_thread();
+
+// Call release once no frame published before now is drawn anymore.
+void retire(std::function<void()> release);
+void retire_program(GLuint program);
+// Run the releases the render thread is done with. Called once a frame.
+void release_retired();
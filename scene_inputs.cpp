@@ -0,0 +1,180 @@
+#include "scene_inputs.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "opengl_util.h"
+
+void scene_inputs::init()
+{
+   glGenBuffers(1, &params_buffer);
+   glBindBufferBase(GL_UNIFORM_BUFFER, scene_params_binding, params_buffer);
+
+   // The BVH buffers are refilled in place, so the texture bindings stay valid.
+   glGenBuffers(2, bvh_buffers);
+   glGenTextures(2, bvh_textures);
+   const GLint units[2] = { bvh_nodes_unit, bvh_primitives_unit };
+   for (int i = 0; i < 2; ++i)
+   {
+      glBindBuffer(GL_TEXTURE_BUFFER, bvh_buffers[i]);
+      glBufferData(GL_TEXTURE_BUFFER, 8 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+      glActiveTexture(GL_TEXTURE0 + units[i]);
+      glBindTexture(GL_TEXTURE_BUFFER, bvh_textures[i]);
+      glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bvh_buffers[i]);
+   }
+   glActiveTexture(GL_TEXTURE0);
+   glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+   glGenTextures(2, volume_textures);
+   for (int i = 0; i < 2; ++i)
+   {
+      // The brick table is fetched per texel, the atlas filtered.
+      const GLint filter = i ? GL_LINEAR : GL_NEAREST;
+      glBindTexture(GL_TEXTURE_3D, volume_textures[i]);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, filter);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, filter);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+   }
+   glBindTexture(GL_TEXTURE_3D, 0);
+}
+
+void scene_inputs::destroy()
+{
+   glDeleteBuffers(1, &params_buffer);
+   glDeleteTextures(2, bvh_textures);
+   glDeleteBuffers(2, bvh_buffers);
+   glDeleteTextures(2, volume_textures);
+}
+
+void scene_inputs::upload_params()
+{
+   static std::vector<float> params;
+   graph.pack_params(params);
+   glBindBuffer(GL_UNIFORM_BUFFER, params_buffer);
+   glBufferData(GL_UNIFORM_BUFFER, params.size() * sizeof(float), params.data(), GL_DYNAMIC_DRAW);
+
+   if (graph.use_bvh)
+   {
+      graph.build_bvh();
+      graph.bvh.pack_nodes(params);
+      glBindBuffer(GL_TEXTURE_BUFFER, bvh_buffers[0]);
+      glBufferData(GL_TEXTURE_BUFFER, params.size() * sizeof(float), params.data(), GL_DYNAMIC_DRAW);
+      graph.bvh.pack_primitives(params);
+      glBindBuffer(GL_TEXTURE_BUFFER, bvh_buffers[1]);
+      glBufferData(GL_TEXTURE_BUFFER, params.size() * sizeof(float), params.data(), GL_DYNAMIC_DRAW);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+   }
+}
+
+void scene_inputs::upload_volume()
+{
+   const int stored = int(volume.header.stored_bricks);
+   int atlas = 1;
+   while (atlas * atlas * atlas < stored)
+      ++atlas;
+   const int atlas_layers = std::max(1, (stored + atlas * atlas - 1) / (atlas * atlas));
+   volume_atlas_bricks = atlas;
+
+   glActiveTexture(GL_TEXTURE0 + volume_bricks_unit);
+   glBindTexture(GL_TEXTURE_3D, volume_textures[0]);
+   glTexImage3D(GL_TEXTURE_3D, 0, GL_RG32F, volume.header.bricks[0], volume.header.bricks[1], volume.header.bricks[2],
+                0, GL_RG, GL_FLOAT, volume.brick_table);
+
+   const int n = sdf_volume::brick_samples;
+   const GLenum type = volume.header.bits == 16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+   const size_t brick_bytes = sdf_volume::samples_per_brick * (volume.header.bits / 8);
+   glActiveTexture(GL_TEXTURE0 + volume_atlas_unit);
+   glBindTexture(GL_TEXTURE_3D, volume_textures[1]);
+   glTexImage3D(GL_TEXTURE_3D, 0, volume.header.bits == 16 ? GL_R16 : GL_R8, atlas * n, atlas * n, atlas_layers * n,
+                0, GL_RED, type, nullptr);
+   // Rows of 9 samples are not 4 byte aligned.
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+   for (int slot = 0; slot < stored; ++slot)
+   {
+      glTexSubImage3D(GL_TEXTURE_3D, 0, (slot % atlas) * n, ((slot / atlas) % atlas) * n, (slot / (atlas * atlas)) * n,
+                      n, n, n, GL_RED, type, volume.samples + slot * brick_bytes);
+   }
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+   glActiveTexture(GL_TEXTURE0);
+}
+
+bool scene_inputs::params_fit() const
+{
+   static GLint max_block_size = 0;
+   if (!max_block_size)
+      glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &max_block_size);
+   static std::vector<float> params;
+   graph.pack_params(params);
+   return params.size() * sizeof(float) <= size_t(max_block_size);
+}
+
+GLuint scene_inputs::compile_shader(const char* filename, const char* defines, GLenum type) const
+{
+   const std::string scene_code = graph.generate_glsl();
+   std::string prelude = "#define SCENE_GRAPH";
+   if (graph.use_bvh)
+      prelude += "\n#define SCENE_BVH";
+   if (graph.has_gradient())
+      prelude += "\n#define SCENE_GRADIENT";
+   if (use_volume && !volume.empty())
+      prelude += "\n#define BAKED_SDF";
+   if (defines)
+      prelude += std::string("\n") + defines;
+   return compile_shader_from_file(type, filename, prelude.c_str(), scene_code.c_str());
+}
+
+void scene_inputs::set_volume_uniforms(GLuint program) const
+{
+   if (volume.empty())
+      return;
+   const aabb bounds = volume.bounds();
+   const float brick_size = volume.header.voxel_size * sdf_volume::brick_voxels;
+   glProgramUniform1i(program, glGetUniformLocation(program, "iBakedBricks"), volume_bricks_unit);
+   glProgramUniform1i(program, glGetUniformLocation(program, "iBakedAtlas"), volume_atlas_unit);
+   glProgramUniform3f(program, glGetUniformLocation(program, "iBakedMin"), bounds.lo.x, bounds.lo.y, bounds.lo.z);
+   glProgramUniform3f(program, glGetUniformLocation(program, "iBakedMax"), bounds.hi.x, bounds.hi.y, bounds.hi.z);
+   glProgramUniform1f(program, glGetUniformLocation(program, "iBakedBrickSize"), brick_size);
+   glProgramUniform1f(program, glGetUniformLocation(program, "iBakedBand"), volume.header.band);
+   glProgramUniform1i(program, glGetUniformLocation(program, "iBakedAtlasBricks"), volume_atlas_bricks);
+   glProgramUniform1f(program, glGetUniformLocation(program, "iBakedFallback"), 2.0f * volume.header.voxel_size);
+}
+
+void scene_inputs::bind_program(quad_program& out) const
+{
+   get_frame_uniforms(out);
+   out.prev_resolution_uniform = glGetUniformLocation(out.program, "iPrevResolution");
+   out.prev_mouse_uniform = glGetUniformLocation(out.program, "iPrevMouse");
+   out.history_valid_uniform = glGetUniformLocation(out.program, "iHistoryValid");
+   out.history_blend_uniform = glGetUniformLocation(out.program, "iHistoryBlend");
+   out.jitter_uniform = glGetUniformLocation(out.program, "iJitter");
+   out.generation_uniform = glGetUniformLocation(out.program, "iGeneration");
+   out.start_depth_scale_uniform = glGetUniformLocation(out.program, "iStartDepthScale");
+   GLuint scene_block = glGetUniformBlockIndex(out.program, "SceneParams");
+   if (scene_block != GL_INVALID_INDEX)
+      glUniformBlockBinding(out.program, scene_block, scene_params_binding);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iBVHNodes"), bvh_nodes_unit);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iBVHPrimitives"), bvh_primitives_unit);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iStartDepth"), start_depth_unit);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iPrevColor"), prev_color_unit);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iPrevDepth"), prev_depth_unit);
+   glProgramUniform1i(out.program, glGetUniformLocation(out.program, "iShaded"), interleave_shaded_unit);
+   set_volume_uniforms(out.program);
+}
+
+void scene_inputs::bind() const
+{
+   glBindBufferBase(GL_UNIFORM_BUFFER, scene_params_binding, params_buffer);
+   const GLint buffer_units[2] = { bvh_nodes_unit, bvh_primitives_unit };
+   const GLint volume_units[2] = { volume_bricks_unit, volume_atlas_unit };
+   for (int i = 0; i < 2; ++i)
+   {
+      glActiveTexture(GL_TEXTURE0 + buffer_units[i]);
+      glBindTexture(GL_TEXTURE_BUFFER, bvh_textures[i]);
+      glActiveTexture(GL_TEXTURE0 + volume_units[i]);
+      glBindTexture(GL_TEXTURE_3D, volume_textures[i]);
+   }
+   glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdint.h>
+
+#include "quad_program.h"
+#include "sdf_scene.h"
+#include "sdf_volume.h"
+
+// The scene graph and baked volume the raymarcher draws, and the objects it
+// reads them from: the SceneParams uniform buffer, the BVH texture buffers
+// and the volume textures. Uploaded by the UI thread.
+class scene_inputs
+{
+public:
+   sdf_scene graph = sdf_scene::default_scene();
+   sdf_volume volume;
+   // March the baked volume instead of evaluating sceneSDF everywhere.
+   bool use_volume = false;
+   // topology_hash() of the graph compiled into the raymarcher.
+   uint64_t topology = 0;
+
+   void init();
+   void destroy();
+
+   // Upload the parameters of graph, and its BVH if it uses one.
+   void upload_params();
+   // Upload the brick table and the stored bricks of volume. The samples are
+   // read straight from the file mapping.
+   void upload_volume();
+   // Whether the SceneParams block of graph fits GL_MAX_UNIFORM_BLOCK_SIZE.
+   // Without the BVH every node reads it, so large scenes overflow it and the
+   // raymarcher fails to compile.
+   bool params_fit() const;
+
+   // Compile the raymarcher with the graph's generated sceneSDF appended.
+   // defines is injected after #version along with the scene's own switches.
+   GLuint compile_shader(const char* filename, const char* defines, GLenum type = GL_FRAGMENT_SHADER) const;
+   // Look up the uniforms of a raymarcher build and point its samplers and
+   // uniform block at their units.
+   void bind_program(quad_program& out) const;
+   // Bind the buffers and textures of the scene. Bindings are per context,
+   // and another context only sees new contents of shared objects once it
+   // binds them again, so each context drawing the raymarcher calls this
+   // every frame.
+   void bind() const;
+
+private:
+   void set_volume_uniforms(GLuint program) const;
+
+   GLuint params_buffer = 0;
+   GLuint bvh_buffers[2] = {};
+   GLuint bvh_textures[2] = {};
+   // Brick table and sample atlas of the baked volume.
+   GLuint volume_textures[2] = {};
+   GLint volume_atlas_bricks = 0;
+};
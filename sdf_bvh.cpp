@@ -0,0 +1,129 @@
+#include "sdf_bvh.h"
+
+aabb sdf_primitive::bounds() const
+{
+   aabb b;
+   vec3 r = extents + vec3(radius);
+   b.grow(center - r);
+   b.grow(center + r);
+   return b;
+}
+
+float sdf_primitive::distance(vec3 p) const
+{
+   switch (type)
+   {
+   case sphere:
+      return sdf_sphere(p, center, radius);
+   case box:
+      return sdf_box(p - center, extents);
+   default:
+      return sdf_rounded_box(p - center, extents, radius);
+   }
+}
+
+void sdf_bvh::build(std::vector<sdf_primitive> prims)
+{
+   nodes.clear();
+   primitives.clear();
+   if (prims.empty())
+      return;
+   nodes.reserve(2 * prims.size() / max_leaf_size + 1);
+   build_node(prims, 0, int(prims.size()), 0);
+   primitives = std::move(prims);
+}
+
+int sdf_bvh::build_node(std::vector<sdf_primitive>& prims, int begin, int end, int depth)
+{
+   const int index = int(nodes.size());
+   nodes.push_back({});
+   aabb bounds;
+   aabb centers;
+   for (int i = begin; i < end; ++i)
+   {
+      bounds.grow(prims[i].bounds());
+      centers.grow(prims[i].center);
+   }
+   nodes[index].bounds = bounds;
+
+   if (end - begin <= max_leaf_size || depth == max_depth)
+   {
+      nodes[index].first = begin;
+      nodes[index].second = begin - end;
+      return index;
+   }
+
+   // Median split along the widest axis of the primitive centers.
+   const vec3 extent = centers.size();
+   const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+   const int mid = begin + (end - begin) / 2;
+   std::nth_element(prims.begin() + begin, prims.begin() + mid, prims.begin() + end,
+                    [axis](const sdf_primitive& a, const sdf_primitive& b) { return a.center[axis] < b.center[axis]; });
+
+   const int left = build_node(prims, begin, mid, depth + 1);
+   const int right = build_node(prims, mid, end, depth + 1);
+   nodes[index].first = left;
+   nodes[index].second = right;
+   return index;
+}
+
+float sdf_bvh::distance(vec3 p, float best) const
+{
+   if (nodes.empty())
+      return best;
+   int stack[max_depth + 1];
+   int size = 0;
+   stack[size++] = 0;
+   while (size > 0)
+   {
+      const sdf_bvh_node& node = nodes[stack[--size]];
+      if (sdf_aabb(p, node.bounds) >= best)
+         continue;
+      if (node.leaf())
+      {
+         for (int i = node.first; i < node.first - node.second; ++i)
+            best = std::min(best, primitives[i].distance(p));
+         continue;
+      }
+      // Push the farther child first so the nearer one tightens best sooner.
+      const float d0 = sdf_aabb(p, nodes[node.first].bounds);
+      const float d1 = sdf_aabb(p, nodes[node.second].bounds);
+      stack[size++] = d0 < d1 ? node.second : node.first;
+      stack[size++] = d0 < d1 ? node.first : node.second;
+   }
+   return best;
+}
+
+void sdf_bvh::pack_nodes(std::vector<float>& out) const
+{
+   out.clear();
+   if (nodes.empty())
+   {
+      // Buffer textures cannot be empty. A single far away leaf is always
+      // culled by the shader.
+      out.insert(out.end(), { 1e30f, 1e30f, 1e30f, 0.0f, 1e30f, 1e30f, 1e30f, -1.0f });
+      return;
+   }
+   out.reserve(nodes.size() * 8);
+   for (const sdf_bvh_node& node : nodes)
+   {
+      out.insert(out.end(), { node.bounds.lo.x, node.bounds.lo.y, node.bounds.lo.z, float(node.first) });
+      out.insert(out.end(), { node.bounds.hi.x, node.bounds.hi.y, node.bounds.hi.z, float(node.second) });
+   }
+}
+
+void sdf_bvh::pack_primitives(std::vector<float>& out) const
+{
+   out.clear();
+   if (primitives.empty())
+   {
+      out.insert(out.end(), { 1e30f, 1e30f, 1e30f, float(sdf_primitive::sphere), 0.0f, 0.0f, 0.0f, 0.0f });
+      return;
+   }
+   out.reserve(primitives.size() * 8);
+   for (const sdf_primitive& prim : primitives)
+   {
+      out.insert(out.end(), { prim.center.x, prim.center.y, prim.center.z, float(prim.type) });
+      out.insert(out.end(), { prim.extents.x, prim.extents.y, prim.extents.z, prim.radius });
+   }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+
+#include "sdf_math.h"
+
+// A bounded primitive with its translations folded into center. Types match
+// the switch in bvhPrimitiveSDF() in raymarch.glsl.
+struct sdf_primitive
+{
+   enum type_id
+   {
+      sphere = 0,
+      box = 1,
+      rounded_box = 2,
+   };
+
+   int type;
+   vec3 center;
+   vec3 extents; // half extents, zero for spheres
+   float radius; // sphere or corner radius, zero for boxes
+
+   aabb bounds() const;
+   float distance(vec3 p) const;
+};
+
+// Inner nodes store their children in first and second. Leaves store their
+// first primitive in first and minus their primitive count in second.
+struct sdf_bvh_node
+{
+   aabb bounds;
+   int first;
+   int second;
+
+   bool leaf() const { return second < 0; }
+};
+
+// Bounding volume hierarchy over the bounded primitives of a scene. Nodes are
+// visited only while their box is closer than the best distance found so far,
+// so the result is exactly the minimum over all primitives.
+class sdf_bvh
+{
+public:
+   // Matches BVH_STACK_SIZE in raymarch.glsl. Median splits keep the depth
+   // logarithmic, so this is never reached in practice.
+   static const int max_depth = 31;
+   static const int max_leaf_size = 4;
+
+   std::vector<sdf_bvh_node> nodes;
+   std::vector<sdf_primitive> primitives;
+
+   void build(std::vector<sdf_primitive> prims);
+   bool empty() const { return nodes.empty(); }
+
+   // min(best, distance to the closest primitive).
+   float distance(vec3 p, float best) const;
+
+   // GPU layout: two RGBA32F texels per node (lo, first) (hi, second) and two
+   // per primitive (center, type) (extents, radius).
+   void pack_nodes(std::vector<float>& out) const;
+   void pack_primitives(std::vector<float>& out) const;
+
+private:
+   int build_node(std::vector<sdf_primitive>& prims, int begin, int end, int depth);
+};
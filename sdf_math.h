@@ -0,0 +1,101 @@
+#pragma once
+
+#include <math.h>
+
+#include <algorithm>
+
+// Just enough vector math to describe and evaluate SDF scenes on the CPU.
+// Function names follow their GLSL counterparts.
+struct vec3
+{
+   float x = 0;
+   float y = 0;
+   float z = 0;
+
+   vec3() = default;
+   vec3(float x, float y, float z)
+      : x(x)
+      , y(y)
+      , z(z)
+   {
+   }
+   explicit vec3(float s)
+      : x(s)
+      , y(s)
+      , z(s)
+   {
+   }
+
+   float& operator[](int i) { return (&x)[i]; }
+   float operator[](int i) const { return (&x)[i]; }
+};
+
+inline vec3 operator+(vec3 a, vec3 b) { return vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline vec3 operator-(vec3 a, vec3 b) { return vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline vec3 operator-(vec3 a) { return vec3(-a.x, -a.y, -a.z); }
+inline vec3 operator*(vec3 a, float s) { return vec3(a.x * s, a.y * s, a.z * s); }
+inline vec3 operator*(float s, vec3 a) { return a * s; }
+inline vec3 operator/(vec3 a, float s) { return vec3(a.x / s, a.y / s, a.z / s); }
+inline vec3& operator+=(vec3& a, vec3 b) { return a = a + b; }
+
+inline float dot(vec3 a, vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline float length(vec3 a) { return sqrtf(dot(a, a)); }
+inline vec3 normalize(vec3 a) { return a / length(a); }
+inline vec3 cross(vec3 a, vec3 b) { return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+inline vec3 abs(vec3 a) { return vec3(fabsf(a.x), fabsf(a.y), fabsf(a.z)); }
+inline vec3 min(vec3 a, vec3 b) { return vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+inline vec3 max(vec3 a, vec3 b) { return vec3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)); }
+inline vec3 max(vec3 a, float s) { return max(a, vec3(s)); }
+inline float max_component(vec3 a) { return std::max(a.x, std::max(a.y, a.z)); }
+
+struct aabb
+{
+   vec3 lo = vec3(INFINITY);
+   vec3 hi = vec3(-INFINITY);
+
+   void grow(vec3 p)
+   {
+      lo = min(lo, p);
+      hi = max(hi, p);
+   }
+   void grow(const aabb& b)
+   {
+      lo = min(lo, b.lo);
+      hi = max(hi, b.hi);
+   }
+   vec3 center() const { return (lo + hi) * 0.5f; }
+   vec3 size() const { return hi - lo; }
+};
+
+// CPU versions of the distance functions in raymarch.glsl.
+inline float sdf_sphere(vec3 p, vec3 c, float r) { return length(p - c) - r; }
+
+inline float sdf_box(vec3 p, vec3 b)
+{
+   vec3 d = abs(p) - b;
+   return std::min(max_component(d), 0.0f) + length(max(d, 0.0f));
+}
+
+inline float sdf_rounded_box(vec3 p, vec3 b, float r) { return length(max(abs(p) - b, 0.0f)) - r; }
+
+inline float sdf_plane(vec3 p, vec3 n, float d) { return dot(p, n) + d; }
+
+// Signed distance to a box given by its corners, zero or negative inside.
+inline float sdf_aabb(vec3 p, const aabb& b)
+{
+   vec3 d = max(b.lo - p, p - b.hi);
+   return std::min(max_component(d), 0.0f) + length(max(d, 0.0f));
+}
+
+inline float glsl_mod(float x, float y) { return x - y * floorf(x / y); }
+
+inline vec3 repeat(vec3 p, float period)
+{
+   return vec3(glsl_mod(p.x, period), glsl_mod(p.y, period), glsl_mod(p.z, period)) - vec3(0.5f * period);
+}
+
+inline float op_smooth_union(float a, float b, float k)
+{
+   float h = std::min(std::max(0.5f + 0.5f * (b - a) / k, 0.0f), 1.0f);
+   return b + (a - b) * h - k * h * (1.0f - h);
+}
@@ -0,0 +1,568 @@
+#include "sdf_scene.h"
+
+#include <stdio.h>
+
+namespace {
+   // Split the scene below index into bounded primitives, which go into the
+   // BVH, and everything else. Only unions and translations are looked through.
+   void split_scene(const sdf_scene& scene, int index, bool translated, vec3 offset,
+                    std::vector<sdf_primitive>* bounded, std::vector<sdf_subtree>& unbounded)
+   {
+      const sdf_node& node = scene.nodes[index];
+      const float* n = node.params;
+      switch (node.type)
+      {
+      case sdf_node_type::union_op:
+         for (int child : node.children)
+            split_scene(scene, child, translated, offset, bounded, unbounded);
+         return;
+      case sdf_node_type::translate:
+         if (!node.children.empty())
+            split_scene(scene, node.children[0], true, offset + vec3(n[0], n[1], n[2]), bounded, unbounded);
+         return;
+      case sdf_node_type::sphere:
+         if (bounded)
+            bounded->push_back({ sdf_primitive::sphere, offset + vec3(n[0], n[1], n[2]), vec3(), n[3] });
+         return;
+      case sdf_node_type::box:
+         if (bounded)
+            bounded->push_back({ sdf_primitive::box, offset, vec3(n[0], n[1], n[2]), 0 });
+         return;
+      case sdf_node_type::rounded_box:
+         if (bounded)
+            bounded->push_back({ sdf_primitive::rounded_box, offset, vec3(n[0], n[1], n[2]), n[3] });
+         return;
+      default:
+         unbounded.push_back({ index, translated, offset });
+         return;
+      }
+   }
+
+   // Walks the scene once, assigning parameter slots in a fixed order. Code is
+   // only emitted when code is non-null, so packing parameters runs exactly
+   // the same traversal as code generation. With gradient set every value is
+   // a vec4 of gradient and distance instead of a float distance.
+   struct sdf_compiler
+   {
+      const sdf_scene& scene;
+      std::string* code;
+      std::vector<float>& params;
+      bool gradient = false;
+      int next_var = 0;
+
+      int slot(float x, float y, float z, float w)
+      {
+         const int index = int(params.size() / 4);
+         params.insert(params.end(), { x, y, z, w });
+         return index;
+      }
+
+      std::string var(char prefix) { return prefix + std::to_string(next_var++); }
+
+      std::string param(int slot) { return "sceneParams[" + std::to_string(slot) + "]"; }
+
+      // Declaration of a new value, e.g. "float d3 = ".
+      std::string declare(const std::string& name) const { return (gradient ? "vec4 " : "float ") + name + " = "; }
+
+      // GLSL function computing the current kind of value.
+      std::string function(const char* name) const { return gradient ? std::string(name) + "Grad" : name; }
+
+      std::string far_away() const { return gradient ? "vec4(0.0, 1.0, 0.0, MAX_DIST)" : "MAX_DIST"; }
+
+      void line(const std::string& text)
+      {
+         if (code)
+            *code += "   " + text + "\n";
+      }
+
+      // Apply a pending translation to the sample point.
+      std::string offset_point(const std::string& point, vec3 offset)
+      {
+         const int s = slot(offset.x, offset.y, offset.z, 0);
+         const std::string p = var('p');
+         line("vec3 " + p + " = " + point + " - " + param(s) + ".xyz;");
+         return p;
+      }
+
+      static bool absorbs_offset(sdf_node_type type)
+      {
+         return type == sdf_node_type::sphere || type == sdf_node_type::plane;
+      }
+
+      void flatten_union(int index, std::vector<int>& out)
+      {
+         for (int child : scene.nodes[index].children)
+         {
+            if (scene.nodes[child].type == sdf_node_type::union_op)
+               flatten_union(child, out);
+            else
+               out.push_back(child);
+         }
+      }
+
+      // Emits the distance to a node and returns the variable holding it.
+      // translated says whether a translation is pending above this node;
+      // offset holds its summed value.
+      std::string emit(int index, std::string point, bool translated, vec3 offset)
+      {
+         const sdf_node& node = scene.nodes[index];
+         const float* n = node.params;
+         switch (node.type)
+         {
+         case sdf_node_type::sphere:
+         {
+            const int s = slot(n[0] + offset.x, n[1] + offset.y, n[2] + offset.z, n[3]);
+            const std::string d = var('d');
+            line(declare(d) + function("sdfSphere") + "(" + point + ", " + param(s) + ".xyz, " + param(s) + ".w);");
+            return d;
+         }
+         case sdf_node_type::plane:
+         {
+            const vec3 normal(n[0], n[1], n[2]);
+            const int s = slot(n[0], n[1], n[2], n[3] - dot(normal, offset));
+            const std::string d = var('d');
+            line(declare(d) + function("sdfPlane") + "(" + point + ", " + param(s) + ");");
+            return d;
+         }
+         case sdf_node_type::box:
+         {
+            if (translated)
+               point = offset_point(point, offset);
+            const int s = slot(n[0], n[1], n[2], 0);
+            const std::string d = var('d');
+            line(declare(d) + function("sdfBox") + "(" + point + ", " + param(s) + ".xyz);");
+            return d;
+         }
+         case sdf_node_type::rounded_box:
+         {
+            if (translated)
+               point = offset_point(point, offset);
+            const int s = slot(n[0], n[1], n[2], n[3]);
+            const std::string d = var('d');
+            line(declare(d) + function("sdfRoundedBox") + "(" + point + ", " + param(s) + ".xyz, " + param(s) + ".w);");
+            return d;
+         }
+         case sdf_node_type::translate:
+            if (node.children.empty())
+               break;
+            return emit(node.children[0], point, true, offset + vec3(n[0], n[1], n[2]));
+         case sdf_node_type::repeat:
+         {
+            if (node.children.empty())
+               break;
+            if (translated)
+               point = offset_point(point, offset);
+            const int s = slot(n[0], 0, 0, 0);
+            const std::string p = var('p');
+            line("vec3 " + p + " = repeat(" + point + ", " + param(s) + ".x);");
+            return emit(node.children[0], p, false, vec3());
+         }
+         case sdf_node_type::union_op:
+         case sdf_node_type::smooth_union:
+         {
+            std::vector<int> children;
+            if (node.type == sdf_node_type::union_op)
+               flatten_union(index, children);
+            else
+               children = node.children;
+            if (children.empty())
+               break;
+
+            // Share one translated point between children that cannot fold
+            // the translation into their own parameters.
+            int needs_point = 0;
+            for (int child : children)
+               needs_point += !absorbs_offset(scene.nodes[child].type);
+            if (translated && needs_point > 1)
+            {
+               point = offset_point(point, offset);
+               translated = false;
+               offset = vec3();
+            }
+
+            const int k = node.type == sdf_node_type::smooth_union ? slot(n[0], 0, 0, 0) : -1;
+            std::string result = emit(children[0], point, translated, offset);
+            for (size_t i = 1; i < children.size(); ++i)
+            {
+               const std::string other = emit(children[i], point, translated, offset);
+               const std::string combined = var('d');
+               if (k < 0)
+                  line(declare(combined) + (gradient ? "opUnionGrad(" : "min(") + result + ", " + other + ");");
+               else
+                  line(declare(combined) + function("opSmoothUnion") + "(" + result + ", " + other + ", " + param(k) + ".x);");
+               result = combined;
+            }
+            return result;
+         }
+         }
+         const std::string d = var('d');
+         line(declare(d) + far_away() + ";");
+         return d;
+      }
+   };
+}
+
+int sdf_scene::add_node(sdf_node_type type, float p0, float p1, float p2, float p3)
+{
+   nodes.push_back({ type, { p0, p1, p2, p3 }, {} });
+   return int(nodes.size()) - 1;
+}
+
+int sdf_scene::add_sphere(vec3 center, float radius)
+{
+   return add_node(sdf_node_type::sphere, center.x, center.y, center.z, radius);
+}
+
+int sdf_scene::add_box(vec3 half_extents)
+{
+   return add_node(sdf_node_type::box, half_extents.x, half_extents.y, half_extents.z, 0);
+}
+
+int sdf_scene::add_rounded_box(vec3 half_extents, float radius)
+{
+   return add_node(sdf_node_type::rounded_box, half_extents.x, half_extents.y, half_extents.z, radius);
+}
+
+int sdf_scene::add_plane(vec3 normal, float offset)
+{
+   normal = normalize(normal);
+   return add_node(sdf_node_type::plane, normal.x, normal.y, normal.z, offset);
+}
+
+int sdf_scene::add_union(const std::vector<int>& children)
+{
+   const int index = add_node(sdf_node_type::union_op, 0, 0, 0, 0);
+   nodes[index].children = children;
+   return index;
+}
+
+int sdf_scene::add_smooth_union(float k, const std::vector<int>& children)
+{
+   const int index = add_node(sdf_node_type::smooth_union, k, 0, 0, 0);
+   nodes[index].children = children;
+   return index;
+}
+
+int sdf_scene::add_translate(vec3 offset, int child)
+{
+   const int index = add_node(sdf_node_type::translate, offset.x, offset.y, offset.z, 0);
+   nodes[index].children.push_back(child);
+   return index;
+}
+
+int sdf_scene::add_repeat(float period, int child)
+{
+   const int index = add_node(sdf_node_type::repeat, period, 0, 0, 0);
+   nodes[index].children.push_back(child);
+   return index;
+}
+
+static void hash_node(const sdf_scene& scene, int index, uint64_t& hash)
+{
+   auto mix = [&hash](uint64_t value) {
+      for (int i = 0; i < 8; ++i)
+      {
+         hash ^= (value >> (i * 8)) & 0xff;
+         hash *= 0x100000001b3ull;
+      }
+   };
+   const sdf_node& node = scene.nodes[index];
+   mix(uint64_t(node.type));
+   mix(node.children.size());
+   for (int child : node.children)
+      hash_node(scene, child, hash);
+}
+
+uint64_t sdf_scene::topology_hash() const
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   if (root < 0)
+      return hash;
+   if (!use_bvh)
+   {
+      hash_node(*this, root, hash);
+      return hash;
+   }
+   // Only the parts outside the BVH end up in the generated code.
+   std::vector<sdf_subtree> parts;
+   split_scene(*this, root, false, vec3(), nullptr, parts);
+   hash = ~hash;
+   for (const sdf_subtree& subtree : parts)
+   {
+      hash ^= uint64_t(subtree.translated);
+      hash *= 0x100000001b3ull;
+      hash_node(*this, subtree.node, hash);
+   }
+   return hash;
+}
+
+// Emits the whole scene and returns the variable holding its distance.
+static std::string emit_scene(const sdf_scene& scene, sdf_compiler& compiler)
+{
+   if (scene.root < 0)
+      return compiler.far_away();
+   if (!scene.use_bvh)
+      return compiler.emit(scene.root, "p", false, vec3());
+
+   std::vector<sdf_subtree> parts;
+   split_scene(scene, scene.root, false, vec3(), nullptr, parts);
+   std::string result = "MAX_DIST";
+   for (const sdf_subtree& subtree : parts)
+   {
+      const std::string d = compiler.emit(subtree.node, "p", subtree.translated, subtree.offset);
+      if (result == "MAX_DIST")
+      {
+         result = d;
+         continue;
+      }
+      const std::string combined = compiler.var('d');
+      compiler.line("float " + combined + " = min(" + result + ", " + d + ");");
+      result = combined;
+   }
+   return "bvhSDF(p, " + result + ")";
+}
+
+std::string sdf_scene::generate_glsl() const
+{
+   std::vector<float> params;
+   std::string body;
+   sdf_compiler compiler{ *this, &body, params };
+   const std::string result = emit_scene(*this, compiler);
+
+   const int count = std::max(1, int(params.size() / 4));
+   std::string code;
+   code += "#define SCENE_PARAM_COUNT " + std::to_string(count) + "\n";
+   code += "layout(std140) uniform SceneParams\n{\n   vec4 sceneParams[SCENE_PARAM_COUNT];\n};\n\n";
+   code += "float sceneSDF(vec3 p)\n{\n" + body + "   return " + result + ";\n}\n";
+
+   if (has_gradient())
+   {
+      // Same traversal, so the slots match the ones used above.
+      std::vector<float> gradient_params;
+      std::string gradient_body;
+      sdf_compiler gradient{ *this, &gradient_body, gradient_params };
+      gradient.gradient = true;
+      const std::string gradient_result = emit_scene(*this, gradient);
+      code += "\nvec4 sceneGradient(vec3 p)\n{\n" + gradient_body + "   return " + gradient_result + ";\n}\n";
+   }
+   return code;
+}
+
+void sdf_scene::pack_params(std::vector<float>& out) const
+{
+   out.clear();
+   sdf_compiler compiler{ *this, nullptr, out };
+   emit_scene(*this, compiler);
+   if (out.empty())
+      out.resize(4);
+}
+
+void sdf_scene::build_bvh()
+{
+   std::vector<sdf_primitive> bounded;
+   unbounded.clear();
+   if (root >= 0)
+      split_scene(*this, root, false, vec3(), &bounded, unbounded);
+   bvh.build(std::move(bounded));
+}
+
+float sdf_scene::evaluate_node(int index, vec3 p) const
+{
+   const sdf_node& node = nodes[index];
+   const float* n = node.params;
+   switch (node.type)
+   {
+   case sdf_node_type::sphere:
+      return sdf_sphere(p, vec3(n[0], n[1], n[2]), n[3]);
+   case sdf_node_type::box:
+      return sdf_box(p, vec3(n[0], n[1], n[2]));
+   case sdf_node_type::rounded_box:
+      return sdf_rounded_box(p, vec3(n[0], n[1], n[2]), n[3]);
+   case sdf_node_type::plane:
+      return sdf_plane(p, vec3(n[0], n[1], n[2]), n[3]);
+   case sdf_node_type::translate:
+      if (node.children.empty())
+         break;
+      return evaluate_node(node.children[0], p - vec3(n[0], n[1], n[2]));
+   case sdf_node_type::repeat:
+      if (node.children.empty())
+         break;
+      return evaluate_node(node.children[0], repeat(p, n[0]));
+   case sdf_node_type::union_op:
+   case sdf_node_type::smooth_union:
+   {
+      if (node.children.empty())
+         break;
+      float d = evaluate_node(node.children[0], p);
+      for (size_t i = 1; i < node.children.size(); ++i)
+      {
+         const float other = evaluate_node(node.children[i], p);
+         d = node.type == sdf_node_type::union_op ? std::min(d, other) : op_smooth_union(d, other, n[0]);
+      }
+      return d;
+   }
+   }
+   return max_distance;
+}
+
+float sdf_scene::evaluate(vec3 p) const
+{
+   if (root < 0)
+      return max_distance;
+   if (!use_bvh)
+      return evaluate_node(root, p);
+   float d = max_distance;
+   for (const sdf_subtree& subtree : unbounded)
+      d = std::min(d, evaluate_node(subtree.node, p - subtree.offset));
+   return bvh.distance(p, d);
+}
+
+int sdf_scene::depth(int index) const
+{
+   int deepest = 0;
+   for (int child : nodes[index].children)
+      deepest = std::max(deepest, depth(child));
+   return deepest + 1;
+}
+
+// Each level of the tree uses at most 4 * count floats of scratch: a
+// transformed point and one child result.
+void sdf_scene::evaluate_node(int index, const float* x, const float* y, const float* z, float* out, int count,
+                              float* scratch) const
+{
+   const sdf_node& node = nodes[index];
+   const float* n = node.params;
+   switch (node.type)
+   {
+   case sdf_node_type::sphere:
+      for (int i = 0; i < count; ++i)
+      {
+         const float dx = x[i] - n[0], dy = y[i] - n[1], dz = z[i] - n[2];
+         out[i] = sqrtf(dx * dx + dy * dy + dz * dz) - n[3];
+      }
+      return;
+   case sdf_node_type::box:
+      for (int i = 0; i < count; ++i)
+      {
+         const float dx = fabsf(x[i]) - n[0], dy = fabsf(y[i]) - n[1], dz = fabsf(z[i]) - n[2];
+         const float ox = std::max(dx, 0.0f), oy = std::max(dy, 0.0f), oz = std::max(dz, 0.0f);
+         out[i] = std::min(std::max(dx, std::max(dy, dz)), 0.0f) + sqrtf(ox * ox + oy * oy + oz * oz);
+      }
+      return;
+   case sdf_node_type::rounded_box:
+      for (int i = 0; i < count; ++i)
+      {
+         const float ox = std::max(fabsf(x[i]) - n[0], 0.0f);
+         const float oy = std::max(fabsf(y[i]) - n[1], 0.0f);
+         const float oz = std::max(fabsf(z[i]) - n[2], 0.0f);
+         out[i] = sqrtf(ox * ox + oy * oy + oz * oz) - n[3];
+      }
+      return;
+   case sdf_node_type::plane:
+      for (int i = 0; i < count; ++i)
+         out[i] = x[i] * n[0] + y[i] * n[1] + z[i] * n[2] + n[3];
+      return;
+   case sdf_node_type::translate:
+   case sdf_node_type::repeat:
+   {
+      if (node.children.empty())
+         break;
+      float* px = scratch;
+      float* py = px + count;
+      float* pz = py + count;
+      if (node.type == sdf_node_type::translate)
+      {
+         for (int i = 0; i < count; ++i)
+         {
+            px[i] = x[i] - n[0];
+            py[i] = y[i] - n[1];
+            pz[i] = z[i] - n[2];
+         }
+      }
+      else
+      {
+         const float half = 0.5f * n[0];
+         for (int i = 0; i < count; ++i)
+         {
+            px[i] = glsl_mod(x[i], n[0]) - half;
+            py[i] = glsl_mod(y[i], n[0]) - half;
+            pz[i] = glsl_mod(z[i], n[0]) - half;
+         }
+      }
+      evaluate_node(node.children[0], px, py, pz, out, count, scratch + 4 * count);
+      return;
+   }
+   case sdf_node_type::union_op:
+   case sdf_node_type::smooth_union:
+   {
+      if (node.children.empty())
+         break;
+      evaluate_node(node.children[0], x, y, z, out, count, scratch + 4 * count);
+      float* other = scratch + 3 * count;
+      for (size_t c = 1; c < node.children.size(); ++c)
+      {
+         evaluate_node(node.children[c], x, y, z, other, count, scratch + 4 * count);
+         if (node.type == sdf_node_type::union_op)
+         {
+            for (int i = 0; i < count; ++i)
+               out[i] = std::min(out[i], other[i]);
+         }
+         else
+         {
+            for (int i = 0; i < count; ++i)
+               out[i] = op_smooth_union(out[i], other[i], n[0]);
+         }
+      }
+      return;
+   }
+   }
+   std::fill(out, out + count, max_distance);
+}
+
+void sdf_scene::evaluate(const float* x, const float* y, const float* z, float* out, int count,
+                         std::vector<float>& scratch) const
+{
+   std::fill(out, out + count, max_distance);
+   if (root < 0)
+      return;
+   if (!use_bvh)
+   {
+      scratch.resize(size_t(depth(root) + 1) * 4 * count);
+      evaluate_node(root, x, y, z, out, count, scratch.data());
+      return;
+   }
+
+   // The parts outside the BVH are batched, the BVH itself prunes per point.
+   int deepest = 0;
+   for (const sdf_subtree& subtree : unbounded)
+      deepest = std::max(deepest, depth(subtree.node));
+   scratch.resize(size_t(deepest + 2) * 4 * count);
+   float* px = scratch.data();
+   float* py = px + count;
+   float* pz = py + count;
+   float* part = pz + count;
+   for (const sdf_subtree& subtree : unbounded)
+   {
+      for (int i = 0; i < count; ++i)
+      {
+         px[i] = x[i] - subtree.offset.x;
+         py[i] = y[i] - subtree.offset.y;
+         pz[i] = z[i] - subtree.offset.z;
+      }
+      evaluate_node(subtree.node, px, py, pz, part, count, part + count);
+      for (int i = 0; i < count; ++i)
+         out[i] = std::min(out[i], part[i]);
+   }
+   for (int i = 0; i < count; ++i)
+      out[i] = bvh.distance(vec3(x[i], y[i], z[i]), out[i]);
+}
+
+sdf_scene sdf_scene::default_scene()
+{
+   sdf_scene scene;
+   const int box = scene.add_rounded_box(vec3(0.2f, 0.4f, 0.2f), 0.04f);
+   const int sphere = scene.add_sphere(vec3(-0.35f, 0.1f, -0.3f), 0.2f);
+   const int floor = scene.add_plane(vec3(0.0f, 1.0f, 0.0f), 0.2f);
+   scene.root = scene.add_union({ box, sphere, floor });
+   return scene;
+}
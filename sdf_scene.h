@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "sdf_bvh.h"
+#include "sdf_math.h"
+
+enum class sdf_node_type
+{
+   sphere, // params: center xyz, radius
+   box, // params: half extents xyz
+   rounded_box, // params: half extents xyz, corner radius
+   plane, // params: normal xyz, offset
+   union_op, // params: none
+   smooth_union, // params: blend radius k
+   translate, // params: offset xyz
+   repeat, // params: period
+};
+
+struct sdf_node
+{
+   sdf_node_type type;
+   float params[4];
+   std::vector<int> children;
+};
+
+// A part of the scene that is not in the BVH, with the translation pending
+// above it.
+struct sdf_subtree
+{
+   int node;
+   bool translated;
+   vec3 offset;
+};
+
+// CPU description of the scene evaluated by sceneSDF() in raymarch.glsl.
+//
+// generate_glsl() emits a sceneSDF() specialised for the current topology:
+// nested unions are flattened, chains of translations are summed on the CPU
+// and folded into sphere centers and plane offsets where possible. Every
+// numeric parameter is read from the SceneParams uniform block, so edits that
+// keep the topology only need pack_params() and a buffer upload, while
+// topology_hash() tells when the shader has to be regenerated.
+//
+// With use_bvh set, spheres and boxes reachable from the root through unions
+// and translations are left out of the generated code and go into bvh
+// instead, which the shader traverses through bvhSDF(). Adding, removing or
+// moving those primitives then only needs build_bvh() and an upload.
+class sdf_scene
+{
+public:
+   std::vector<sdf_node> nodes;
+   int root = -1;
+   bool use_bvh = false;
+   sdf_bvh bvh;
+   // Scene parts outside bvh, filled in by build_bvh().
+   std::vector<sdf_subtree> unbounded;
+
+   // MAX_DIST in raymarch.glsl.
+   static constexpr float max_distance = 100.0f;
+
+   int add_sphere(vec3 center, float radius);
+   int add_box(vec3 half_extents);
+   int add_rounded_box(vec3 half_extents, float radius);
+   int add_plane(vec3 normal, float offset);
+   int add_union(const std::vector<int>& children);
+   int add_smooth_union(float k, const std::vector<int>& children);
+   int add_translate(vec3 offset, int child);
+   int add_repeat(float period, int child);
+
+   // Changes whenever the generated GLSL would change.
+   uint64_t topology_hash() const;
+
+   // GLSL defining the SceneParams block and sceneSDF(), plus sceneGradient()
+   // if has_gradient().
+   std::string generate_glsl() const;
+
+   // Whether generate_glsl() emits sceneGradient(), the analytic gradient of
+   // sceneSDF() in xyz and the distance in w. Not available through the BVH.
+   bool has_gradient() const { return !use_bvh; }
+
+   // Contents of the SceneParams block as vec4s, in the layout produced by
+   // generate_glsl() for the same topology.
+   void pack_params(std::vector<float>& out) const;
+
+   // Rebuild bvh and unbounded from the current parameters. Only meaningful
+   // with use_bvh.
+   void build_bvh();
+
+   // Distance from p to the scene on the CPU. With use_bvh set this goes
+   // through bvh, so build_bvh() must be current.
+   float evaluate(vec3 p) const;
+
+   // evaluate() for count points given as separate x, y and z arrays. The
+   // tree is walked once per batch and every node runs a plain loop over the
+   // points, which the compiler can turn into SIMD code in optimised builds
+   // (make opt). scratch is reused between calls.
+   void evaluate(const float* x, const float* y, const float* z, float* out, int count,
+                 std::vector<float>& scratch) const;
+
+   // Hand-written scene that used to live in raymarch.glsl.
+   static sdf_scene default_scene();
+
+private:
+   float evaluate_node(int index, vec3 p) const;
+   void evaluate_node(int index, const float* x, const float* y, const float* z, float* out, int count,
+                      float* scratch) const;
+   int depth(int index) const;
+   int add_node(sdf_node_type type, float p0, float p1, float p2, float p3);
+};
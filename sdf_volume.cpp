@@ -0,0 +1,223 @@
+#include "sdf_volume.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <thread>
+
+#include "sdf_scene.h"
+
+static const char volume_magic[4] = { 'S', 'D', 'F', 'V' };
+static const uint32_t volume_version = 1;
+
+// Run work(i) for i in [0, count) on every core.
+template <typename F>
+static void parallel_for(int count, F work)
+{
+   std::atomic<int> next(0);
+   auto worker = [&]() {
+      for (int i = next++; i < count; i = next++)
+         work(i);
+   };
+   const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+   std::vector<std::thread> threads;
+   for (unsigned i = 1; i < cores; ++i)
+      threads.emplace_back(worker);
+   worker();
+   for (std::thread& thread : threads)
+      thread.join();
+}
+
+bool sdf_volume::bake(const sdf_scene& scene, const sdf_volume_settings& settings)
+{
+   const vec3 extent = settings.bounds.size();
+   if (!(extent.x >= 0.0f && extent.y >= 0.0f && extent.z >= 0.0f && max_component(extent) > 0.0f)
+       || settings.resolution <= 0)
+   {
+      fprintf(stderr, "Cannot bake empty or inverted bounds\n");
+      return false;
+   }
+   file.unmap();
+   const float voxel = max_component(extent) / float(std::max(settings.resolution, brick_voxels));
+   const float brick_size = voxel * brick_voxels;
+   const float half_diagonal = 0.5f * brick_size * sqrtf(3.0f);
+
+   memcpy(header.magic, volume_magic, 4);
+   header.version = volume_version;
+   header.bits = settings.bits == 16 ? 16 : 8;
+   for (int axis = 0; axis < 3; ++axis)
+   {
+      header.bricks[axis] = uint32_t(std::max(1.0f, ceilf(extent[axis] / brick_size)));
+      header.lo[axis] = settings.bounds.lo[axis];
+   }
+   header.voxel_size = voxel;
+   // Samples of a brick that may hold the surface are within this of zero.
+   header.band = 2.0f * half_diagonal;
+
+   const int bx = int(header.bricks[0]);
+   const int by = int(header.bricks[1]);
+   const int count = brick_count();
+   const vec3 lo(header.lo[0], header.lo[1], header.lo[2]);
+   auto brick_origin = [&](int i) {
+      return lo + vec3(float(i % bx), float((i / bx) % by), float(i / (bx * by))) * brick_size;
+   };
+
+   // Classify bricks by the distance at their center. A brick can only
+   // contain the surface if that distance is within half its diagonal;
+   // otherwise subtracting the half diagonal gives a safe lower bound.
+   baked_table.assign(size_t(count) * 2, 0.0f);
+   parallel_for(count, [&](int i) {
+      const float d = scene.evaluate(brick_origin(i) + vec3(0.5f * brick_size));
+      baked_table[2 * i] = fabsf(d) <= half_diagonal ? 0.0f : -1.0f;
+      baked_table[2 * i + 1] = d > 0 ? std::max(d - half_diagonal, 0.0f) : std::min(d + half_diagonal, 0.0f);
+   });
+   uint32_t stored = 0;
+   for (int i = 0; i < count; ++i)
+   {
+      if (baked_table[2 * i] >= 0)
+         baked_table[2 * i] = float(stored++);
+   }
+   header.stored_bricks = stored;
+
+   baked_samples.assign(sample_bytes(), 0);
+   std::vector<int> stored_index;
+   stored_index.reserve(stored);
+   for (int i = 0; i < count; ++i)
+   {
+      if (baked_table[2 * i] >= 0)
+         stored_index.push_back(i);
+   }
+   const float max_value = header.bits == 16 ? 65535.0f : 255.0f;
+   parallel_for(int(stored), [&](int slot) {
+      // One batch per brick.
+      thread_local std::vector<float> xs, ys, zs, ds, scratch;
+      xs.resize(samples_per_brick);
+      ys.resize(samples_per_brick);
+      zs.resize(samples_per_brick);
+      ds.resize(samples_per_brick);
+      const vec3 origin = brick_origin(stored_index[slot]);
+      for (int k = 0, s = 0; k < brick_samples; ++k)
+      {
+         for (int j = 0; j < brick_samples; ++j)
+         {
+            for (int i = 0; i < brick_samples; ++i, ++s)
+            {
+               xs[s] = origin.x + voxel * i;
+               ys[s] = origin.y + voxel * j;
+               zs[s] = origin.z + voxel * k;
+            }
+         }
+      }
+      scene.evaluate(xs.data(), ys.data(), zs.data(), ds.data(), samples_per_brick, scratch);
+      uint8_t* out = baked_samples.data() + size_t(slot) * samples_per_brick * (header.bits / 8);
+      for (int s = 0; s < samples_per_brick; ++s)
+      {
+         const float t = std::min(std::max(ds[s] / header.band * 0.5f + 0.5f, 0.0f), 1.0f);
+         const uint32_t q = uint32_t(t * max_value + 0.5f);
+         if (header.bits == 16)
+            reinterpret_cast<uint16_t*>(out)[s] = uint16_t(q);
+         else
+            out[s] = uint8_t(q);
+      }
+   });
+
+   brick_table = baked_table.data();
+   samples = baked_samples.data();
+   return true;
+}
+
+bool sdf_volume::save(const char* filename) const
+{
+   if (empty())
+      return false;
+   // filename may be mapped by load(), here or in another process, and
+   // truncating it would fault every reader. The rename swaps in a new inode.
+   const std::string temp = std::string(filename) + ".tmp";
+   FILE* fp = fopen(temp.c_str(), "wb");
+   if (!fp)
+   {
+      fprintf(stderr, "Failed to open %s\n", temp.c_str());
+      return false;
+   }
+   bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+   ok = ok && fwrite(brick_table, sizeof(float) * 2, size_t(brick_count()), fp) == size_t(brick_count());
+   ok = ok && (!sample_bytes() || fwrite(samples, sample_bytes(), 1, fp) == 1);
+   ok = fclose(fp) == 0 && ok;
+   ok = ok && rename(temp.c_str(), filename) == 0;
+   if (!ok)
+   {
+      fprintf(stderr, "Failed to write %s\n", filename);
+      remove(temp.c_str());
+   }
+   return ok;
+}
+
+bool sdf_volume::load(const char* filename)
+{
+   baked_table.clear();
+   baked_samples.clear();
+   brick_table = nullptr;
+   samples = nullptr;
+   if (!file.map(filename))
+      return false;
+   if (!valid_file())
+   {
+      fprintf(stderr, "Not a distance volume %s\n", filename);
+      file.unmap();
+      return false;
+   }
+   const size_t table_bytes = size_t(brick_count()) * 2 * sizeof(float);
+   brick_table = reinterpret_cast<const float*>(file.data() + sizeof(header));
+   samples = reinterpret_cast<const uint8_t*>(file.data() + sizeof(header) + table_bytes);
+   return true;
+}
+
+bool sdf_volume::valid_file()
+{
+   if (file.size() < sizeof(header))
+      return false;
+   memcpy(&header, file.data(), sizeof(header));
+   if (memcmp(header.magic, volume_magic, 4) || header.version != volume_version
+       || (header.bits != 8 && header.bits != 16))
+      return false;
+   // The counts come from the file, so they are multiplied in 64 bits and
+   // must leave brick_count() and the slot arithmetic within an int.
+   uint64_t count = 1;
+   for (int axis = 0; axis < 3; ++axis)
+   {
+      if (!header.bricks[axis] || !std::isfinite(header.lo[axis]))
+         return false;
+      count *= header.bricks[axis];
+      if (count > uint64_t(INT_MAX) / 2)
+         return false;
+   }
+   if (header.stored_bricks > count || !(header.voxel_size > 0.0f) || !std::isfinite(header.voxel_size)
+       || !(header.band > 0.0f) || !std::isfinite(header.band))
+      return false;
+   const uint64_t table_bytes = count * 2 * sizeof(float);
+   if (uint64_t(file.size()) != sizeof(header) + table_bytes + uint64_t(sample_bytes()))
+      return false;
+   // Every stored brick must have its samples in the file.
+   const float* table = reinterpret_cast<const float*>(file.data() + sizeof(header));
+   for (uint64_t i = 0; i < count; ++i)
+   {
+      const float slot = table[2 * i];
+      const bool stored = slot >= 0.0f && slot < float(header.stored_bricks) && slot == floorf(slot);
+      if ((slot != -1.0f && !stored) || !std::isfinite(table[2 * i + 1]))
+         return false;
+   }
+   return true;
+}
+
+aabb sdf_volume::bounds() const
+{
+   aabb b;
+   const vec3 lo(header.lo[0], header.lo[1], header.lo[2]);
+   b.grow(lo);
+   b.grow(lo + vec3(float(header.bricks[0]), float(header.bricks[1]), float(header.bricks[2])) * (header.voxel_size * brick_voxels));
+   return b;
+}
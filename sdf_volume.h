@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "sdf_math.h"
+#include "shader_source.h"
+
+class sdf_scene;
+
+// A distance field sampled on a grid of 8x8x8 voxel bricks. Only bricks that
+// may contain the surface store samples (9 per axis so neighbouring bricks
+// share their faces and each brick filters on its own). Every other brick
+// stores a single conservative distance: how far the surface is at least.
+//
+// File layout: sdf_volume_header, then two floats per brick (sample slot or
+// -1, constant distance), then the samples of each stored brick as unsigned
+// normalised 8 or 16 bit values mapping [0, max] to [-band, band].
+struct sdf_volume_header
+{
+   char magic[4];
+   uint32_t version;
+   uint32_t bits;
+   uint32_t bricks[3];
+   uint32_t stored_bricks;
+   float lo[3];
+   float voxel_size;
+   float band;
+};
+
+struct sdf_volume_settings
+{
+   aabb bounds;
+   int resolution = 128; // voxels along the longest axis
+   int bits = 8;
+};
+
+class sdf_volume
+{
+public:
+   static const int brick_voxels = 8;
+   static const int brick_samples = brick_voxels + 1;
+   static const int samples_per_brick = brick_samples * brick_samples * brick_samples;
+
+   sdf_volume_header header = {};
+   const float* brick_table = nullptr;
+   const uint8_t* samples = nullptr;
+
+   // Sample scene on all cores. Replaces any loaded file. Returns false,
+   // keeping the current contents, if the bounds are empty or inverted.
+   bool bake(const sdf_scene& scene, const sdf_volume_settings& settings);
+
+   // Write to a temporary file renamed over filename, so mappings of the old
+   // file stay valid.
+   bool save(const char* filename) const;
+   // Map filename and point into it, no copies are made. Returns false if
+   // the file is not a complete, consistent volume.
+   bool load(const char* filename);
+
+   bool empty() const { return !brick_table; }
+   int brick_count() const { return int(header.bricks[0] * header.bricks[1] * header.bricks[2]); }
+   size_t sample_bytes() const { return size_t(header.stored_bricks) * samples_per_brick * (header.bits / 8); }
+   aabb bounds() const;
+
+private:
+   // Read the header of the mapped file and check it and the brick table
+   // against each other and the file size.
+   bool valid_file();
+
+   // Backing storage of a fresh bake, or the mapping of a loaded file.
+   std::vector<float> baked_table;
+   std::vector<uint8_t> baked_samples;
+   mapped_file file;
+};
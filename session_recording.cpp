@@ -0,0 +1,47 @@
+#include "session_recording.h"
+
+#include <algorithm>
+
+void session_recorder::update(const recording_request& request)
+{
+   if (request.session == session)
+      return;
+   session = request.session;
+   log.close();
+   if (!request.path.empty())
+      log.open(request.path.c_str());
+}
+
+void session_recorder::close()
+{
+   log.close();
+}
+
+recording_status session_recorder::status() const
+{
+   recording_status out;
+   out.session = session;
+   out.open = log.is_open();
+   out.frames = log.frames();
+   return out;
+}
+
+void session_recorder::write(const frame_values& values, uint64_t program_key, int interleave_cells,
+                             int cone_prepass_scale, float history_blend)
+{
+   recorded_frame frame;
+   frame.time = values.time;
+   frame.width = values.width;
+   frame.height = values.height;
+   frame.mouse_x = float(values.mouse_x);
+   frame.mouse_y = float(values.mouse_y);
+   frame.shininess = values.shininess;
+   std::copy(values.object_color, values.object_color + 4, frame.object_color);
+   std::copy(values.drag, values.drag + 4, frame.drag);
+   frame.repeat = values.repeat;
+   frame.program_key = program_key;
+   frame.interleave_cells = interleave_cells;
+   frame.cone_prepass_scale = cone_prepass_scale;
+   frame.history_blend = history_blend;
+   log.write(frame);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "frame_values.h"
+#include "input_log.h"
+
+// The input log the UI thread asks the render thread to record to.
+struct recording_request
+{
+   // File to record to, empty for none.
+   std::string path;
+   // Counts every start and stop.
+   unsigned session = 0;
+
+   void start(const char* file)
+   {
+      path = file;
+      ++session;
+   }
+   void stop()
+   {
+      path.clear();
+      ++session;
+   }
+};
+
+// What the render thread recorded so far.
+struct recording_status
+{
+   // recording_request::session the file was opened for, and whether it is
+   // open.
+   unsigned session = 0;
+   bool open = false;
+   size_t frames = 0;
+};
+
+// Writes the inputs of every frame the render thread draws to the requested
+// input log, for --replay.
+class session_recorder
+{
+public:
+   // Open or close the log if request changed since the last call.
+   void update(const recording_request& request);
+   void close();
+   bool is_open() const { return log.is_open(); }
+   recording_status status() const;
+
+   // Record a frame drawn with values, the raymarcher variant program_key
+   // and the mode parameters it does not cover.
+   void write(const frame_values& values, uint64_t program_key, int interleave_cells, int cone_prepass_scale,
+              float history_blend);
+
+private:
+   input_log_writer log;
+   unsigned session = 0;
+};
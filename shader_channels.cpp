@@ -0,0 +1,68 @@
+#include "shader_channels.h"
+
+#include <vector>
+
+#include "quad_program.h"
+#include "retire_queue.h"
+
+void channel_bindings::bind() const
+{
+   for (int i = 0; i < texture_cache::channel_count; ++i)
+   {
+      glActiveTexture(GL_TEXTURE0 + first_channel_unit + i);
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
+   }
+   glActiveTexture(GL_TEXTURE0);
+   set_channel_resolution(resolution);
+}
+
+void shader_channels::init()
+{
+   images.init();
+}
+
+void shader_channels::destroy()
+{
+   video->close();
+   images.destroy();
+}
+
+void shader_channels::update(double time)
+{
+   images.update();
+   const std::vector<GLuint> evicted = images.take_evicted();
+   if (!evicted.empty())
+      retire([evicted] { glDeleteTextures(GLsizei(evicted.size()), evicted.data()); });
+   video->update(time);
+}
+
+void shader_channels::close_video()
+{
+   if (!video->is_open())
+      return;
+   const std::shared_ptr<video_channel> closed = video;
+   video = std::make_shared<video_channel>();
+   video->channel = closed->channel;
+   video->sync = closed->sync;
+   retire([closed] { closed->close(); });
+}
+
+void shader_channels::take(channel_bindings& out)
+{
+   for (int i = 0; i < texture_cache::channel_count; ++i)
+   {
+      int width, height;
+      images.channel_size(i, width, height);
+      const bool shown = images.channel_state(i) == texture_cache::state::resident;
+      out.textures[i] = images.texture(i);
+      out.resolution[i][0] = shown ? float(width) : 0.0f;
+      out.resolution[i][1] = shown ? float(height) : 0.0f;
+      out.resolution[i][2] = 1.0f;
+   }
+   if (video->texture())
+   {
+      out.textures[video->channel] = video->texture();
+      out.resolution[video->channel][0] = float(video->info().width);
+      out.resolution[video->channel][1] = float(video->info().height);
+   }
+}
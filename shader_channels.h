@@ -0,0 +1,42 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <memory>
+
+#include "texture_channels.h"
+#include "video_channel.h"
+
+// iChannel textures and their sizes as a frame samples them.
+struct channel_bindings
+{
+   GLuint textures[texture_cache::channel_count] = {};
+   float resolution[texture_cache::channel_count][3] = {};
+
+   // Bind the textures to their channel units and set iChannelResolution for
+   // the frame.
+   void bind() const;
+};
+
+// Images sampled by shaders as iChannel0 to iChannel3, and a video shown on
+// one of them instead of its image. Used by the UI thread.
+class shader_channels
+{
+public:
+   texture_cache images;
+   // Replaced by a new one when it is closed, as frames already published
+   // may still show it.
+   std::shared_ptr<video_channel> video = std::make_shared<video_channel>();
+
+   void init();
+   void destroy();
+
+   // Upload what finished decoding and retire the textures evicted for it,
+   // and show the video frame due at time. Called once a frame.
+   void update(double time);
+   // Close the video, keeping its textures until the render thread is done
+   // with them.
+   void close_video();
+   // Copy the textures shown into out.
+   void take(channel_bindings& out);
+};
@@ -0,0 +1,293 @@
+#include "shader_corpus.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "shader_source.h"
+#include "shadertoy.h"
+
+namespace {
+   typedef std::chrono::steady_clock clock_type;
+
+   double elapsed_ms(clock_type::time_point start)
+   {
+      return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+   }
+
+   // First non-empty line of an info log, enough to tell failures apart in
+   // a table.
+   std::string first_line(const std::vector<GLchar>& log)
+   {
+      const char* p = log.data();
+      while (*p == '\n' || *p == '\r' || *p == ' ')
+         ++p;
+      const char* end = p + strcspn(p, "\r\n");
+      return end > p ? std::string(p, end) : std::string("no log");
+   }
+
+   // Compile and wait for the status. On failure returns 0 with the first
+   // line of the log in error.
+   GLuint compile(GLenum type, const shader_source_list& sources, std::string& error)
+   {
+      GLuint shader = glCreateShader(type);
+      glShaderSource(shader, sources.count(), sources.strings.data(), sources.lengths.data());
+      glCompileShader(shader);
+      GLint success = GL_FALSE;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+      if (success == GL_FALSE)
+      {
+         GLint lsize = 0;
+         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &lsize);
+         std::vector<GLchar> log(lsize + 1);
+         glGetShaderInfoLog(shader, lsize, &lsize, log.data());
+         error = first_line(log);
+         glDeleteShader(shader);
+         return 0;
+      }
+      return shader;
+   }
+
+   GLint location(GLuint program, const char* name) { return glGetUniformLocation(program, name); }
+
+   GLenum uniform_type(GLuint program, const char* name)
+   {
+      GLuint index = GL_INVALID_INDEX;
+      glGetUniformIndices(program, 1, &name, &index);
+      if (index == GL_INVALID_INDEX)
+         return 0;
+      GLint type = 0;
+      glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_TYPE, &type);
+      return GLenum(type);
+   }
+
+   // Uniforms of the frame. Inputs the app takes from the user get fixed
+   // values, so every run draws the same frames.
+   struct corpus_uniforms
+   {
+      GLint time;
+      GLint frame;
+      GLint resolution;
+      bool resolution_vec3;
+
+      void init(GLuint program)
+      {
+         time = location(program, "iTime");
+         if (time < 0)
+            time = location(program, "iElapsedTime");
+         frame = location(program, "iFrame");
+         resolution = location(program, "iResolution");
+         resolution_vec3 = uniform_type(program, "iResolution") == GL_FLOAT_VEC3;
+         glUseProgram(program);
+         glUniform1f(location(program, "iTimeDelta"), 1.0f / 60.0f);
+         glUniform1f(location(program, "iFrameRate"), 60.0f);
+         glUniform1f(location(program, "iSampleRate"), 44100.0f);
+         glUniform1f(location(program, "iShininess"), 10.0f);
+         glUniform4f(location(program, "iColor"), 0.45f, 0.55f, 0.60f, 1.00f);
+         for (int i = 0; i < 4; ++i)
+         {
+            const std::string name = "iChannel" + std::to_string(i);
+            glUniform1i(location(program, name.c_str()), i);
+         }
+      }
+
+      void set(int index, int width, int height) const
+      {
+         // Frames of a 60 Hz clock, so animated shaders move.
+         glUniform1f(time, float(index) / 60.0f);
+         glUniform1i(frame, index);
+         if (resolution_vec3)
+            glUniform3f(resolution, float(width), float(height), 1.0f);
+         else
+            glUniform2f(resolution, float(width), float(height));
+      }
+   };
+}
+
+bool parse_resolutions(const char* text, std::vector<corpus_resolution>& out)
+{
+   out.clear();
+   const char* p = text;
+   while (*p)
+   {
+      char* end;
+      corpus_resolution r;
+      r.width = int(strtol(p, &end, 10));
+      if (end == p || *end != 'x')
+         return false;
+      p = end + 1;
+      r.height = int(strtol(p, &end, 10));
+      if (end == p || r.width <= 0 || r.height <= 0 || (*end && *end != ','))
+         return false;
+      out.push_back(r);
+      p = *end ? end + 1 : end;
+   }
+   return !out.empty();
+}
+
+void corpus_runner::init(const std::string& vertex_source)
+{
+   destroy();
+   shader_source_list sources;
+   sources.add(vertex_source.data(), vertex_source.size());
+   std::string error;
+   vertex_shader = compile(GL_VERTEX_SHADER, sources, error);
+   if (!vertex_shader)
+      fprintf(stderr, "Failed to compile the corpus vertex shader: %s\n", error.c_str());
+   glGenVertexArrays(1, &vao);
+   target.init({ GL_RGBA8 });
+   timer.init(frames);
+}
+
+void corpus_runner::destroy()
+{
+   glDeleteShader(vertex_shader);
+   vertex_shader = 0;
+   if (vao)
+      glDeleteVertexArrays(1, &vao);
+   vao = 0;
+   target.destroy();
+   timer.destroy();
+}
+
+GLuint corpus_runner::build(const std::string& path, corpus_result& result)
+{
+   result.path = path;
+   if (!vertex_shader)
+   {
+      result.failure = "vertex shader failed";
+      return 0;
+   }
+   mapped_file file;
+   if (!file.map(path.c_str()))
+   {
+      result.failure = "cannot be read";
+      return 0;
+   }
+   source_arena arena;
+   shader_source_list sources;
+   if (is_shadertoy_source(file.data(), file.size()))
+      assemble_shader(sources, arena, file, shadertoy_prelude, shadertoy_trailer);
+   else
+      assemble_shader(sources, arena, file, nullptr, nullptr);
+
+   std::string error;
+   auto start = clock_type::now();
+   const GLuint fragment_shader = compile(GL_FRAGMENT_SHADER, sources, error);
+   result.compile_ms = elapsed_ms(start);
+   if (!fragment_shader)
+   {
+      result.failure = "compile: " + error;
+      return 0;
+   }
+   const GLuint program = glCreateProgram();
+   glAttachShader(program, vertex_shader);
+   glAttachShader(program, fragment_shader);
+   glBindFragDataLocation(program, 0, "outColor");
+   start = clock_type::now();
+   glLinkProgram(program);
+   GLint success = GL_FALSE;
+   glGetProgramiv(program, GL_LINK_STATUS, &success);
+   result.link_ms = elapsed_ms(start);
+   glDetachShader(program, vertex_shader);
+   glDeleteShader(fragment_shader);
+   if (success == GL_FALSE)
+   {
+      GLint lsize = 0;
+      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &lsize);
+      std::vector<GLchar> log(lsize + 1);
+      glGetProgramInfoLog(program, lsize, &lsize, log.data());
+      result.failure = "link: " + first_line(log);
+      glDeleteProgram(program);
+      return 0;
+   }
+   return program;
+}
+
+void corpus_runner::time(GLuint program, corpus_result& result)
+{
+   corpus_uniforms uniforms;
+   uniforms.init(program);
+   glBindVertexArray(vao);
+   // Drain errors of earlier shaders, so the ones below are this one's.
+   while (glGetError() != GL_NO_ERROR)
+      ;
+   for (const corpus_resolution& resolution : resolutions)
+   {
+      target.resize(resolution.width, resolution.height);
+      target.bind();
+
+      // The first frame also absorbs lazy compilation in the driver.
+      uniforms.set(0, resolution.width, resolution.height);
+      const auto start = clock_type::now();
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      glFinish();
+      const double first_ms = elapsed_ms(start);
+      if (first_ms > frame_limit_ms)
+      {
+         char reason[96];
+         snprintf(reason, sizeof(reason), "too slow: first frame %.0f ms at %dx%d", first_ms, resolution.width,
+                  resolution.height);
+         result.failure = reason;
+         break;
+      }
+
+      for (int i = 0; i < frames; ++i)
+      {
+         uniforms.set(i + 1, resolution.width, resolution.height);
+         timer.begin();
+         glDrawArrays(GL_TRIANGLES, 0, 3);
+         timer.end();
+      }
+      const std::vector<double> ms = timer.collect();
+      corpus_timing timing;
+      timing.p50 = percentile(ms, 0.5);
+      timing.p90 = percentile(ms, 0.9);
+      timing.p99 = percentile(ms, 0.99);
+      timing.frames = int(ms.size());
+      result.timings.push_back(timing);
+
+      const GLenum gl_error = glGetError();
+      if (gl_error != GL_NO_ERROR)
+      {
+         char reason[48];
+         snprintf(reason, sizeof(reason), "GL error 0x%04x", gl_error);
+         result.failure = reason;
+         break;
+      }
+   }
+   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+   glUseProgram(0);
+   glDeleteProgram(program);
+}
+
+void print_corpus(FILE* out, const std::vector<corpus_result>& results,
+                  const std::vector<corpus_resolution>& resolutions, int frames)
+{
+   size_t failed = 0;
+   for (const corpus_result& r : results)
+      failed += !r.failure.empty();
+   fprintf(out, "%zu shaders, %zu failed, %d frames per resolution, GPU ms per frame as p50/p90/p99\n",
+           results.size(), failed, frames);
+   fprintf(out, "%-32s %10s %10s", "shader", "compile ms", "link ms");
+   for (const corpus_resolution& resolution : resolutions)
+   {
+      char label[32];
+      snprintf(label, sizeof(label), "%dx%d", resolution.width, resolution.height);
+      fprintf(out, " %26s", label);
+   }
+   fprintf(out, "  %s\n", "status");
+   for (const corpus_result& r : results)
+   {
+      fprintf(out, "%-32s %10.2f %10.2f", r.path.c_str(), r.compile_ms, r.link_ms);
+      for (size_t i = 0; i < resolutions.size(); ++i)
+      {
+         if (i < r.timings.size())
+            fprintf(out, " %8.3f/%8.3f/%8.3f", r.timings[i].p50, r.timings[i].p90, r.timings[i].p99);
+         else
+            fprintf(out, " %26s", "-");
+      }
+      fprintf(out, "  %s\n", r.failure.empty() ? "ok" : r.failure.c_str());
+   }
+}
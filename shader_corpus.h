@@ -0,0 +1,83 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "render_target.h"
+
+struct corpus_resolution
+{
+   int width = 0;
+   int height = 0;
+};
+
+// Parse a list like "640x360,1280x720". Returns false if text is malformed.
+bool parse_resolutions(const char* text, std::vector<corpus_resolution>& out);
+
+// GPU milliseconds per frame at one resolution.
+struct corpus_timing
+{
+   double p50 = 0.0;
+   double p90 = 0.0;
+   double p99 = 0.0;
+   int frames = 0;
+};
+
+struct corpus_result
+{
+   std::string path;
+   // Wall time until the driver reported the compile and the link status,
+   // alongside whatever other builds ran at the same time.
+   double compile_ms = 0.0;
+   double link_ms = 0.0;
+   // One per resolution, up to the one a failure stopped at.
+   std::vector<corpus_timing> timings;
+   // Empty if the shader ran at every resolution.
+   std::string failure;
+};
+
+// Compiles and times corpus shaders in the GL context current on the calling
+// thread. Runners on other threads with contexts of their own can build in
+// parallel, but timing has to be done in one context at a time: the GPU
+// slices its time between contexts, and GL_TIME_ELAPSED of one then counts
+// the work of the others.
+class corpus_runner
+{
+public:
+   std::vector<corpus_resolution> resolutions;
+   int frames = 100;
+   // A first frame taking longer stops the shader as too slow, so one
+   // pathological shader does not hold up a whole corpus.
+   double frame_limit_ms = 2000.0;
+
+   corpus_runner() = default;
+   corpus_runner(const corpus_runner&) = delete;
+   corpus_runner& operator=(const corpus_runner&) = delete;
+
+   // vertex_source is the quad vertex shader every program is linked with.
+   // Takes frames as set at this point.
+   void init(const std::string& vertex_source);
+   void destroy();
+
+   // Build the fragment shader at path, wrapping Shadertoy sources, into
+   // result. Returns the linked program, or 0 with result.failure set.
+   GLuint build(const std::string& path, corpus_result& result);
+   // Draw program, which may come from a context shared with this one, the
+   // configured frames at each resolution into result.timings. Deletes
+   // program.
+   void time(GLuint program, corpus_result& result);
+
+private:
+   GLuint vertex_shader = 0;
+   GLuint vao = 0;
+   render_target target;
+   gpu_timer timer;
+};
+
+void print_corpus(FILE* out, const std::vector<corpus_result>& results,
+                  const std::vector<corpus_resolution>& resolutions, int frames);
@@ -0,0 +1,147 @@
+#include "shader_diagnostics.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+   // Number of source lines shown before and after the reported one.
+   const int snippet_context = 2;
+
+   bool starts_with_nocase(const char* text, const char* prefix)
+   {
+      for (; *prefix; ++text, ++prefix)
+      {
+         if (tolower((unsigned char)*text) != *prefix)
+            return false;
+      }
+      return true;
+   }
+
+   // Finds the first "<source>:<line>" or "<source>(<line>)" in text.
+   // Returns the position just past it, or null.
+   const char* find_location(const char* text, int& source, int& line)
+   {
+      for (const char* p = text; *p; ++p)
+      {
+         if (!isdigit((unsigned char)*p) || (p > text && isalnum((unsigned char)p[-1])))
+            continue;
+         char* end;
+         const long s = strtol(p, &end, 10);
+         if (*end != ':' && *end != '(')
+            continue;
+         const char open = *end;
+         if (!isdigit((unsigned char)end[1]))
+            continue;
+         const long l = strtol(end + 1, &end, 10);
+         if (open == '(' && *end++ != ')')
+            continue;
+         source = int(s);
+         line = int(l);
+         return end;
+      }
+      return nullptr;
+   }
+
+   // The message without separators, severity and vendor error codes.
+   std::string clean_message(const char* text)
+   {
+      auto skip_separators = [&text] {
+         while (*text == ' ' || *text == ':' || *text == '\t' || *text == '(' || *text == ')' || isdigit((unsigned char)*text))
+            ++text;
+      };
+      skip_separators();
+      for (const char* word : { "error", "warning" })
+      {
+         if (starts_with_nocase(text, word))
+         {
+            text += strlen(word);
+            // NVIDIA follows the severity with a code such as C1008.
+            const char* code = text;
+            while (*code == ' ')
+               ++code;
+            const char* after = code;
+            while (isalnum((unsigned char)*after))
+               ++after;
+            if (*after == ':' && isalpha((unsigned char)*code))
+               text = after;
+            break;
+         }
+      }
+      while (*text == ' ' || *text == ':')
+         ++text;
+      std::string message(text);
+      while (!message.empty() && isspace((unsigned char)message.back()))
+         message.pop_back();
+      return message;
+   }
+
+   void add_snippet(shader_diagnostic& d, const char* text, size_t len)
+   {
+      d.snippet_line = std::max(1, d.line - snippet_context);
+      int line = 1;
+      const char* end = text + len;
+      for (const char* p = text; p < end && line <= d.line + snippet_context; ++line)
+      {
+         const char* eol = static_cast<const char*>(memchr(p, '\n', size_t(end - p)));
+         if (!eol)
+            eol = end;
+         if (line >= d.snippet_line)
+            d.snippet.emplace_back(p, eol);
+         p = eol + 1;
+      }
+   }
+}
+
+void parse_info_log(const char* log, const shader_source_map* map, std::vector<shader_diagnostic>& out)
+{
+   if (!log)
+      return;
+   shader_diagnostic* previous = nullptr;
+   for (const char* line = log; *line;)
+   {
+      const char* eol = strchr(line, '\n');
+      const std::string text = eol ? std::string(line, eol) : std::string(line);
+      line = eol ? eol + 1 : line + text.size();
+      if (text.find_first_not_of(" \t\r") == std::string::npos)
+         continue;
+
+      std::string lower(text);
+      std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return char(tolower(c)); });
+      const bool is_error = lower.find("error") != std::string::npos;
+      const bool is_warning = lower.find("warning") != std::string::npos;
+      if (!is_error && !is_warning)
+      {
+         if (previous)
+            previous->message += "\n" + text;
+         continue;
+      }
+
+      shader_diagnostic d;
+      d.error = is_error;
+      int source = 0;
+      const char* rest = find_location(text.c_str(), source, d.line);
+      if (rest)
+      {
+         const bool known = map && source >= 0 && source < source_id_count && map->names[source];
+         d.file = known ? map->names[source] : "string " + std::to_string(source);
+         if (known && map->texts[source])
+            add_snippet(d, map->texts[source], map->lengths[source]);
+         d.message = clean_message(rest);
+      }
+      else
+      {
+         d.line = 0;
+         d.message = clean_message(text.c_str());
+      }
+
+      if (std::find(out.begin(), out.end(), d) != out.end())
+      {
+         previous = nullptr;
+         continue;
+      }
+      out.push_back(std::move(d));
+      previous = &out.back();
+   }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "shader_source.h"
+
+// Name and text of each piece of an assembled shader, indexed by
+// shader_source_id. Missing pieces have a null text.
+struct shader_source_map
+{
+   const char* names[source_id_count] = {};
+   const char* texts[source_id_count] = {};
+   size_t lengths[source_id_count] = {};
+};
+
+// One message of a compile or link log.
+struct shader_diagnostic
+{
+   std::string file; // empty if the log gave no location
+   int line = 0;
+   bool error = true; // otherwise a warning
+   std::string message;
+   // Source lines around line, the first of which is snippet_line.
+   std::vector<std::string> snippet;
+   int snippet_line = 0;
+
+   bool operator==(const shader_diagnostic& other) const
+   {
+      return file == other.file && line == other.line && message == other.message;
+   }
+};
+
+// Append the messages of an info log to out, skipping ones already there.
+// Locations written as "0(12)" (NVIDIA), "0:12:" (Apple, AMD, Intel, glslang)
+// or "0:12(5):" (Mesa) are resolved through map, which may be null. Lines
+// without a severity continue the previous message.
+void parse_info_log(const char* log, const shader_source_map* map, std::vector<shader_diagnostic>& out);
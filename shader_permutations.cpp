@@ -0,0 +1,69 @@
+#include "shader_permutations.h"
+
+void shader_permutations::add_axis(const char* name, const std::vector<std::pair<const char*, const char*>>& options)
+{
+   define_axis axis;
+   axis.name = name;
+   for (const auto& option : options)
+   {
+      axis.labels.push_back(option.first);
+      axis.defines.push_back(option.second);
+   }
+   axes.push_back(std::move(axis));
+}
+
+uint64_t shader_permutations::count() const
+{
+   uint64_t total = 1;
+   for (const define_axis& axis : axes)
+      total *= axis.labels.size();
+   return total;
+}
+
+// Mixed radix number with the first axis as the lowest digit.
+uint64_t shader_permutations::key() const
+{
+   uint64_t key = 0;
+   uint64_t scale = 1;
+   for (const define_axis& axis : axes)
+   {
+      key += axis.selected * scale;
+      scale *= axis.labels.size();
+   }
+   return key;
+}
+
+void shader_permutations::select(uint64_t key)
+{
+   for (define_axis& axis : axes)
+   {
+      axis.selected = int(key % axis.labels.size());
+      key /= axis.labels.size();
+   }
+}
+
+std::string shader_permutations::defines() const
+{
+   std::string text;
+   for (const define_axis& axis : axes)
+   {
+      const std::string& define = axis.defines[axis.selected];
+      if (!define.empty())
+         text += define + "\n";
+   }
+   return text;
+}
+
+std::string shader_permutations::description() const
+{
+   std::string text;
+   for (const define_axis& axis : axes)
+   {
+      if (axis.selected == 0)
+         continue;
+      if (!text.empty())
+         text += ", ";
+      text += axis.name + " " + axis.labels[axis.selected];
+   }
+   return text;
+}
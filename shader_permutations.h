@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// A compile-time switch of a shader. Each option is a label for the UI and
+// the text injected after #version when it is selected; an empty text keeps
+// the shader's own default.
+struct define_axis
+{
+   std::string name;
+   std::vector<std::string> labels;
+   std::vector<std::string> defines;
+   int selected = 0;
+};
+
+// Set of define axes. Every combination of options is one permutation of the
+// shader, numbered by key() so compiled variants can be cached by it.
+class shader_permutations
+{
+public:
+   std::vector<define_axis> axes;
+
+   // Options are (label, define text) pairs. The first one starts selected.
+   void add_axis(const char* name, const std::vector<std::pair<const char*, const char*>>& options);
+
+   // Number of permutations.
+   uint64_t count() const;
+   // Index of the selected permutation, below count().
+   uint64_t key() const;
+   // Select the permutation with index key.
+   void select(uint64_t key);
+
+   // Defines of the selected options, one per line.
+   std::string defines() const;
+   // Selected options that differ from the first one, e.g. "Steps 64".
+   std::string description() const;
+};
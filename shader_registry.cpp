@@ -0,0 +1,148 @@
+#include "shader_registry.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "opengl_util.h"
+#include "shader_source.h"
+#include "shadertoy.h"
+
+bool is_raymarcher(const registered_shader& shader)
+{
+   return shader.path == fragment_shader_path;
+}
+
+const char* shader_name(const registered_shader& shader)
+{
+   const size_t slash = shader.path.rfind('/');
+   return shader.path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+// Compile the fragment shader of shader. Shadertoy sources, which only
+// define mainImage(), get the declarations and main() they expect.
+static GLuint compile_registered(const registered_shader& shader)
+{
+   const std::shared_ptr<const mapped_file> file = map_shader_file(shader.path.c_str());
+   if (file && is_shadertoy_source(file->data(), file->size()))
+      return compile_shader_from_file(GL_FRAGMENT_SHADER, shader.path.c_str(), shadertoy_prelude, shadertoy_trailer);
+   return compile_shader_from_file(GL_FRAGMENT_SHADER, shader.path.c_str());
+}
+
+// Build shader in the foreground, replacing its program on success.
+static void build_registered(registered_shader& shader)
+{
+   shader.stale = false;
+   shader.failed = !link_quad_program(shader.built.program, compile_registered(shader));
+   if (!shader.failed)
+      get_frame_uniforms(shader.built);
+}
+
+static void start_registered_build(registered_shader& shader)
+{
+   shader.stale = false;
+   defer_compile_status = true;
+   shader.linking = start_quad_link(compile_registered(shader));
+   defer_compile_status = false;
+   shader.failed = !shader.linking;
+}
+
+// Take over the program started by start_registered_build(), waiting for it
+// if needed.
+static void finish_registered_build(registered_shader& shader)
+{
+   const GLuint linked = shader.linking;
+   shader.linking = 0;
+   GLint success = GL_FALSE;
+   glGetProgramiv(linked, GL_LINK_STATUS, &success);
+   if (success == GL_FALSE)
+   {
+      // The compile logs were never read; build again to report them.
+      glDeleteProgram(linked);
+      build_registered(shader);
+      return;
+   }
+   shader.failed = !finish_quad_link(shader.built.program, linked);
+   if (!shader.failed)
+      get_frame_uniforms(shader.built);
+}
+
+void shader_registry::destroy()
+{
+   for (const registered_shader& shader : shaders)
+   {
+      glDeleteProgram(shader.built.program);
+      glDeleteProgram(shader.linking);
+   }
+   shaders.clear();
+}
+
+void shader_registry::discover()
+{
+   for (const std::string& path : list_shader_files(shader_directory))
+   {
+      if (path == vertex_shader_path || path == interleave_shader_path)
+         continue;
+      auto found = std::find_if(shaders.begin(), shaders.end(),
+                                [&path](const registered_shader& shader) { return shader.path == path; });
+      if (found == shaders.end())
+         shaders.push_back({ path, {}, 0, true, false });
+   }
+}
+
+void shader_registry::reload()
+{
+   discover();
+   for (registered_shader& shader : shaders)
+   {
+      glDeleteProgram(shader.linking);
+      shader.linking = 0;
+      shader.stale = !is_raymarcher(shader);
+      shader.failed = false;
+   }
+}
+
+void shader_registry::update()
+{
+   bool built_one = false;
+   for (registered_shader& shader : shaders)
+   {
+      if (is_raymarcher(shader))
+         continue;
+      if (shader.linking)
+      {
+         GLint done = GL_FALSE;
+         glGetProgramiv(shader.linking, GL_COMPLETION_STATUS_KHR, &done);
+         if (done)
+            finish_registered_build(shader);
+      }
+      else if (shader.stale && parallel_compile)
+         start_registered_build(shader);
+      else if (shader.stale && !built_one)
+      {
+         build_registered(shader);
+         built_one = true;
+      }
+   }
+}
+
+void shader_registry::select(size_t index)
+{
+   registered_shader& shader = shaders[index];
+   if (shader.linking)
+      finish_registered_build(shader);
+   else if (shader.stale)
+      build_registered(shader);
+   active = index;
+}
+
+size_t shader_registry::find(const char* name) const
+{
+   for (size_t i = 0; i < shaders.size(); ++i)
+   {
+      const registered_shader& shader = shaders[i];
+      const std::string file = shader_name(shader);
+      if (shader.path == name || file == name || file == std::string(name) + ".glsl")
+         return i;
+   }
+   return shaders.size();
+}
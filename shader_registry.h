@@ -0,0 +1,61 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "quad_program.h"
+
+// A fragment shader of shader_directory drawn over the quad. The one at
+// fragment_shader_path is the raymarcher, built and drawn by its own
+// pipeline; the others are drawn on their own with the frame uniforms.
+struct registered_shader
+{
+   std::string path;
+   // Last program that built, kept while a newer one builds.
+   quad_program built;
+   // Program whose link was started but not yet checked.
+   GLuint linking;
+   // The sources changed since built was linked.
+   bool stale;
+   // The last build failed. Not retried until the next reload.
+   bool failed;
+};
+
+bool is_raymarcher(const registered_shader& shader);
+// File name of shader, without the directory.
+const char* shader_name(const registered_shader& shader);
+
+// The fragment shaders of shader_directory and the one shown. Used by the UI
+// thread; discover() may also run before the context is created.
+class shader_registry
+{
+public:
+   std::vector<registered_shader> shaders;
+   size_t active = 0;
+   // Start every stale build at once and let the driver's threads finish
+   // them (GL_KHR_parallel_shader_compile). Otherwise one is built per frame.
+   bool parallel_compile = false;
+
+   void destroy();
+
+   const registered_shader& shown() const { return shaders[active]; }
+
+   // Add the fragment shaders in shader_directory that are not registered
+   // yet. Passes that only work within the raymarcher's pipeline are left
+   // out.
+   void discover();
+   // Discover new shaders and rebuild all but the raymarcher in the
+   // background while their old programs are drawn.
+   void reload();
+   // Start builds of stale shaders and take over finished ones. Called once
+   // a frame, never waits for the driver with parallel_compile.
+   void update();
+   // Show shaders[index] from the next frame on, building it now if it is
+   // not ready.
+   void select(size_t index);
+   // Index of the shader at path or with that file name, with or without
+   // extension. Returns shaders.size() if there is none.
+   size_t find(const char* name) const;
+};
@@ -0,0 +1,259 @@
+#include "shader_source.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+
+static const timespec& stat_mtime(const struct stat& st)
+{
+#ifdef __APPLE__
+   return st.st_mtimespec;
+#else
+   return st.st_mtim;
+#endif
+}
+
+mapped_file::~mapped_file()
+{
+   unmap();
+}
+
+bool mapped_file::same_file(const struct stat& st) const
+{
+   const timespec& modified = stat_mtime(st);
+   return !missing && st.st_dev == device && st.st_ino == inode && st.st_size == file_size
+          && modified.tv_sec == mtime.tv_sec && modified.tv_nsec == mtime.tv_nsec;
+}
+
+bool mapped_file::map(const char* filename)
+{
+   struct stat st;
+   if (stat(filename, &st) != 0)
+   {
+      fprintf(stderr, "Failed to open %s\n", filename);
+      unmap();
+      missing = true;
+      return false;
+   }
+   if (ptr && same_file(st))
+      return true;
+
+   // Remember the file even if it cannot be mapped, so it only counts as
+   // changed once it is written again.
+   unmap();
+   missing = false;
+   file_size = st.st_size;
+   device = st.st_dev;
+   inode = st.st_ino;
+   mtime = stat_mtime(st);
+   if (!st.st_size)
+   {
+      fprintf(stderr, "File is empty %s\n", filename);
+      return false;
+   }
+   int fd = open(filename, O_RDONLY);
+   if (fd < 0)
+   {
+      fprintf(stderr, "Failed to open %s\n", filename);
+      return false;
+   }
+   void* mem = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (mem == MAP_FAILED)
+   {
+      fprintf(stderr, "Failed to map %s\n", filename);
+      return false;
+   }
+   madvise(mem, size_t(st.st_size), MADV_WILLNEED);
+   ptr = static_cast<const char*>(mem);
+   length = size_t(st.st_size);
+   return true;
+}
+
+bool mapped_file::changed(const char* filename) const
+{
+   struct stat st;
+   if (stat(filename, &st) != 0)
+      return !missing;
+   return !same_file(st);
+}
+
+void mapped_file::unmap()
+{
+   if (ptr)
+      munmap(const_cast<char*>(ptr), length);
+   ptr = nullptr;
+   length = 0;
+}
+
+char* source_arena::allocate(size_t len)
+{
+   if (len > block_size)
+   {
+      large.emplace_back(new char[len]);
+      return large.back().get();
+   }
+   if (used + len > block_size)
+   {
+      ++block;
+      used = 0;
+   }
+   if (block == blocks.size())
+      blocks.emplace_back(new char[block_size]);
+   char* out = blocks[block].get() + used;
+   used += len;
+   return out;
+}
+
+const char* source_arena::copy(const char* text, size_t len)
+{
+   char* out = allocate(len + 1);
+   memcpy(out, text, len);
+   out[len] = '\0';
+   return out;
+}
+
+const char* source_arena::format(const char* fmt, ...)
+{
+   va_list args;
+   va_start(args, fmt);
+   char small[256];
+   const int len = vsnprintf(small, sizeof(small), fmt, args);
+   va_end(args);
+   if (len < 0)
+      return "";
+   if (size_t(len) < sizeof(small))
+      return copy(small, size_t(len));
+   char* out = allocate(size_t(len) + 1);
+   va_start(args, fmt);
+   vsnprintf(out, size_t(len) + 1, fmt, args);
+   va_end(args);
+   return out;
+}
+
+void source_arena::reset()
+{
+   large.clear();
+   block = 0;
+   used = 0;
+}
+
+size_t version_line_end(const char* src, size_t len)
+{
+   size_t i = 0;
+   while (i < len)
+   {
+      while (i < len && (src[i] == ' ' || src[i] == '\t' || src[i] == '\r' || src[i] == '\n'))
+         ++i;
+      const char* nl = static_cast<const char*>(memchr(src + i, '\n', len - i));
+      const size_t line_end = nl ? size_t(nl - src) + 1 : len;
+      if (len - i >= 8 && !memcmp(src + i, "#version", 8))
+         return line_end;
+      // #version may only be preceded by comments and whitespace.
+      if (len - i >= 2 && src[i] == '/' && src[i + 1] == '/')
+      {
+         i = line_end;
+         continue;
+      }
+      return 0;
+   }
+   return 0;
+}
+
+void assemble_shader(shader_source_list& out, source_arena& arena, const char* src, size_t len,
+                     const char* prelude, const char* trailer)
+{
+   out.clear();
+   const size_t head = version_line_end(src, len);
+   if (head)
+      out.add(src, head);
+   if (prelude)
+   {
+      // A source without #version can take it from the prelude, which then
+      // has to come first.
+      const size_t prelude_head = head ? 0 : version_line_end(prelude, strlen(prelude));
+      if (prelude_head)
+         out.add(prelude, prelude_head);
+      const int next_line = 1 + int(std::count(src, src + head, '\n'));
+      const int prelude_line = 1 + int(std::count(prelude, prelude + prelude_head, '\n'));
+      const char* start = arena.format("#line %d %d\n", prelude_line, source_prelude);
+      out.add(start, strlen(start));
+      out.add(prelude + prelude_head, strlen(prelude + prelude_head));
+      const char* line = arena.format("\n#line %d %d\n", next_line, source_file);
+      out.add(line, strlen(line));
+   }
+   out.add(src + head, len - head);
+   if (trailer)
+   {
+      // The file may not end in a newline.
+      const char* start = arena.format("\n#line 1 %d\n", source_trailer);
+      out.add(start, strlen(start));
+      out.add(trailer, strlen(trailer));
+   }
+}
+
+void assemble_shader(shader_source_list& out, source_arena& arena, const mapped_file& file,
+                     const char* prelude, const char* trailer)
+{
+   assemble_shader(out, arena, file.data(), file.size(), prelude, trailer);
+}
+
+// Mappings of map_shader_file(), by file name.
+static std::mutex shader_files_mutex;
+static std::map<std::string, std::shared_ptr<mapped_file>> shader_files;
+
+std::shared_ptr<const mapped_file> map_shader_file(const char* filename)
+{
+   std::lock_guard<std::mutex> lock(shader_files_mutex);
+   auto found = shader_files.find(filename);
+   if (found != shader_files.end() && !found->second->changed(filename))
+      return found->second->data() ? found->second : nullptr;
+   // Never remap in place, another thread may be reading the old mapping. A
+   // failed mapping is cached too, so the file is not reported as changed
+   // again until it is.
+   auto file = std::make_shared<mapped_file>();
+   const bool mapped = file->map(filename);
+   shader_files[filename] = file;
+   return mapped ? file : nullptr;
+}
+
+bool shader_files_changed()
+{
+   std::lock_guard<std::mutex> lock(shader_files_mutex);
+   for (const auto& entry : shader_files)
+   {
+      if (entry.second->changed(entry.first.c_str()))
+         return true;
+   }
+   return false;
+}
+
+std::vector<std::string> list_shader_files(const char* directory)
+{
+   std::vector<std::string> files;
+   DIR* dir = opendir(directory);
+   if (!dir)
+   {
+      fprintf(stderr, "Failed to open %s\n", directory);
+      return files;
+   }
+   while (const dirent* entry = readdir(dir))
+   {
+      const size_t len = strlen(entry->d_name);
+      if (entry->d_name[0] != '.' && len > 5 && !strcmp(entry->d_name + len - 5, ".glsl"))
+         files.push_back(std::string(directory) + "/" + entry->d_name);
+   }
+   closedir(dir);
+   std::sort(files.begin(), files.end());
+   return files;
+}
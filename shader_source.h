@@ -0,0 +1,122 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read-only memory mapping of a file. Shader sources are handed straight to
+// glShaderSource, so the bytes are not null terminated.
+class mapped_file
+{
+public:
+   mapped_file() = default;
+   ~mapped_file();
+   mapped_file(const mapped_file&) = delete;
+   mapped_file& operator=(const mapped_file&) = delete;
+
+   // Map filename. If it is already mapped and its inode, size and mtime are
+   // unchanged the current mapping is kept. Returns false on error, but still
+   // remembers what the file looked like.
+   bool map(const char* filename);
+   void unmap();
+   // True if filename no longer matches what the last map() saw.
+   bool changed(const char* filename) const;
+
+   const char* data() const { return ptr; }
+   size_t size() const { return length; }
+
+private:
+   bool same_file(const struct stat& st) const;
+
+   const char* ptr = nullptr;
+   size_t length = 0;
+   bool missing = false;
+   off_t file_size = 0;
+   dev_t device = 0;
+   ino_t inode = 0;
+   timespec mtime = {};
+};
+
+// Bump allocator for text produced while assembling a shader, e.g. injected
+// defines. Blocks are reused after reset(), so steady-state reloads do not
+// allocate.
+class source_arena
+{
+public:
+   const char* copy(const char* text, size_t len);
+   const char* format(const char* fmt, ...);
+   void reset();
+
+private:
+   char* allocate(size_t len);
+
+   static const size_t block_size = 4096;
+   std::vector<std::unique_ptr<char[]>> blocks;
+   std::vector<std::unique_ptr<char[]>> large;
+   size_t block = 0;
+   size_t used = 0;
+};
+
+// Pieces of one shader stage, passed to glShaderSource without concatenation.
+struct shader_source_list
+{
+   std::vector<const GLchar*> strings;
+   std::vector<GLint> lengths;
+
+   void add(const char* text, size_t len)
+   {
+      strings.push_back(text);
+      lengths.push_back(GLint(len));
+   }
+   void clear()
+   {
+      strings.clear();
+      lengths.clear();
+   }
+   GLsizei count() const { return GLsizei(strings.size()); }
+};
+
+// Offset just past the #version line, or 0 if the source has none. Text that
+// has to precede everything else but follow #version goes here.
+size_t version_line_end(const char* src, size_t len);
+
+// Source string numbers assemble_shader() gives its pieces with #line, so
+// compile logs can be traced back to them.
+enum shader_source_id
+{
+   source_file = 0,
+   source_prelude = 1,
+   source_trailer = 2,
+   source_id_count = 3,
+};
+
+// Fill out with src split after its #version line, prelude in between and
+// trailer at the end. Either may be null. If src has no #version line the
+// prelude's goes first. Each piece starts with a #line directive, so
+// diagnostics report the line within the piece and its shader_source_id as
+// the source string. Generated text comes from arena.
+void assemble_shader(shader_source_list& out, source_arena& arena, const char* src, size_t len,
+                     const char* prelude, const char* trailer);
+void assemble_shader(shader_source_list& out, source_arena& arena, const mapped_file& file,
+                     const char* prelude, const char* trailer);
+
+// Mapping of filename shared by every compile of that file. Returns null on
+// error, and again until the file changes. A file changed on disk gets a new
+// mapping, and callers still holding
+// the old one keep it alive. The cache may be used from any thread, but the
+// mapping itself is only as stable as the file: one truncated in place while
+// it is read raises SIGBUS. Editors that save through a rename are fine.
+std::shared_ptr<const mapped_file> map_shader_file(const char* filename);
+
+// True if any file mapped through map_shader_file() changed on disk since.
+bool shader_files_changed();
+
+// Paths of the .glsl files in directory, sorted.
+std::vector<std::string> list_shader_files(const char* directory);
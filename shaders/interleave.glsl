@@ -0,0 +1,65 @@
+#version 410 core
+
+out vec4 outColor;
+
+// Number of groups the pixels are split into, 2 (checkerboard) or 4.
+uniform int iInterleaveCells;
+
+// Group of a pixel. Pixels are grouped by whole 2x2 quads: a quad with any
+// covered pixel runs the fragment shader on all four, so a per pixel
+// pattern would save nothing.
+int interleaveCell(ivec2 pixel)
+{
+   ivec2 quad = pixel >> 1;
+   if (iInterleaveCells == 2)
+      return (quad.x + quad.y) & 1;
+   return (quad.x & 1) | ((quad.y & 1) << 1);
+}
+
+#ifdef INTERLEAVE_MASK
+// Drawn once per cell with the stencil reference set to the cell.
+uniform int iInterleaveCell;
+
+void main()
+{
+   if (interleaveCell(ivec2(gl_FragCoord.xy)) != iInterleaveCell)
+      discard;
+   outColor = vec4(0.0);
+}
+#else
+// Shaded colors, alpha holds the generation they were shaded in.
+uniform sampler2D iShaded;
+// Bumped by the app whenever the image changes.
+uniform int iGeneration;
+
+void main()
+{
+   ivec2 pixel = ivec2(gl_FragCoord.xy);
+   vec4 own = texelFetch(iShaded, pixel, 0);
+   if (int(own.a) == iGeneration)
+   {
+      outColor = vec4(own.rgb, 1.0);
+      return;
+   }
+
+   // Shaded before the last change: keep it only within the range of the
+   // same pixel in up to date neighbouring quads.
+   ivec2 last = textureSize(iShaded, 0) - 1;
+   vec3 lo = vec3(1e9);
+   vec3 hi = vec3(-1e9);
+   for (int y = -1; y <= 1; ++y)
+      for (int x = -1; x <= 1; ++x)
+      {
+         vec4 c = texelFetch(iShaded, clamp(pixel + 2 * ivec2(x, y), ivec2(0), last), 0);
+         if (int(c.a) == iGeneration)
+         {
+            lo = min(lo, c.rgb);
+            hi = max(hi, c.rgb);
+         }
+      }
+   if (lo.x > hi.x)
+      outColor = vec4(own.rgb, 1.0);
+   else
+      outColor = vec4(clamp(own.rgb, lo, hi), 1.0);
+}
+#endif
@@ -1,6 +1,14 @@
 #version 410 core
 
+#ifdef COMPUTE_BACKEND
+// Set for each pixel by the tile loop at the end of the file; the app
+// enables the compute, image and atomic counter extensions in the prelude.
+vec4 outColor;
+vec2 fragCoord;
+#else
 out vec4 outColor;
+#define fragCoord gl_FragCoord.xy
+#endif
 
 uniform float iTime;
 uniform vec2 iResolution;
@@ -8,9 +16,22 @@ uniform vec2 iMouse;
 uniform vec4 iColor;
 uniform float iShininess = 10.0;
 
+// Defaults, the application may define these first to trade quality for
+// speed. Compiled to SPIR-V they are specialization constants instead, set
+// when the module is loaded.
+#if defined(GL_SPIRV) && !defined(STEPS)
+layout(constant_id = 0) const int STEPS = 255;
+#elif !defined(STEPS)
 #define STEPS 255
+#endif
+#if defined(GL_SPIRV) && !defined(EPSILON)
+layout(constant_id = 1) const float EPSILON = 0.001;
+#elif !defined(EPSILON)
 #define EPSILON 0.001
+#endif
+#ifndef MAX_DIST
 #define MAX_DIST 100.0
+#endif
 
 struct camera
 {
@@ -53,11 +74,137 @@ float sdfPlane(vec3 p, vec4 n)
    return dot(p, n.xyz) + n.w;
 }
 
-vec3 repeat(vec3 p, int repeat)
+vec3 repeat(vec3 p, float period)
 {
-   return mod(p, repeat) - 0.5 * repeat;
+   return mod(p, period) - 0.5 * period;
 }
 
+// Polynomial smooth minimum, k is the blend radius.
+float opSmoothUnion(float a, float b, float k)
+{
+   float h = clamp(0.5 + 0.5 * (b - a) / k, 0.0, 1.0);
+   return mix(b, a, h) - k * h * (1.0 - h);
+}
+
+// With SCENE_GRAPH defined the application appends a generated sceneSDF.
+float sceneSDF(vec3 p);
+
+#ifdef SCENE_GRADIENT
+// Analytic counterparts of the functions above, returning the gradient in
+// xyz and the distance in w. Used by the generated sceneGradient().
+vec4 sdfSphereGrad(vec3 p, vec3 c, float r)
+{
+   vec3 d = p - c;
+   float len = length(d);
+   return vec4(d / max(len, 1e-8), len - r);
+}
+
+vec4 sdfBoxGrad(vec3 p, vec3 b)
+{
+   vec3 s = 2.0 * step(0.0, p) - 1.0;
+   vec3 d = abs(p) - b;
+   vec3 outside = max(d, 0.0);
+   float len = length(outside);
+   if (len > 0.0)
+      return vec4(s * outside / len, len);
+   // Inside, the nearest face decides.
+   float m = max(d.x, max(d.y, d.z));
+   vec3 axis = d.x == m ? vec3(1.0, 0.0, 0.0) : d.y == m ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0);
+   return vec4(s * axis, m);
+}
+
+vec4 sdfRoundedBoxGrad(vec3 p, vec3 b, float r)
+{
+   // sdfRoundedBox is flat inside the inner box, any face normal will do.
+   vec4 box = sdfBoxGrad(p, b);
+   return vec4(box.xyz, max(box.w, 0.0) - r);
+}
+
+vec4 sdfPlaneGrad(vec3 p, vec4 n)
+{
+   return vec4(n.xyz, sdfPlane(p, n));
+}
+
+vec4 opUnionGrad(vec4 a, vec4 b)
+{
+   return a.w < b.w ? a : b;
+}
+
+// The terms from the derivative of h cancel, leaving the blended gradients.
+vec4 opSmoothUnionGrad(vec4 a, vec4 b, float k)
+{
+   float h = clamp(0.5 + 0.5 * (b.w - a.w) / k, 0.0, 1.0);
+   return vec4(mix(b.xyz, a.xyz, h), mix(b.w, a.w, h) - k * h * (1.0 - h));
+}
+
+vec4 sceneGradient(vec3 p);
+#endif
+
+#ifdef SCENE_BVH
+// Must hold the depth of the deepest node, see sdf_bvh::max_depth.
+#define BVH_STACK_SIZE 32
+
+// Two texels per node: (lo, first) (hi, second). Leaves have second < 0 and
+// hold primitives first .. first - second - 1.
+uniform samplerBuffer iBVHNodes;
+// Two texels per primitive: (center, type) (half extents, radius).
+uniform samplerBuffer iBVHPrimitives;
+
+float sdfAABB(vec3 p, vec3 lo, vec3 hi)
+{
+   vec3 d = max(lo - p, p - hi);
+   return min(max(d.x, max(d.y, d.z)), 0.0) + length(max(d, 0.0));
+}
+
+float bvhPrimitiveSDF(vec3 p, int index)
+{
+   vec4 a = texelFetch(iBVHPrimitives, 2 * index);
+   vec4 b = texelFetch(iBVHPrimitives, 2 * index + 1);
+   int type = int(a.w);
+   if (type == 0)
+      return sdfSphere(p, a.xyz, b.w);
+   if (type == 1)
+      return sdfBox(p - a.xyz, b.xyz);
+   return sdfRoundedBox(p - a.xyz, b.xyz, b.w);
+}
+
+float nodeDistance(vec3 p, int index)
+{
+   return sdfAABB(p, texelFetch(iBVHNodes, 2 * index).xyz, texelFetch(iBVHNodes, 2 * index + 1).xyz);
+}
+
+// min(best, distance to the primitives in the BVH). Nodes whose bounds are
+// no closer than best cannot lower it and are skipped.
+float bvhSDF(vec3 p, float best)
+{
+   int stack[BVH_STACK_SIZE];
+   int size = 0;
+   stack[size++] = 0;
+   while (size > 0)
+   {
+      int index = stack[--size];
+      vec4 lo = texelFetch(iBVHNodes, 2 * index);
+      vec4 hi = texelFetch(iBVHNodes, 2 * index + 1);
+      if (sdfAABB(p, lo.xyz, hi.xyz) >= best)
+         continue;
+      int first = int(lo.w);
+      int second = int(hi.w);
+      if (second < 0)
+      {
+         for (int i = first; i < first - second; ++i)
+            best = min(best, bvhPrimitiveSDF(p, i));
+         continue;
+      }
+      // Visit the nearer child first.
+      bool swap = nodeDistance(p, second) < nodeDistance(p, first);
+      stack[size++] = swap ? first : second;
+      stack[size++] = swap ? second : first;
+   }
+   return best;
+}
+#endif
+
+#ifndef SCENE_GRAPH
 float sceneSDF(vec3 p)
 {
    float dist = min(
@@ -67,13 +214,121 @@ float sceneSDF(vec3 p)
    dist = min(dist, sdfPlane(p, vec4(0.0, 1.0, 0.0, 0.2)));
    return dist;
 }
+#endif
+
+#ifdef BAKED_SDF
+// Brick table of an sdf_volume: (sample slot or -1, conservative distance).
+uniform sampler3D iBakedBricks;
+// Samples of the stored bricks, 9x9x9 texels each.
+uniform sampler3D iBakedAtlas;
+uniform vec3 iBakedMin;
+uniform vec3 iBakedMax;
+uniform float iBakedBrickSize;
+uniform float iBakedBand;
+// Bricks along x and y of the atlas.
+uniform int iBakedAtlasBricks;
+// Below this distance sceneSDF takes over so hits land on the real surface.
+uniform float iBakedFallback;
+
+float bakedSDF(vec3 p)
+{
+   // The scene may extend past the baked bounds.
+   if (any(lessThan(p, iBakedMin)) || any(greaterThanEqual(p, iBakedMax)))
+      return sceneSDF(p);
+
+   vec3 g = (p - iBakedMin) / iBakedBrickSize;
+   ivec3 brick = ivec3(g);
+   vec2 entry = texelFetch(iBakedBricks, brick, 0).xy;
+   float dist = entry.y;
+   if (entry.x >= 0.0)
+   {
+      int slot = int(entry.x);
+      ivec3 cell = ivec3(slot % iBakedAtlasBricks, (slot / iBakedAtlasBricks) % iBakedAtlasBricks,
+                         slot / (iBakedAtlasBricks * iBakedAtlasBricks));
+      // Brick samples sit on texel centers, so filtering never crosses into a neighbour.
+      vec3 texel = vec3(cell * 9) + 0.5 + (g - vec3(brick)) * 8.0;
+      float sampled = texture(iBakedAtlas, texel / vec3(textureSize(iBakedAtlas, 0))).r;
+      dist = (sampled * 2.0 - 1.0) * iBakedBand;
+   }
+   return dist < iBakedFallback ? sceneSDF(p) : dist;
+}
+
+#define marchSDF bakedSDF
+#else
+#define marchSDF sceneSDF
+#endif
+
+#ifdef COUNT_STEPS
+// Distance evaluations per pixel, written to draw buffer 1 for --benchmark.
+// Shares the location with outDepth; the two variants are never combined.
+#ifdef COMPUTE_BACKEND
+vec4 outSteps;
+#else
+out vec4 outSteps;
+#endif
+int primarySteps = 0;
+int shadowSteps = 0;
+int normalSteps = 0;
+#define COUNT_STEPS_OF(counter, n) counter += n
+#else
+#define COUNT_STEPS_OF(counter, n)
+#endif
 
+#ifdef IMPROVED_SHADOW
+// Evaluation budget of one shadow ray.
+#ifndef SHADOW_STEPS
+#define SHADOW_STEPS 64
+#endif
+// Steps are clamped to this range: the lower bound keeps grazing rays from
+// crawling along a surface, the upper one from jumping over the point where
+// the ray passes closest to an occluder.
+#ifndef SHADOW_MIN_STEP
+#define SHADOW_MIN_STEP 0.02
+#endif
+#ifndef SHADOW_MAX_STEP
+#define SHADOW_MAX_STEP 0.5
+#endif
+
+// Soft shadow estimating the penumbra from the closest approach between two
+// samples rather than from the distance at each sample, which removes the
+// banding of k * dist / t at larger steps. Stops as soon as the point is
+// effectively fully occluded.
+float shadow(in vec3 ro, in vec3 rd, float mint, float maxt, float k)
+{
+   float res = 1.0;
+   float prev = 1e20;
+   float prevT = 0.0;
+   float t = mint;
+   for (int i = 0; i < SHADOW_STEPS && t < maxt; ++i)
+   {
+      float dist = marchSDF(ro + rd * t);
+      COUNT_STEPS_OF(shadowSteps, 1);
+      if (dist < EPSILON)
+         return 0.0;
+      // The empty spheres around the last two samples intersect in a circle
+      // y behind the current sample, at distance d from the ray. Clamped
+      // steps can leave a gap between the spheres; fall back to dist then.
+      float stepSize = t - prevT;
+      float y = (stepSize * stepSize + dist * dist - prev * prev) / (2.0 * stepSize);
+      y = y > 0.0 && y < dist ? y : 0.0;
+      float d = sqrt(dist * dist - y * y);
+      res = min(res, k * d / (t - y));
+      if (res < 0.01)
+         return 0.0;
+      prev = dist;
+      prevT = t;
+      t += clamp(dist, SHADOW_MIN_STEP, SHADOW_MAX_STEP);
+   }
+   return clamp(res, 0.0, 1.0);
+}
+#else
 float shadow(in vec3 ro, in vec3 rd, float mint, float maxt, float k)
 {
    float res = 1.0;
    for (float t = mint; t < maxt;)
    {
-      float dist = sceneSDF(ro + rd * t);
+      float dist = marchSDF(ro + rd * t);
+      COUNT_STEPS_OF(shadowSteps, 1);
       res = min(res, k * dist / t);
       if (dist < EPSILON)
          break;
@@ -81,13 +336,15 @@ float shadow(in vec3 ro, in vec3 rd, float mint, float maxt, float k)
    }
    return clamp(res, 0.0, 1.0);
 }
+#endif
 
-float raymarch(vec3 position, vec3 direction)
+float raymarch(vec3 position, vec3 direction, float start)
 {
-   float depth = 0;
+   float depth = start;
    for (int i = 0; i < STEPS; ++i)
    {
-      float dist = sceneSDF(position + direction * depth);
+      float dist = marchSDF(position + direction * depth);
+      COUNT_STEPS_OF(primarySteps, 1);
       if (dist < EPSILON)
          return depth;
       depth += dist;
@@ -97,13 +354,77 @@ float raymarch(vec3 position, vec3 direction)
    return -1.0;
 }
 
+#ifdef CONE_PREPASS
+// March a cone of slope coneRatio around the ray and return the depth where
+// it first comes within reach of the surface. No ray inside the cone can hit
+// anything before that depth.
+float coneMarch(vec3 position, vec3 direction, float coneRatio)
+{
+   float depth = 0.0;
+   for (int i = 0; i < STEPS; ++i)
+   {
+      float dist = marchSDF(position + direction * depth);
+      float radius = depth * coneRatio;
+      if (dist < radius + EPSILON)
+         return depth;
+      // Largest step that keeps the cone inside the empty sphere.
+      depth += (dist - radius) / (1.0 + coneRatio);
+      if (depth >= MAX_DIST)
+         return MAX_DIST;
+   }
+   return depth;
+}
+#endif
+
+#if defined(CONE_START) || defined(CONE_PREPASS)
+// Full resolution pixels per pre-pass pixel along each axis. Both passes get
+// the full resolution as iResolution, so they see the same camera, and pixel
+// p lies in tile p / iStartDepthScale in both.
+uniform int iStartDepthScale;
+#endif
+
+#ifdef CONE_START
+// Output of the CONE_PREPASS variant.
+uniform sampler2D iStartDepth;
+
+// Depth the ray through pixel can start at: the least of its tile's and the
+// neighbouring tiles' cones, so a jittered ray or one near a tile edge never
+// starts past a surface that only a neighbouring cone caught.
+float coneStart(vec2 pixel)
+{
+   ivec2 tile = ivec2(pixel) / iStartDepthScale;
+   ivec2 last = textureSize(iStartDepth, 0) - 1;
+   float start = MAX_DIST;
+   for (int y = -1; y <= 1; ++y)
+      for (int x = -1; x <= 1; ++x)
+         start = min(start, texelFetch(iStartDepth, clamp(tile + ivec2(x, y), ivec2(0), last), 0).r);
+   return start;
+}
+#endif
+
 // Using the gradient of the SDF, estimate the normal on the surface at point p.
+// ANALYTIC_NORMALS uses the generated sceneGradient() where the scene has one
+// and falls back to TETRAHEDRAL_NORMALS, four taps at the corners of a
+// tetrahedron instead of six central differences.
 vec3 estimateNormal(vec3 p) {
+#if defined(ANALYTIC_NORMALS) && defined(SCENE_GRADIENT)
+    COUNT_STEPS_OF(normalSteps, 1);
+    return normalize(sceneGradient(p).xyz);
+#elif defined(ANALYTIC_NORMALS) || defined(TETRAHEDRAL_NORMALS)
+    COUNT_STEPS_OF(normalSteps, 4);
+    const vec2 k = vec2(1.0, -1.0);
+    return normalize(k.xyy * sceneSDF(p + k.xyy * EPSILON) +
+                     k.yyx * sceneSDF(p + k.yyx * EPSILON) +
+                     k.yxy * sceneSDF(p + k.yxy * EPSILON) +
+                     k.xxx * sceneSDF(p + k.xxx * EPSILON));
+#else
+    COUNT_STEPS_OF(normalSteps, 6);
     return normalize(vec3(
         sceneSDF(vec3(p.x + EPSILON, p.y, p.z)) - sceneSDF(vec3(p.x - EPSILON, p.y, p.z)),
         sceneSDF(vec3(p.x, p.y + EPSILON, p.z)) - sceneSDF(vec3(p.x, p.y - EPSILON, p.z)),
         sceneSDF(vec3(p.x, p.y, p.z  + EPSILON)) - sceneSDF(vec3(p.x, p.y, p.z - EPSILON))
     ));
+#endif
 }
 
 vec4 computeLight(ray r, float dist)
@@ -127,17 +448,17 @@ vec4 computeLight(ray r, float dist)
    return (Kd + Ks * pow(cosTh, iShininess)) * lightColor * cosTi;
 }
 
-camera getCam(vec3 origin, vec3 look, vec3 vup, float fov)
+camera getCam(vec3 origin, vec3 look, vec3 vup, float fov, vec2 resolution, vec2 mouse)
 {
    camera cam;
    cam.origin = origin;
 
    fov = radians(fov); // vertical field of view
    float half_height = tan(fov / 2.0);
-   float half_width = (iResolution.x / iResolution.y) * half_height;
+   float half_width = (resolution.x / resolution.y) * half_height;
 
-   float mx = 2.0 * ((iMouse.x / iResolution.x) - half_width);
-   float my = 2.0 * ((iMouse.y / iResolution.y) - half_height);
+   float mx = 2.0 * ((mouse.x / resolution.x) - half_width);
+   float my = 2.0 * ((mouse.y / resolution.y) - half_height);
 
    // set up the orthonormal basis
    vec3 w = normalize(cam.origin - look);
@@ -153,14 +474,160 @@ camera getCam(vec3 origin, vec3 look, vec3 vup, float fov)
    return cam;
 }
 
-void main()
+camera sceneCamera(vec2 resolution, vec2 mouse)
 {
    vec3 origin = vec3(-0.40, 0.55, 0.35);
    vec3 look = vec3(0.0, 0.0, 0.0);
    vec3 vup = vec3(0, 1, 0);
-   camera cam = getCam(origin, look, vup, 60.0);
-   ray r = get_ray(cam, gl_FragCoord.xy / iResolution);
-   float dist = raymarch(r.origin, r.direction);
+   return getCam(origin, look, vup, 60.0, resolution, mouse);
+}
+
+#ifdef TEMPORAL
+// Hit depth along the ray, MAX_DIST for misses. Bound to draw buffer 1.
+out float outDepth;
+
+// outColor and outDepth of the previous frame.
+uniform sampler2D iPrevColor;
+uniform sampler2D iPrevDepth;
+uniform vec2 iPrevResolution;
+uniform vec2 iPrevMouse;
+// 0 when the history holds nothing usable, e.g. right after a resize.
+uniform int iHistoryValid;
+// Weight of the reprojected history color, 0 disables accumulation.
+uniform float iHistoryBlend;
+// Sub-pixel offset of this frame's rays, in pixels.
+uniform vec2 iJitter;
+
+// Position of p on the screen of cam, (0, 0) to (1, 1) when visible.
+// Inverts get_ray: finds uv whose ray direction points at p.
+vec2 projectToCam(camera cam, vec3 p)
+{
+   vec3 n = cross(cam.horizontal, cam.vertical);
+   vec3 dir = p - cam.origin;
+   float scale = dot(cam.left_corner, n) / dot(dir, n);
+   if (scale <= 0.0)
+      return vec2(-1.0);
+   vec3 rel = dir * scale - cam.left_corner;
+   return vec2(dot(rel, cam.horizontal) / dot(cam.horizontal, cam.horizontal),
+               dot(rel, cam.vertical) / dot(cam.vertical, cam.vertical));
+}
+
+bool onScreen(vec2 uv)
+{
+   return all(greaterThanEqual(uv, vec2(0.0))) && all(lessThan(uv, vec2(1.0)));
+}
+
+// Depth r can safely start marching at according to last frame, 0 if unknown.
+float reprojectedStart(ray r, camera prevCam)
+{
+   if (iHistoryValid == 0)
+      return 0.0;
+   // Last frame's depth at this pixel locates the surface well enough to
+   // find where it was on the previous screen.
+   float guess = texelFetch(iPrevDepth, ivec2(fragCoord), 0).r;
+   vec3 guessed = r.origin + r.direction * guess;
+   vec2 uv = projectToCam(prevCam, guessed);
+   if (!onScreen(uv))
+      return 0.0;
+
+   // Last frame must have seen the guessed point itself there; otherwise
+   // this pixel shows something that was hidden, which may be closer.
+   ivec2 texel = ivec2(uv * iPrevResolution);
+   float expected = distance(guessed, prevCam.origin);
+   if (abs(texelFetch(iPrevDepth, texel, 0).r - expected) > 0.02 * expected)
+      return 0.0;
+
+   ivec2 last = ivec2(iPrevResolution) - 1;
+   float nearest = MAX_DIST;
+   float farthest = 0.0;
+   for (int y = -1; y <= 1; ++y)
+   {
+      for (int x = -1; x <= 1; ++x)
+      {
+         float d = texelFetch(iPrevDepth, clamp(texel + ivec2(x, y), ivec2(0), last), 0).r;
+         nearest = min(nearest, d);
+         farthest = max(farthest, d);
+      }
+   }
+   // A depth edge nearby: thin geometry or a silhouette, behind which the
+   // new ray may pass closer than anything last frame saw.
+   if (farthest - nearest > 0.05 * nearest)
+      return 0.0;
+
+   // Nothing was closer than nearest to the old origin around there, so
+   // nothing is closer than this to the new one.
+   float start = 0.98 * max(nearest - distance(r.origin, prevCam.origin), 0.0);
+   // Starting inside the scene means the history was wrong.
+   if (marchSDF(r.origin + r.direction * start) < EPSILON)
+      return 0.0;
+   return start;
+}
+
+// Blend color with last frame's color at the same surface point.
+vec4 accumulate(vec4 color, ray r, float depth, camera prevCam)
+{
+   if (iHistoryValid == 0 || iHistoryBlend <= 0.0)
+      return color;
+   vec3 p = r.origin + r.direction * depth;
+   vec2 uv = projectToCam(prevCam, p);
+   if (!onScreen(uv))
+      return color;
+   // Reject history that saw a different surface.
+   float expected = distance(p, prevCam.origin);
+   float seen = texelFetch(iPrevDepth, ivec2(uv * iPrevResolution), 0).r;
+   if (abs(seen - expected) > 0.02 * expected)
+      return color;
+   return mix(color, texture(iPrevColor, uv), iHistoryBlend);
+}
+#endif
+
+#ifdef INTERLEAVED
+// Stored in alpha so the resolve pass can tell stale pixels from fresh ones.
+uniform int iGeneration;
+#endif
+
+#ifdef COMPUTE_BACKEND
+void shadePixel()
+#else
+void main()
+#endif
+{
+#ifdef COUNT_STEPS
+   // Persistent compute threads shade many pixels each.
+   primarySteps = 0;
+   shadowSteps = 0;
+   normalSteps = 0;
+#endif
+   camera cam = sceneCamera(iResolution, iMouse);
+#ifdef CONE_PREPASS
+   // The ray through the center of this pixel's tile of full resolution
+   // pixels.
+   vec2 pixel = (floor(fragCoord) + 0.5) * float(iStartDepthScale);
+#else
+   vec2 pixel = fragCoord;
+#endif
+#ifdef TEMPORAL
+   pixel += iJitter;
+#endif
+   ray r = get_ray(cam, pixel / iResolution);
+
+#ifdef CONE_PREPASS
+   // One tile of the image plane at unit distance; a full tile rather than
+   // half its diagonal leaves slack for jitter.
+   float tileSize = length(cam.vertical) / iResolution.y * float(iStartDepthScale);
+   outColor = vec4(coneMarch(r.origin, r.direction, tileSize), 0.0, 0.0, 1.0);
+   return;
+#endif
+
+   float start = 0.0;
+#ifdef CONE_START
+   start = coneStart(fragCoord);
+#endif
+#ifdef TEMPORAL
+   camera prevCam = sceneCamera(iPrevResolution, iPrevMouse);
+   start = max(start, reprojectedStart(r, prevCam));
+#endif
+   float dist = raymarch(r.origin, r.direction, start);
 
    if (dist > -1.0)
    {
@@ -172,4 +639,69 @@ void main()
       vec3 gradient = (1.0 - y) * vec3(0.8, 0.8, 0.8) + y * vec3(0.05, 0.05, 0.05);
       outColor = vec4(gradient, 1.0);
    }
+
+#ifdef TEMPORAL
+   float depth = dist > -1.0 ? dist : MAX_DIST;
+   outColor = accumulate(outColor, r, depth, prevCam);
+   outDepth = depth;
+#endif
+#ifdef INTERLEAVED
+   outColor.a = float(iGeneration);
+#endif
+#ifdef COUNT_STEPS
+   outSteps = vec4(primarySteps, shadowSteps, normalSteps, 0.0);
+#endif
+}
+
+#ifdef COMPUTE_BACKEND
+// One work group shades an 8x8 tile, so neighbouring rays that take similar
+// paths through the scene run together.
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(rgba8) uniform writeonly image2D iOutput;
+#ifdef COUNT_STEPS
+layout(rgba32f) uniform writeonly image2D iStepsOutput;
+#endif
+
+void shadeTile(uvec2 tile)
+{
+   ivec2 p = ivec2(tile * gl_WorkGroupSize.xy + gl_LocalInvocationID.xy);
+   if (any(greaterThanEqual(p, ivec2(iResolution))))
+      return;
+   fragCoord = vec2(p) + 0.5;
+   shadePixel();
+   imageStore(iOutput, p, outColor);
+#ifdef COUNT_STEPS
+   imageStore(iStepsOutput, p, outSteps);
+#endif
+}
+
+#ifdef PERSISTENT_THREADS
+// Tiles handed out so far, zeroed by the app before each dispatch. Only as
+// many groups are launched as fit on the GPU; each takes the next tile when
+// it is done with one, so expensive tiles do not leave cores idle.
+layout(binding = 0, offset = 0) uniform atomic_uint iTileCounter;
+shared uint claimedTile;
+
+void main()
+{
+   uvec2 tiles = (uvec2(iResolution) + gl_WorkGroupSize.xy - 1u) / gl_WorkGroupSize.xy;
+   for (;;)
+   {
+      if (gl_LocalInvocationIndex == 0u)
+         claimedTile = atomicCounterIncrement(iTileCounter);
+      barrier();
+      uint tile = claimedTile;
+      // Everyone has read it before it is replaced.
+      barrier();
+      if (tile >= tiles.x * tiles.y)
+         return;
+      shadeTile(uvec2(tile % tiles.x, tile / tiles.x));
+   }
+}
+#else
+void main()
+{
+   shadeTile(gl_WorkGroupID.xy);
 }
+#endif
+#endif
@@ -1,6 +1,16 @@
 #version 410 core
-in vec2 position;
 
+// No vertex attributes: positions follow from gl_VertexID.
 void main() {
+#ifdef QUAD_VERTICES
+   // Two triangles meeting along the diagonal.
+   const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0),
+                                  vec2(1.0, 1.0), vec2(1.0, -1.0), vec2(-1.0, -1.0));
+   vec2 position = corners[gl_VertexID];
+#else
+   // One triangle with corners (-1, -1), (3, -1) and (-1, 3), clipped to the
+   // viewport, so no pixel quad straddles an inner edge.
+   vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+#endif
    gl_Position = vec4(position, -1.0, 1.0);
 }
@@ -0,0 +1,510 @@
+#include "shadertoy.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+
+#include "shader_source.h"
+
+const char* shadertoy_prelude = "#version 410 core\n"
+                                "uniform vec3 iResolution;\n"
+                                "uniform float iTime;\n"
+                                "uniform float iTimeDelta;\n"
+                                "uniform float iFrameRate;\n"
+                                "uniform int iFrame;\n"
+                                "uniform vec4 iMouse;\n"
+                                "uniform vec4 iDate;\n"
+                                "uniform float iSampleRate;\n"
+                                "uniform vec3 iChannelResolution[4];\n"
+                                "uniform float iChannelTime[4];\n"
+                                "uniform sampler2D iChannel0;\n"
+                                "uniform sampler2D iChannel1;\n"
+                                "uniform sampler2D iChannel2;\n"
+                                "uniform sampler2D iChannel3;\n"
+                                "out vec4 outColor;\n";
+
+const char* shadertoy_trailer = "void main()\n"
+                                "{\n"
+                                "   outColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+                                "   mainImage(outColor, gl_FragCoord.xy);\n"
+                                "}\n";
+
+namespace {
+   bool is_identifier(char c) { return isalnum((unsigned char)c) || c == '_'; }
+
+   // Whether name( appears in src as a whole word, e.g. a definition or call.
+   bool has_function(const char* src, size_t len, const char* name)
+   {
+      const size_t name_len = strlen(name);
+      const char* end = src + len;
+      for (const char* p = src; size_t(end - p) >= name_len; ++p)
+      {
+         if (memcmp(p, name, name_len) != 0 || (p > src && is_identifier(p[-1])))
+            continue;
+         const char* q = p + name_len;
+         while (q < end && isspace((unsigned char)*q))
+            ++q;
+         if (q < end && *q == '(')
+            return true;
+      }
+      return false;
+   }
+
+   // Just enough JSON for project files.
+   struct json_value
+   {
+      enum class kind
+      {
+         null,
+         boolean,
+         number,
+         string,
+         array,
+         object,
+      };
+      kind type = kind::null;
+      bool flag = false;
+      double number = 0.0;
+      std::string text;
+      std::vector<json_value> items;
+      std::vector<std::pair<std::string, json_value>> members;
+
+      // Member name, or a null value.
+      const json_value& operator[](const char* name) const
+      {
+         static const json_value none;
+         for (const auto& member : members)
+         {
+            if (member.first == name)
+               return member.second;
+         }
+         return none;
+      }
+      // Strings as they are, numbers as integers, as Shadertoy mixes both for
+      // ids and flags.
+      std::string as_string() const
+      {
+         if (type == kind::number)
+            return std::to_string((long long)number);
+         if (type == kind::boolean)
+            return flag ? "true" : "false";
+         return text;
+      }
+   };
+
+   class json_parser
+   {
+   public:
+      json_parser(const char* data, size_t len) : p(data), end(data + len) {}
+
+      bool parse(json_value& value, std::string& error)
+      {
+         if (!parse_value(value, 0))
+         {
+            error = message.empty() ? "invalid JSON" : message;
+            return false;
+         }
+         skip_space();
+         if (p != end)
+         {
+            error = "unexpected text after the JSON value";
+            return false;
+         }
+         return true;
+      }
+
+   private:
+      static const int max_depth = 64;
+
+      void skip_space()
+      {
+         while (p < end && isspace((unsigned char)*p))
+            ++p;
+      }
+
+      bool fail(const char* what)
+      {
+         message = what;
+         return false;
+      }
+
+      bool literal(const char* word)
+      {
+         const size_t len = strlen(word);
+         if (size_t(end - p) < len || memcmp(p, word, len) != 0)
+            return fail("invalid JSON literal");
+         p += len;
+         return true;
+      }
+
+      static void append_utf8(std::string& out, unsigned code)
+      {
+         if (code < 0x80)
+            out += char(code);
+         else if (code < 0x800)
+         {
+            out += char(0xc0 | code >> 6);
+            out += char(0x80 | (code & 0x3f));
+         }
+         else if (code < 0x10000)
+         {
+            out += char(0xe0 | code >> 12);
+            out += char(0x80 | (code >> 6 & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+         }
+         else
+         {
+            out += char(0xf0 | code >> 18);
+            out += char(0x80 | (code >> 12 & 0x3f));
+            out += char(0x80 | (code >> 6 & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+         }
+      }
+
+      bool hex4(unsigned& code)
+      {
+         if (end - p < 4)
+            return fail("truncated \\u escape");
+         code = 0;
+         for (int i = 0; i < 4; ++i, ++p)
+         {
+            const char c = *p;
+            if (!isxdigit((unsigned char)c))
+               return fail("invalid \\u escape");
+            code = code << 4 | unsigned(isdigit((unsigned char)c) ? c - '0' : (tolower(c) - 'a' + 10));
+         }
+         return true;
+      }
+
+      bool parse_string(std::string& out)
+      {
+         ++p;
+         out.clear();
+         while (p < end && *p != '"')
+         {
+            if (*p != '\\')
+            {
+               out += *p++;
+               continue;
+            }
+            if (++p == end)
+               break;
+            const char c = *p++;
+            switch (c)
+            {
+            case 'n':
+               out += '\n';
+               break;
+            case 't':
+               out += '\t';
+               break;
+            case 'r':
+               out += '\r';
+               break;
+            case 'b':
+               out += '\b';
+               break;
+            case 'f':
+               out += '\f';
+               break;
+            case 'u':
+            {
+               unsigned code;
+               if (!hex4(code))
+                  return false;
+               // Surrogate pairs encode code points past the first plane.
+               if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+               {
+                  p += 2;
+                  unsigned low;
+                  if (!hex4(low))
+                     return false;
+                  code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+               }
+               append_utf8(out, code);
+               break;
+            }
+            default:
+               out += c;
+               break;
+            }
+         }
+         if (p == end)
+            return fail("unterminated JSON string");
+         ++p;
+         return true;
+      }
+
+      bool parse_value(json_value& value, int depth)
+      {
+         if (depth > max_depth)
+            return fail("JSON nested too deeply");
+         skip_space();
+         if (p == end)
+            return fail("unexpected end of JSON");
+         switch (*p)
+         {
+         case '{':
+            value.type = json_value::kind::object;
+            ++p;
+            skip_space();
+            if (p < end && *p == '}')
+            {
+               ++p;
+               return true;
+            }
+            for (;;)
+            {
+               skip_space();
+               if (p == end || *p != '"')
+                  return fail("expected a JSON member name");
+               value.members.emplace_back();
+               if (!parse_string(value.members.back().first))
+                  return false;
+               skip_space();
+               if (p == end || *p++ != ':')
+                  return fail("expected ':' in JSON object");
+               if (!parse_value(value.members.back().second, depth + 1))
+                  return false;
+               skip_space();
+               if (p < end && *p == ',')
+               {
+                  ++p;
+                  continue;
+               }
+               if (p < end && *p == '}')
+               {
+                  ++p;
+                  return true;
+               }
+               return fail("expected ',' or '}' in JSON object");
+            }
+         case '[':
+            value.type = json_value::kind::array;
+            ++p;
+            skip_space();
+            if (p < end && *p == ']')
+            {
+               ++p;
+               return true;
+            }
+            for (;;)
+            {
+               value.items.emplace_back();
+               if (!parse_value(value.items.back(), depth + 1))
+                  return false;
+               skip_space();
+               if (p < end && *p == ',')
+               {
+                  ++p;
+                  continue;
+               }
+               if (p < end && *p == ']')
+               {
+                  ++p;
+                  return true;
+               }
+               return fail("expected ',' or ']' in JSON array");
+            }
+         case '"':
+            value.type = json_value::kind::string;
+            return parse_string(value.text);
+         case 't':
+            value.type = json_value::kind::boolean;
+            value.flag = true;
+            return literal("true");
+         case 'f':
+            value.type = json_value::kind::boolean;
+            return literal("false");
+         case 'n':
+            return literal("null");
+         default:
+         {
+            // The text is followed by more JSON, so strtod stops in time.
+            const std::string number(p, std::min<size_t>(end - p, 64));
+            char* stop;
+            value.type = json_value::kind::number;
+            value.number = strtod(number.c_str(), &stop);
+            if (stop == number.c_str())
+               return fail("invalid JSON value");
+            p += stop - number.c_str();
+            return true;
+         }
+         }
+      }
+
+      const char* p;
+      const char* end;
+      std::string message;
+   };
+
+   // Output ids of Buffer A to D, in the current and the older numeric form.
+   const char* buffer_ids[4][2] = {
+      { "4dXGR8", "257" },
+      { "XsXGR8", "258" },
+      { "4sXGR8", "259" },
+      { "XdfGR8", "260" },
+   };
+
+   int known_buffer(const std::string& id)
+   {
+      for (int i = 0; i < 4; ++i)
+      {
+         if (id == buffer_ids[i][0] || id == buffer_ids[i][1])
+            return i;
+      }
+      return -1;
+   }
+
+   // src relative to directory.
+   std::string resolve_texture(const std::string& directory, std::string src)
+   {
+      while (!src.empty() && src[0] == '/')
+         src.erase(0, 1);
+      return directory + src;
+   }
+
+   bool is_true(const json_value& value, bool fallback)
+   {
+      if (value.type == json_value::kind::null)
+         return fallback;
+      return value.as_string() == "true" || value.as_string() == "1";
+   }
+}
+
+bool is_shadertoy_source(const char* src, size_t len)
+{
+   return has_function(src, len, "mainImage") && !has_function(src, len, "main");
+}
+
+bool load_shadertoy_project(const char* path, shadertoy_project& project, std::string& error)
+{
+   project = shadertoy_project();
+   mapped_file file;
+   if (!file.map(path))
+   {
+      error = "cannot be read";
+      return false;
+   }
+   json_value root;
+   if (!json_parser(file.data(), file.size()).parse(root, error))
+      return false;
+   const json_value* shader = &root;
+   if (shader->type == json_value::kind::array && !shader->items.empty())
+      shader = &shader->items[0];
+   if ((*shader)["Shader"].type == json_value::kind::object)
+      shader = &(*shader)["Shader"];
+   const json_value& renderpasses = (*shader)["renderpass"];
+   if (renderpasses.type != json_value::kind::array)
+   {
+      error = "has no renderpass list";
+      return false;
+   }
+   project.name = (*shader)["info"]["name"].as_string();
+
+   const std::string file_path = path;
+   const size_t slash = file_path.find_last_of('/');
+   const std::string directory = slash == std::string::npos ? std::string() : file_path.substr(0, slash + 1);
+
+   // Buffers are numbered by their output id where it is a known one,
+   // otherwise in the order they are listed.
+   std::map<std::string, int> output_buffers;
+   std::vector<const json_value*> buffer_passes;
+   const json_value* image_pass = nullptr;
+   for (const json_value& pass : renderpasses.items)
+   {
+      const std::string type = pass["type"].as_string();
+      if (type == "common")
+         project.common += pass["code"].as_string() + "\n";
+      else if (type == "buffer")
+         buffer_passes.push_back(&pass);
+      else if (type == "image" && !image_pass)
+         image_pass = &pass;
+      else
+         fprintf(stderr, "%s: skipping %s pass %s\n", path, type.c_str(), pass["name"].as_string().c_str());
+   }
+   if (!image_pass)
+   {
+      error = "has no image pass";
+      return false;
+   }
+   if (buffer_passes.size() > 4)
+   {
+      error = "has more than four buffers";
+      return false;
+   }
+   std::vector<std::pair<int, const json_value*>> order;
+   bool used[4] = {};
+   for (const json_value* pass : buffer_passes)
+   {
+      const json_value& outputs = (*pass)["outputs"];
+      const std::string id = outputs.items.empty() ? std::string() : outputs.items[0]["id"].as_string();
+      int buffer = known_buffer(id);
+      if (buffer < 0 || used[buffer])
+         buffer = int(std::find(used, used + 4, false) - used);
+      used[buffer] = true;
+      if (!id.empty())
+         output_buffers[id] = buffer;
+      order.emplace_back(buffer, pass);
+   }
+   std::sort(order.begin(), order.end());
+   order.emplace_back(-1, image_pass);
+
+   for (const auto& entry : order)
+   {
+      shadertoy_pass converted;
+      converted.name = (*entry.second)["name"].as_string();
+      converted.code = (*entry.second)["code"].as_string();
+      converted.buffer = entry.first;
+      for (const json_value& input : (*entry.second)["inputs"].items)
+      {
+         const int channel = int(input["channel"].number);
+         if (channel < 0 || channel > 3)
+            continue;
+         shadertoy_input& out = converted.inputs[channel];
+         // Older exports name the fields type and filepath.
+         std::string type = input["ctype"].as_string();
+         if (type.empty())
+            type = input["type"].as_string();
+         std::string src = input["src"].as_string();
+         if (src.empty())
+            src = input["filepath"].as_string();
+         const json_value& sampler = input["sampler"];
+         const std::string filter = sampler["filter"].as_string();
+         const std::string wrap = sampler["wrap"].as_string();
+         out.nearest = filter == "nearest";
+         out.mipmap = filter.empty() ? type == "texture" : filter == "mipmap";
+         out.repeat = wrap.empty() ? type == "texture" : wrap == "repeat";
+         out.vflip = is_true(sampler["vflip"], true);
+         if (type == "buffer")
+         {
+            const std::string id = input["id"].as_string();
+            auto found = output_buffers.find(id);
+            out.type = shadertoy_input::kind::buffer;
+            out.buffer = found != output_buffers.end() ? found->second : known_buffer(id);
+            // Also referenced as /media/previz/buffer00.png to buffer03.png.
+            const size_t previz = src.find("buffer0");
+            if (out.buffer < 0 && previz != std::string::npos && previz + 7 < src.size())
+               out.buffer = src[previz + 7] - '0';
+            if (out.buffer < 0 || out.buffer > 3)
+               out = shadertoy_input();
+         }
+         else if (type == "texture")
+         {
+            out.type = shadertoy_input::kind::texture;
+            out.path = resolve_texture(directory, src);
+         }
+         else if (!type.empty())
+         {
+            out.type = shadertoy_input::kind::unsupported;
+            out.path = type;
+         }
+      }
+      project.passes.push_back(converted);
+   }
+   return true;
+}
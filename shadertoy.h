@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// Text wrapped around Shadertoy sources, which only define
+// mainImage(out vec4, in vec2) and use the standard uniforms undeclared.
+extern const char* shadertoy_prelude;
+extern const char* shadertoy_trailer;
+
+// Whether src defines mainImage() and no main() of its own.
+bool is_shadertoy_source(const char* src, size_t len);
+
+// One iChannel input of a pass.
+struct shadertoy_input
+{
+   enum class kind
+   {
+      none,
+      buffer,
+      texture,
+      // Keyboard, cubemaps, sound and the like; bound to nothing.
+      unsupported,
+   };
+   kind type = kind::none;
+   // Buffer 0 to 3 for Buffer A to D.
+   int buffer = -1;
+   // Image file of a texture input, or the input type if unsupported.
+   std::string path;
+   bool nearest = false;
+   bool mipmap = true;
+   bool repeat = true;
+   // Shadertoy's vflip; textures are uploaded bottom row first when set.
+   bool vflip = true;
+};
+
+struct shadertoy_pass
+{
+   std::string name;
+   std::string code;
+   // Buffer 0 to 3 written, -1 for the image pass.
+   int buffer = -1;
+   shadertoy_input inputs[4];
+};
+
+struct shadertoy_project
+{
+   std::string name;
+   // Common tab, compiled into every pass.
+   std::string common;
+   // Buffer passes in A to D order, then the image pass.
+   std::vector<shadertoy_pass> passes;
+};
+
+// Load a project exported from Shadertoy as JSON: a "Shader" object, or an
+// array of them of which the first is used, with "renderpass" entries of
+// type "common", "buffer" and "image". Texture "src" paths are taken
+// relative to the project file. Returns false with error set if path is no
+// such project.
+bool load_shadertoy_project(const char* path, shadertoy_project& project, std::string& error);
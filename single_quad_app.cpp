@@ -1,71 +1,597 @@
 #include "single_quad_app.h"
 
+#include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <algorithm>
 #include <chrono>
+#include <future>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include "extern/imgui/imgui.h"
 #include "extern/imgui_impl/imgui_impl_glfw_gl3.h"
 
+#include "ab_comparison.h"
+#include "benchmark.h"
 #include "clock.h"
+#include "compute_raymarch.h"
+#include "input_latency.h"
 #include "opengl_util.h"
+#include "project_passes.h"
+#include "quad_program.h"
+#include "raymarch_passes.h"
+#include "raymarcher_programs.h"
+#include "render_handoff.h"
+#include "render_target.h"
+#include "retire_queue.h"
+#include "scene_inputs.h"
+#include "session_recording.h"
+#include "shader_permutations.h"
+#include "shader_channels.h"
+#include "shader_registry.h"
+#include "shadertoy.h"
+#include "spirv_cache.h"
+#include "texture_channels.h"
+#include "triple_buffer.h"
+#include "ui_snapshot.h"
+#include "video_channel.h"
+#include "view_windows.h"
 
-// clang-format off
-static const GLfloat vertices[] = {
-   //  Position  
-   -1.0f, -1.0f, // Top-left
-   -1.0f,  1.0f, // Bottom-left
-    1.0f,  1.0f, // Bottom-right
-    1.0f,  1.0f, // Bottom-right
-    1.0f, -1.0f, // Top-right
-   -1.0f, -1.0f, // Top-left
-};
-// clang-format on
-
-struct GL_state
-{
-   GLuint vao;
-   GLuint vbo;
-   GLint pos_attrib;
-   GLuint program;
-   GLuint vert_shader;
-   GLuint frag_shader;
-
-   GLint elapsed_time_uniform;
-   GLint resolution_uniform;
-   GLint mouse_uniform;
-   GLint color_uniform;
-   GLint shininess_uniform;
-} gl_state;
-
-void reloadShaders()
-{
-   auto vert_shader = compile_shader_from_file(GL_VERTEX_SHADER, "shaders/vertex.glsl");
-   auto frag_shader = compile_shader_from_file(GL_FRAGMENT_SHADER, "shaders/raymarch.glsl");
-   if (!vert_shader || !frag_shader)
-   {
-      fprintf(stderr, "Failed to load shaders\n");
+static const char* volume_path = "scene.sdfv";
+
+// Seconds between checks whether a shader file was saved.
+static const double reload_poll_interval = 0.5;
+
+void single_quad_app::invalidate_history()
+{
+   ++history_generation;
+}
+
+void single_quad_app::discard_history()
+{
+   temporal_pass.discard();
+   interleave_pass.discard();
+}
+
+void single_quad_app::select_shader(size_t index)
+{
+   registry.select(index);
+   invalidate_history();
+}
+
+const quad_program& single_quad_app::shown_program() const
+{
+   const registered_shader& shader = registry.shown();
+   return is_raymarcher(shader) ? raymarcher.main : shader.built;
+}
+
+bool single_quad_app::pin_ab()
+{
+   const registered_shader& shader = registry.shown();
+   quad_program pinned = {};
+   std::string name = shader_name(shader);
+   if (is_raymarcher(shader))
+   {
+      if (!raymarcher.build(pinned, raymarcher.permutations.defines().c_str()))
+         return false;
+      const std::string variant = raymarcher.permutations.description();
+      if (!variant.empty())
+         name += " (" + variant + ")";
    }
    else
    {
-      gl_state.vert_shader = vert_shader;
-      gl_state.frag_shader = frag_shader;
-      if (gl_state.program)
-         glDeleteProgram(gl_state.program);
-      gl_state.program = glCreateProgram();
-      glAttachShader(gl_state.program, gl_state.vert_shader);
-      glAttachShader(gl_state.program, gl_state.frag_shader);
-      glDeleteShader(gl_state.vert_shader);
-      glDeleteShader(gl_state.frag_shader);
-      glLinkProgram(gl_state.program);
-      gl_state.elapsed_time_uniform = glGetUniformLocation(gl_state.program, "iTime");
-      gl_state.resolution_uniform = glGetUniformLocation(gl_state.program, "iResolution");
-      gl_state.mouse_uniform = glGetUniformLocation(gl_state.program, "iMouse");
-      gl_state.color_uniform = glGetUniformLocation(gl_state.program, "iColor");
-      gl_state.shininess_uniform = glGetUniformLocation(gl_state.program, "iShininess");
+      if (!link_quad_program(pinned.program, compile_shader_from_file(GL_FRAGMENT_SHADER, shader.path.c_str())))
+         return false;
+      get_frame_uniforms(pinned);
+   }
+   ab.replace_pinned(pinned, name, scene.topology);
+   return true;
+}
+
+bool single_quad_app::select_main_program()
+{
+   invalidate_history();
+   return raymarcher.select();
+}
+
+void single_quad_app::change_modes()
+{
+   invalidate_history();
+   raymarcher.change_modes();
+}
+
+void single_quad_app::reloadShaders()
+{
+   shader_errors.clear();
+   invalidate_history();
+   // Recorded up front so a scene that fails to compile is not retried every frame.
+   scene.topology = scene.graph.topology_hash();
+   raymarcher.reload();
+   scene.upload_params();
+
+   // The others rebuild in the background while their old programs are drawn.
+   registry.reload();
+}
+
+// Lists shader_errors with the source lines around each one.
+static void show_shader_errors()
+{
+   if (shader_errors.empty())
+      return;
+   const ImVec4 error_color(1.0f, 0.4f, 0.4f, 1.0f);
+   const ImVec4 warning_color(1.0f, 0.8f, 0.3f, 1.0f);
+   const ImVec4 context_color(0.6f, 0.6f, 0.6f, 1.0f);
+   ImGui::Begin("Shader errors");
+   ImGui::Text("The last program that built is still running.");
+   for (const shader_diagnostic& d : shader_errors)
+   {
+      ImGui::Separator();
+      const ImVec4& color = d.error ? error_color : warning_color;
+      if (d.line)
+         ImGui::TextColored(color, "%s:%d: %s", d.file.c_str(), d.line, d.message.c_str());
+      else
+         ImGui::TextColored(color, "%s: %s", d.file.c_str(), d.message.c_str());
+      for (size_t i = 0; i < d.snippet.size(); ++i)
+      {
+         const int line = d.snippet_line + int(i);
+         ImGui::TextColored(line == d.line ? color : context_color, "%5d %s %s", line, line == d.line ? ">" : " ",
+                            d.snippet[i].c_str());
+      }
+   }
+   ImGui::End();
+}
+
+// Bakes the scene into volume_path on a worker thread and loads the result.
+void single_quad_app::edit_volume()
+{
+   static std::future<bool> baking;
+   static sdf_volume_settings settings = [] {
+      sdf_volume_settings defaults;
+      defaults.bounds.lo = vec3(-1.0f, -0.5f, -1.0f);
+      defaults.bounds.hi = vec3(1.0f, 1.0f, 1.0f);
+      return defaults;
+   }();
+   static bool sixteen_bit = false;
+
+   ImGui::DragFloat3("Min", &settings.bounds.lo.x, 0.01f);
+   ImGui::DragFloat3("Max", &settings.bounds.hi.x, 0.01f);
+   ImGui::SliderInt("Resolution", &settings.resolution, 32, 512);
+   ImGui::Checkbox("16 bit", &sixteen_bit);
+
+   bool load = false;
+   if (baking.valid())
+   {
+      ImGui::Text("Baking...");
+      if (baking.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+         load = baking.get();
+   }
+   else if (ImGui::Button("Bake"))
+   {
+      settings.bits = sixteen_bit ? 16 : 8;
+      // The worker gets its own copy so editing can go on meanwhile.
+      sdf_scene snapshot = scene.graph;
+      if (snapshot.use_bvh)
+         snapshot.build_bvh();
+      baking = std::async(std::launch::async, [snapshot, config = settings] {
+         sdf_volume baked;
+         return baked.bake(snapshot, config) && baked.save(volume_path);
+      });
+   }
+   ImGui::SameLine();
+   load |= ImGui::Button("Load");
+   if (load && scene.volume.load(volume_path))
+   {
+      scene.upload_volume();
+      scene.use_volume = true;
+      reloadShaders();
+   }
+
+   if (!scene.volume.empty())
+   {
+      ImGui::Text("%d bricks, %d stored, %.2f MB", scene.volume.brick_count(), int(scene.volume.header.stored_bricks),
+                  scene.volume.sample_bytes() / (1024.0f * 1024.0f));
+      if (ImGui::Checkbox("March baked volume", &scene.use_volume))
+         reloadShaders();
+   }
+}
+
+// Picks the images of the iChannel samplers.
+void single_quad_app::edit_channels()
+{
+   static char paths[texture_cache::channel_count][256];
+   static const char* states[] = { "", "decoding", "uploading", "", "failed" };
+   for (int i = 0; i < texture_cache::channel_count; ++i)
+   {
+      ImGui::PushID(i);
+      const std::string label = "iChannel" + std::to_string(i);
+      const bool entered = ImGui::InputText(label.c_str(), paths[i], sizeof(paths[i]), ImGuiInputTextFlags_EnterReturnsTrue);
+      ImGui::SameLine();
+      if (ImGui::Button("Load") || entered)
+         channels.images.set_channel(i, paths[i]);
+      const texture_cache::state state = channels.images.channel_state(i);
+      if (state == texture_cache::state::resident)
+      {
+         int width, height;
+         channels.images.channel_size(i, width, height);
+         ImGui::SameLine();
+         ImGui::Text("%dx%d", width, height);
+      }
+      else if (state != texture_cache::state::none)
+      {
+         ImGui::SameLine();
+         ImGui::Text("%s", states[int(state)]);
+      }
+      ImGui::PopID();
+   }
+   texture_cache& images = channels.images;
+   int budget_mb = int(images.residency_budget >> 20);
+   if (ImGui::SliderInt("Budget MB", &budget_mb, 16, 2048))
+      images.residency_budget = size_t(budget_mb) << 20;
+   ImGui::Text("%.1f MB resident, %d loading", images.resident_bytes() / (1024.0f * 1024.0f), images.pending());
+}
+
+// Opens a video on a channel and shows how well decoding keeps up.
+void single_quad_app::edit_video()
+{
+   static char path[256];
+   static const char* policies[] = { "Drop late frames", "Wait for frames" };
+   ImGui::InputText("Y4M file", path, sizeof(path));
+   if (ImGui::Button("Open"))
+   {
+      channels.close_video();
+      channels.video->open(path, glfwGetTime());
+   }
+   video_channel* video = channels.video.get();
+   if (!video->is_open())
+      return;
+   ImGui::SameLine();
+   if (ImGui::Button("Close"))
+   {
+      channels.close_video();
+      return;
+   }
+   ImGui::SliderInt("Video channel", &video->channel, 0, texture_cache::channel_count - 1);
+   int sync = int(video->sync);
+   if (ImGui::Combo("When late", &sync, policies, 2))
+      video->sync = video_channel::policy(sync);
+   const video_channel::stats& stats = video->counters();
+   ImGui::Text("%dx%d at %.2f fps, %d frames", video->info().width, video->info().height, video->info().fps,
+               int(video->info().frames.size()));
+   ImGui::Text("Decode %.2f ms, upload %.2f ms, late %.1f ms", stats.decode_ms, stats.upload_ms, stats.late_ms);
+   ImGui::Text("%ld shown, %ld dropped, %d decoded ahead", stats.shown, stats.dropped, stats.ahead);
+}
+
+// Controls and results of the A/B comparison.
+void single_quad_app::edit_ab()
+{
+   static const char* modes[] = { "Off", "Split screen", "Alternate frames" };
+   int mode = int(ab.mode);
+   if (ImGui::Combo("A/B", &mode, modes, 3))
+   {
+      ab.mode = ab_mode(mode);
+      raymarch_modes& passes = raymarcher.modes;
+      if (ab.mode != ab_mode::off
+          && (passes.cone_prepass || passes.temporal || passes.interleave_cells > 1
+              || passes.backend != raymarch_backend::fragment))
+      {
+         // Both sides are drawn as a single fragment pass.
+         passes.cone_prepass = false;
+         passes.temporal = false;
+         passes.interleave_cells = 1;
+         passes.backend = raymarch_backend::fragment;
+         change_modes();
+      }
+      if (ab.mode != ab_mode::off && !ab.pinned.program)
+         pin_ab();
+   }
+   if (ab.mode == ab_mode::off)
+      return;
+   if (ImGui::Button("Pin shown as B"))
+      pin_ab();
+   if (ab.mode == ab_mode::split)
+   {
+      ImGui::SameLine();
+      ImGui::SliderFloat("Divider", &ab.split, 0.0f, 1.0f);
+   }
+   ImGui::Text("B: %s", ab.pinned.program ? ab.pinned_name.c_str() : "nothing pinned");
+   if (ab.pinned.program && ab.pinned_topology != scene.topology)
+      ImGui::Text("The scene changed since B was pinned, pin it again.");
+   const ab_measurement& measured = reports.read_buffer().ab;
+   ImGui::Text("Live ms    A %.3f   B %.3f%s", measured.live_ms[0], measured.live_ms[1],
+               ab.mode == ab_mode::split ? "   (own side only)" : "");
+   if (measured.measured && measured.measured_pin == ab.pin)
+   {
+      ImGui::Text("Full frame A %.3f   B %.3f   B/A %.2f", measured.full_ms[0], measured.full_ms[1],
+                  measured.full_ms[0] > 0.0 ? measured.full_ms[1] / measured.full_ms[0] : 0.0);
+      ImGui::Text("Difference max %.4f   rms %.5f   %zu pixels", measured.diff.max_error, measured.diff.rms_error,
+                  measured.diff.differing);
+   }
+}
+
+// Switches between the registered shaders.
+void single_quad_app::edit_active_shader()
+{
+   std::vector<std::string> labels;
+   for (const registered_shader& shader : registry.shaders)
+   {
+      labels.push_back(shader_name(shader));
+      if (shader.linking || shader.stale)
+         labels.back() += " (building)";
+      else if (shader.failed && !shader.built.program)
+         labels.back() += " (failed)";
+   }
+   std::vector<const char*> items;
+   for (const std::string& label : labels)
+      items.push_back(label.c_str());
+   int selected = int(registry.active);
+   if (ImGui::Combo("Shader", &selected, items.data(), int(items.size())))
+      select_shader(size_t(selected));
+}
+
+// Switches between permutations of the main program.
+void single_quad_app::edit_permutation()
+{
+   for (define_axis& axis : raymarcher.permutations.axes)
+   {
+      // Combo wants an array of C strings.
+      std::vector<const char*> labels;
+      for (const std::string& label : axis.labels)
+         labels.push_back(label.c_str());
+      const int previous = axis.selected;
+      if (ImGui::Combo(axis.name.c_str(), &axis.selected, labels.data(), int(labels.size())) && !select_main_program())
+         axis.selected = previous;
+   }
+
+   if (spirv_available() && ImGui::Checkbox("SPIR-V", &raymarcher.use_spirv))
+      reloadShaders();
+
+   shader_permutations& permutations = raymarcher.permutations;
+   ImGui::Text("%d of %d variants compiled", int(raymarcher.built_count()), int(permutations.count()));
+   ImGui::SameLine();
+   if (ImGui::Button("Compile all"))
+   {
+      // Fills the cache for the current modes, then comes back.
+      const uint64_t selected = permutations.key();
+      for (uint64_t key = 0; key < permutations.count(); ++key)
+      {
+         permutations.select(key);
+         select_main_program();
+      }
+      permutations.select(selected);
+      select_main_program();
+   }
+}
+
+// Editor for the scene graph parameters.
+bool single_quad_app::edit_scene()
+{
+   static bool too_large = false;
+   static const char* type_names[] = { "sphere", "box", "rounded box", "plane", "union", "smooth union", "translate", "repeat" };
+   bool changed = ImGui::Checkbox("Use BVH", &scene.graph.use_bvh);
+   ImGui::SameLine();
+   ImGui::Text("%d nodes", int(scene.graph.nodes.size()));
+
+   ImGui::BeginChild("nodes", ImVec2(0, 200));
+   ImGuiListClipper clipper(int(scene.graph.nodes.size()));
+   while (clipper.Step())
+   {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      {
+         sdf_node& node = scene.graph.nodes[i];
+         ImGui::PushID(i);
+         const char* name = type_names[int(node.type)];
+         switch (node.type)
+         {
+         case sdf_node_type::sphere:
+         case sdf_node_type::rounded_box:
+         case sdf_node_type::plane:
+            changed |= ImGui::DragFloat4(name, node.params, 0.01f);
+            break;
+         case sdf_node_type::box:
+         case sdf_node_type::translate:
+            changed |= ImGui::DragFloat3(name, node.params, 0.01f);
+            break;
+         case sdf_node_type::smooth_union:
+         case sdf_node_type::repeat:
+            changed |= ImGui::DragFloat(name, node.params, 0.01f, 0.001f, 100.0f);
+            break;
+         case sdf_node_type::union_op:
+            // The clipper needs every row to have the same height.
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("%s (%d children)", name, int(node.children.size()));
+            break;
+         }
+         ImGui::PopID();
+      }
+   }
+   ImGui::EndChild();
+
+   std::vector<int> added;
+   if (ImGui::Button("Add sphere"))
+      added.push_back(scene.graph.add_sphere(vec3(0.4f, 0.1f, 0.3f), 0.1f));
+   ImGui::SameLine();
+   if (ImGui::Button("Add box"))
+      added.push_back(scene.graph.add_translate(vec3(0.4f, 0.0f, -0.4f), scene.graph.add_box(vec3(0.1f))));
+   ImGui::SameLine();
+   if (ImGui::Button("Add 32x32 spheres"))
+   {
+      // Stress test for the BVH: a field of small spheres on the floor. Too
+      // many for SceneParams, so the BVH goes on.
+      scene.graph.use_bvh = true;
+      for (int z = 0; z < 32; ++z)
+         for (int x = 0; x < 32; ++x)
+            added.push_back(scene.graph.add_sphere(vec3(-3.2f + 0.2f * x, -0.15f, -3.2f + 0.2f * z), 0.05f));
+   }
+   if (!added.empty())
+   {
+      if (scene.graph.root < 0 || scene.graph.nodes[scene.graph.root].type != sdf_node_type::union_op)
+         scene.graph.root = scene.graph.add_union(scene.graph.root >= 0 ? std::vector<int>{ scene.graph.root } : std::vector<int>());
+      std::vector<int>& children = scene.graph.nodes[scene.graph.root].children;
+      children.insert(children.end(), added.begin(), added.end());
+      changed = true;
+   }
+   if (changed)
+   {
+      // Turning the BVH on moves spheres and boxes out of SceneParams.
+      if (!scene.graph.use_bvh && !scene.params_fit())
+         scene.graph.use_bvh = true;
+      too_large = !scene.params_fit();
+   }
+   // The last scene that fit stays drawn until this one does.
+   if (too_large)
+      ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Too many parameters outside the BVH for a uniform block");
+   return changed && !too_large;
+}
+
+// Imports a Shadertoy project and lists its passes and inputs.
+void single_quad_app::edit_project()
+{
+   static char path[256];
+   ImGui::InputText("Project JSON", path, sizeof(path));
+   if (ImGui::Button("Import"))
+      project.load(path);
+   if (project.passes.empty())
+      return;
+   ImGui::SameLine();
+   if (ImGui::Button("Close"))
+   {
+      project.unload();
+      return;
+   }
+   ImGui::Text("%s", project.source.name.empty() ? project.path.c_str() : project.source.name.c_str());
+   for (size_t i = 0; i < project.passes.size(); ++i)
+   {
+      const shadertoy_pass& pass = project.source.passes[i];
+      ImGui::BulletText("%s", pass.name.c_str());
+      for (int c = 0; c < texture_cache::channel_count; ++c)
+      {
+         const shadertoy_input& input = pass.inputs[c];
+         if (input.type == shadertoy_input::kind::none)
+            continue;
+         ImGui::SameLine();
+         if (input.type == shadertoy_input::kind::buffer)
+            ImGui::Text(" %d: Buffer %c", c, 'A' + input.buffer);
+         else if (input.type == shadertoy_input::kind::texture && !project.passes[i].textures[c])
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), " %d: %s missing", c, input.path.c_str());
+         else if (input.type == shadertoy_input::kind::texture)
+            ImGui::Text(" %d: Texture", c);
+         else
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), " %d: %s unsupported", c, input.path.c_str());
+      }
+   }
+}
+
+const quad_program* single_quad_app::view_program()
+{
+   if (!project.passes.empty())
+      return nullptr;
+   const registered_shader& shader = registry.shown();
+   if (!is_raymarcher(shader))
+      return shader.built.program ? &shader.built : nullptr;
+   return raymarcher.plain_variant();
+}
+
+static void view_key_callback(GLFWwindow* window, int key, int, int action, int)
+{
+   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+      glfwSetWindowShouldClose(window, GLFW_TRUE);
+   if (key == GLFW_KEY_R && action == GLFW_PRESS)
+      static_cast<single_quad_app*>(glfwGetWindowUserPointer(window))->reloadShaders();
+}
+
+void single_quad_app::edit_views(GLFWwindow* share)
+{
+   static const int sizes[][2] = { { 320, 180 }, { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+   static const char* size_names[] = { "320x180", "640x360", "1280x720", "1920x1080" };
+   static int size = 1;
+   ImGui::Combo("Size", &size, size_names, 4);
+   ImGui::SameLine();
+   if (ImGui::Button("Open view"))
+      views.open(share, sizes[size][0], sizes[size][1], mouse_x, mouse_y, screen_w, screen_h, view_key_callback);
+   if (!views.views.empty())
+      ImGui::Text("Drag in a view to move its camera, Escape closes it.");
+   for (size_t i = 0; i < views.views.size(); ++i)
+   {
+      const view_window& view = views.views[i];
+      ImGui::PushID(int(i));
+      ImGui::Text("%dx%d, mouse %.0f, %.0f", view.width, view.height, view.mouse_x, view.mouse_y);
+      ImGui::SameLine();
+      if (ImGui::SmallButton("Close"))
+         glfwSetWindowShouldClose(view.window, GLFW_TRUE);
+      ImGui::PopID();
+   }
+}
+
+void single_quad_app::edit_latency()
+{
+   ImGui::Checkbox("Probe", &probing_latency);
+   ImGui::SameLine();
+   ImGui::Checkbox("Sample input late", &late_input);
+   const render_report& report = reports.read_buffer();
+   if (!report.latency.probing)
+      return;
+   const latency_summary& gpu_done = report.latency.gpu_done;
+   const latency_summary& swapped = report.latency.swapped;
+   ImGui::Text("Input to GPU done  median %.2f   p95 %.2f   max %.2f ms", gpu_done.median, gpu_done.p95, gpu_done.max);
+   ImGui::Text("Input to swap      median %.2f   p95 %.2f   max %.2f ms", swapped.median, swapped.p95, swapped.max);
+   const std::vector<float>& recent = report.latency.recent_swapped;
+   if (!recent.empty())
+      ImGui::PlotLines("Input to swap", recent.data(), int(recent.size()), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+}
+
+void single_quad_app::update_drag(double x, double y)
+{
+   int window_w, window_h, fb_w, fb_h;
+   glfwGetWindowSize(window, &window_w, &window_h);
+   glfwGetFramebufferSize(window, &fb_w, &fb_h);
+   const float px = window_w ? float(x) * fb_w / window_w : float(x);
+   const float py = window_h ? fb_h - float(y) * fb_h / window_h : -float(y);
+   const bool down =
+      glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !ImGui::GetIO().WantCaptureMouse;
+   if (down)
+   {
+      if (!ui_dragging)
+      {
+         ui_drag[2] = px;
+         ui_drag[3] = py;
+      }
+      ui_drag[0] = px;
+      ui_drag[1] = py;
+   }
+   else if (ui_dragging)
+   {
+      ui_drag[2] = -ui_drag[2];
+      ui_drag[3] = -ui_drag[3];
+   }
+   ui_dragging = down;
+}
+
+// Records the inputs of the drawn frames to a file replayed by --replay.
+void single_quad_app::edit_recording()
+{
+   static char path[256] = "session.sdfi";
+   if (recording.path.empty())
+   {
+      ImGui::InputText("Log file", path, sizeof(path));
+      if (ImGui::Button("Record"))
+         recording.start(path);
+      return;
+   }
+   if (ImGui::Button("Stop"))
+   {
+      recording.stop();
+      return;
    }
+   const recording_status& status = reports.read_buffer().recording;
+   const bool started = status.session == recording.session;
+   ImGui::SameLine();
+   if (started && !status.open)
+      ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Cannot write %s", recording.path.c_str());
+   else
+      ImGui::Text("%d frames recorded", started ? int(status.frames) : 0);
 }
 
 static void error_callback(int error, const char* description)
@@ -78,7 +604,7 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
       glfwSetWindowShouldClose(window, GLFW_TRUE);
    if (key == GLFW_KEY_R && action == GLFW_PRESS)
-      reloadShaders();
+      static_cast<single_quad_app*>(glfwGetWindowUserPointer(window))->reloadShaders();
    ImGui_ImplGlfwGL3_KeyCallback(window, key, scancode, action, mods);
 }
 
@@ -92,118 +618,468 @@ single_quad_app::~single_quad_app()
 
 bool single_quad_app::init()
 {
+   startup_timer.reset();
+
+   // Mapping the shader files and baking the font atlas need no GL context,
+   // so overlap them with window and context creation. The mappings are
+   // cached, so reloadShaders() below reuses them.
+   auto sources_ready = std::async(std::launch::async, [this] {
+      scoped_phase phase(startup_timer, "shader read");
+      registry.discover();
+      for (const registered_shader& shader : registry.shaders)
+         map_shader_file(shader.path.c_str());
+      return map_shader_file(vertex_shader_path) && map_shader_file(fragment_shader_path) &&
+             map_shader_file(interleave_shader_path);
+   });
+   auto fonts_ready = std::async(std::launch::async, [this] {
+      scoped_phase phase(startup_timer, "font atlas");
+      unsigned char* pixels;
+      int width, height;
+      ImGui::GetIO().Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+   });
+
    glfwSetErrorCallback(error_callback);
 
-   if (!glfwInit())
    {
-      fprintf(stderr, "Failed to initialize GLFW3\n");
-      return false;
+      scoped_phase phase(startup_timer, "glfw init");
+      if (!glfwInit())
+      {
+         fprintf(stderr, "Failed to initialize GLFW3\n");
+         return false;
+      }
    }
 
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
-   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+   {
+      scoped_phase phase(startup_timer, "window creation");
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+      glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+      glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+      glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+      // The benchmark, replays and corpus runs render offscreen.
+      glfwWindowHint(GLFW_VISIBLE, benchmark || replay_path || corpus_dir ? GLFW_FALSE : GLFW_TRUE);
+
+      window = glfwCreateWindow(screen_w, screen_h, "SDF", nullptr, nullptr);
+
+      if (!window)
+      {
+         fprintf(stderr, "Failed to initialize GLFW3 window\n");
+         return false;
+      }
+
+      glfwSetWindowUserPointer(window, this);
+      glfwSetKeyCallback(window, key_callback);
 
-   window = glfwCreateWindow(screen_w, screen_h, "SDF", nullptr, nullptr);
+      glfwMakeContextCurrent(window);
+   }
 
-   if (!window)
    {
-      fprintf(stderr, "Failed to initialize GLFW3 window\n");
-      return false;
+      scoped_phase phase(startup_timer, "glew init");
+      glewExperimental = GL_TRUE;
+      glewInit();
+      glfwSwapInterval(1);
+      registry.parallel_compile = GLEW_KHR_parallel_shader_compile;
    }
 
-   glfwSetKeyCallback(window, key_callback);
+   {
+      scoped_phase phase(startup_timer, "imgui setup");
+      // Setup ImGui binding
+      ImGui_ImplGlfwGL3_Init(window, false);
+      // Setup imgui callbacks for keyboard/mouse input
+      glfwSetMouseButtonCallback(window, ImGui_ImplGlfwGL3_MouseButtonCallback);
+      glfwSetScrollCallback(window, ImGui_ImplGlfwGL3_ScrollCallback);
+      glfwSetCharCallback(window, ImGui_ImplGlfwGL3_CharCallback);
+      ImGui::StyleColorsLight();
+   }
 
-   glfwMakeContextCurrent(window);
-   glewExperimental = GL_TRUE;
-   glewInit();
-   glfwSwapInterval(1);
-
-   // Setup ImGui binding
-   ImGui_ImplGlfwGL3_Init(window, false);
-   // Setup imgui callbacks for keyboard/mouse input
-   glfwSetMouseButtonCallback(window, ImGui_ImplGlfwGL3_MouseButtonCallback);
-   glfwSetScrollCallback(window, ImGui_ImplGlfwGL3_ScrollCallback);
-   glfwSetCharCallback(window, ImGui_ImplGlfwGL3_CharCallback);
-   ImGui::StyleColorsLight();
-
-   glGenVertexArrays(1, &gl_state.vao);
-   glBindVertexArray(gl_state.vao);
-
-   glGenBuffers(1, &gl_state.vbo);
-   glBindBuffer(GL_ARRAY_BUFFER, gl_state.vbo);
-   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-   reloadShaders();
-   glUseProgram(gl_state.program);
-   gl_state.pos_attrib = glGetAttribLocation(gl_state.program, "position");
-   glVertexAttribPointer(gl_state.pos_attrib, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (void*)0);
-   glEnableVertexAttribArray(gl_state.pos_attrib);
+   {
+      // The atlas is already baked, this only uploads it.
+      fonts_ready.wait();
+      scoped_phase phase(startup_timer, "imgui device objects");
+      ImGui_ImplGlfwGL3_CreateDeviceObjects();
+   }
+
+   {
+      scoped_phase phase(startup_timer, "buffers");
+      // Core profiles need a vertex array bound to draw, even with no
+      // attributes.
+      glGenVertexArrays(1, &vao);
+      glBindVertexArray(vao);
+
+      scene.init();
+      channels.init();
+      compute.init();
+      cone_pass.init();
+      interleave_pass.init();
+      temporal_pass.init();
+   }
+
+   {
+      sources_ready.wait();
+      scoped_phase phase(startup_timer, "shader compile");
+      reloadShaders();
+      size_t initial = registry.find(shader ? shader : fragment_shader_path);
+      if (initial == registry.shaders.size())
+      {
+         fprintf(stderr, "Unknown shader %s, available are:\n", shader);
+         for (const registered_shader& registered : registry.shaders)
+            fprintf(stderr, "  %s\n", shader_name(registered));
+         return false;
+      }
+      select_shader(initial);
+      if (project_path && !project.load(project_path))
+         return false;
+   }
 
    return true;
 }
 
 void single_quad_app::run()
 {
-   GLfloat res[2] = { GLfloat(screen_w), GLfloat(screen_h) };
    bool show_sdf_properties_window = true;
-   ImVec4 object_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+   const double first_frame_start = startup_timer.now_ms();
+   double last_reload_poll = 0.0;
+
+   // The window's context moves to the render thread. This thread keeps a
+   // hidden one sharing its objects for the GL work edits do.
+   glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+   GLFWwindow* ui_window = glfwCreateWindow(1, 1, "SDF UI", nullptr, window);
+   glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+   if (!ui_window)
+   {
+      fprintf(stderr, "Failed to create the UI context\n");
+      return;
+   }
+   // View windows take its user pointer for their key callback.
+   glfwSetWindowUserPointer(ui_window, this);
+   glfwMakeContextCurrent(ui_window);
+   // The render thread draws the snapshots taken below.
+   ImGui::GetIO().RenderDrawListsFn = nullptr;
+   render_quit = false;
+   probing_latency = latency_report;
+   if (record_path)
+      recording.start(record_path);
+   begin_render_thread();
+   std::thread render_thread(&single_quad_app::render_loop, this, first_frame_start);
+
    while (!glfwWindowShouldClose(window))
    {
+      glfwPollEvents();
       system_ticker.tick();
+      if (reload_on_save && system_ticker.last_time - last_reload_poll > reload_poll_interval)
+      {
+         last_reload_poll = system_ticker.last_time;
+         if (shader_files_changed())
+            reloadShaders();
+      }
       glfwGetCursorPos(window, &mouse_x, &mouse_y);
+      const double input_time = glfwGetTime();
+      update_drag(mouse_x, mouse_y);
+      latest_input.publish(mouse_x, mouse_y, input_time);
       glfwGetFramebufferSize(window, &screen_w, &screen_h);
+      reports.update();
+      release_retired();
 
       ImGui_ImplGlfwGL3_NewFrame();
-      glViewport(0, 0, screen_w, screen_h);
-
-      glClear(GL_COLOR_BUFFER_BIT);
-      draw_quad();
+      registry.update();
+      const double time = glfwGetTime();
+      channels.update(time);
 
       {
          ImGui::Begin("SDF Properties", &show_sdf_properties_window);
-         static float shininess = 0.0f;
-         if (ImGui::SliderFloat("float", &shininess, 1.0f, 80.0f))
-            glUniform1f(gl_state.shininess_uniform, shininess);
+         edit_active_shader();
+         ImGui::SliderFloat("float", &shininess, 1.0f, 80.0f);
          ImGui::Text("Change the color of objects"); // Some text (you can use a format string too)
-         if (ImGui::ColorEdit3("Object color", (float*)&object_color))
-            glUniform4fv(gl_state.color_uniform, 1, (float*)&object_color);
+         ImGui::ColorEdit3("Object color", object_color);
          ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+         ImGui::Text("Render average %.3f ms/frame", render_frame_ms.load());
+         if (ImGui::CollapsingHeader("Scene") && edit_scene())
+         {
+            // Numeric edits only touch the uniform buffer, new nodes need a new sceneSDF.
+            if (scene.graph.topology_hash() != scene.topology)
+               reloadShaders();
+            else
+            {
+               invalidate_history();
+               scene.upload_params();
+            }
+         }
+         if (ImGui::CollapsingHeader("Baked volume"))
+            edit_volume();
+         if (ImGui::CollapsingHeader("Shader variant"))
+            edit_permutation();
+         if (ImGui::CollapsingHeader("A/B comparison"))
+            edit_ab();
+         if (ImGui::CollapsingHeader("Shadertoy project"))
+            edit_project();
+         if (ImGui::CollapsingHeader("Channels"))
+            edit_channels();
+         if (ImGui::CollapsingHeader("Video"))
+            edit_video();
+         if (ImGui::CollapsingHeader("Latency"))
+            edit_latency();
+         if (ImGui::CollapsingHeader("Recording"))
+            edit_recording();
+         if (ImGui::CollapsingHeader("Views"))
+            edit_views(ui_window);
+         raymarch_modes& modes = raymarcher.modes;
+         if (compute_available())
+         {
+            static const char* backends[] = { "Fragment", "Compute, 8x8 tiles", "Compute, persistent" };
+            int selected = int(modes.backend);
+            if (ImGui::Combo("Backend", &selected, backends, 3))
+            {
+               modes.backend = raymarch_backend(selected);
+               // The other modes add fragment passes around the main one.
+               if (modes.backend != raymarch_backend::fragment)
+               {
+                  modes.cone_prepass = false;
+                  modes.temporal = false;
+                  modes.interleave_cells = 1;
+               }
+               change_modes();
+            }
+            if (modes.backend == raymarch_backend::compute_persistent)
+               ImGui::SliderInt("Work groups", &modes.persistent_groups, 1, 4096);
+         }
+         if (ImGui::Checkbox("Cone pre-pass", &modes.cone_prepass))
+         {
+            if (modes.cone_prepass)
+               modes.backend = raymarch_backend::fragment;
+            change_modes();
+         }
+         static const char* interleave_modes[] = { "Off", "Checkerboard", "Quarter" };
+         int interleave_mode = modes.interleave_cells == 4 ? 2 : modes.interleave_cells - 1;
+         if (ImGui::Combo("Interleave", &interleave_mode, interleave_modes, 3))
+         {
+            // Both reuse earlier frames through their own targets.
+            modes.interleave_cells = interleave_mode == 2 ? 4 : interleave_mode + 1;
+            if (modes.interleave_cells > 1)
+            {
+               modes.temporal = false;
+               modes.backend = raymarch_backend::fragment;
+            }
+            change_modes();
+         }
+         if (ImGui::Checkbox("Temporal reprojection", &modes.temporal))
+         {
+            if (modes.temporal)
+            {
+               modes.interleave_cells = 1;
+               modes.backend = raymarch_backend::fragment;
+            }
+            change_modes();
+         }
+         if (modes.temporal)
+         {
+            ImGui::SameLine();
+            ImGui::SliderFloat("History", &modes.history_blend, 0.0f, 0.95f);
+         }
+         if (modes.cone_prepass)
+         {
+            ImGui::SameLine();
+            ImGui::SliderInt("Scale", &modes.cone_prepass_scale, 2, 16);
+         }
+         ImGui::Checkbox("Reload on save", &reload_on_save);
          ImGui::End();
       }
+      show_shader_errors();
 
       ImGui::Render();
+      views.update();
 
-      glfwSwapBuffers(window);
-      glfwPollEvents();
+      frame_state& frame = frames.write_buffer();
+      frame.values = { screen_w, screen_h, mouse_x, mouse_y, shininess,
+                       { object_color[0], object_color[1], object_color[2], object_color[3] }, time, input_time };
+      std::copy(ui_drag, ui_drag + 4, frame.values.drag);
+      take_settings(frame.settings);
+      frame.sequence = next_frame_sequence();
+      const ImGuiIO& io = ImGui::GetIO();
+      frame.ui.capture(ImGui::GetDrawData(), io.DisplaySize, io.DisplayFramebufferScale);
+      // Still set if the render thread skipped the frame last published from
+      // this buffer.
+      if (frame.uploads)
+         glDeleteSync(frame.uploads);
+      frame.uploads = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glFlush();
+      frames.publish();
 
       if (system_ticker.delta < 1.0 / 60.0)
       {
          const unsigned long time_to_delay = long(((1.f / 60.0) - system_ticker.delta) * 1000.0);
-         std::this_thread::sleep_for(std::chrono::milliseconds(time_to_delay));
+         if (late_input)
+            latest_input.poll_until(window, glfwGetTime() + time_to_delay / 1000.0);
+         else
+            std::this_thread::sleep_for(std::chrono::milliseconds(time_to_delay));
+      }
+   }
+
+   render_quit = true;
+   render_thread.join();
+   end_render_thread();
+   glfwMakeContextCurrent(window);
+   glfwDestroyWindow(ui_window);
+}
+
+void single_quad_app::render_loop(double first_frame_start)
+{
+   glfwMakeContextCurrent(window);
+   bool first_frame = true;
+   double last_frame = glfwGetTime();
+   GLsync frame_done = nullptr;
+   while (!render_quit)
+   {
+      // Wait for the last frame, so submitting the next one never blocks on a
+      // full command queue.
+      if (frame_done)
+      {
+         glClientWaitSync(frame_done, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+         glDeleteSync(frame_done);
+         frame_done = nullptr;
+      }
+      const bool fresh = frames.update();
+      frame_state& frame = frames.read_buffer();
+      if (!frame.ui.valid())
+      {
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         continue;
+      }
+      // Frames published before this one are never drawn again, so the UI
+      // thread may release what only they named.
+      frame_taken(frame.sequence);
+      if (frame.uploads)
+      {
+         // Makes what the UI context uploaded before publishing the frame
+         // visible here without blocking this thread.
+         glWaitSync(frame.uploads, 0, GL_TIMEOUT_IGNORED);
+         glDeleteSync(frame.uploads);
+         frame.uploads = nullptr;
+      }
+
+      const render_settings& settings = frame.settings;
+      latency.set_probing(settings.probe_latency);
+      frame_values values = frame.values;
+      values.repeat = !fresh;
+      if (settings.late_input)
+         latest_input.take(values);
+      // What is drawn rather than what the UI thread published: frames it
+      // published meanwhile are skipped, the last one may be drawn again and
+      // late input replaces the mouse.
+      recorder.update(settings.recording);
+      if (recorder.is_open())
+         recorder.write(values, settings.program_key, settings.interleave_cells, settings.cone_prepass_scale,
+                        settings.history_blend);
+      scene.bind();
+      glViewport(0, 0, values.width, values.height);
+      glClear(GL_COLOR_BUFFER_BIT);
+      draw_quad(values, settings);
+      frame.ui.render();
+      latency.frame_submitted(values.input_time);
+      view_pass.draw(window, settings.views, settings.view_program, scene, settings.channels, values);
+      ab_pass.finish_measurement();
+      frame_done = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glfwSwapBuffers(window);
+      latency.frame_swapped(glfwGetTime());
+      publish_report();
+
+      const double now = glfwGetTime();
+      const double ms = (now - last_frame) * 1000.0;
+      last_frame = now;
+      const double average = render_frame_ms.load();
+      render_frame_ms = average > 0.0 ? average + (ms - average) * 0.05 : ms;
+      if (first_frame)
+      {
+         first_frame = false;
+         if (startup_profile)
+         {
+            startup_timer.record("first frame", first_frame_start, startup_timer.now_ms());
+            startup_timer.report(stdout);
+         }
       }
    }
+   if (frame_done)
+      glDeleteSync(frame_done);
+   recorder.close();
+   latency.finish(latency_report);
+   glfwMakeContextCurrent(nullptr);
 }
 
 void single_quad_app::destroy()
 {
-   glDeleteProgram(gl_state.program);
-   glDeleteBuffers(1, &gl_state.vbo);
-   glDeleteVertexArrays(1, &gl_state.vao);
+   views.destroy();
+   view_pass.destroy();
+   raymarcher.destroy();
+   registry.destroy();
+   project.unload();
+   project_buffers.destroy();
+   ab.destroy();
+   ab_pass.destroy();
+   channels.destroy();
+   cone_pass.destroy();
+   compute.destroy();
+   interleave_pass.destroy();
+   temporal_pass.destroy();
+   scene.destroy();
+   glDeleteVertexArrays(1, &vao);
    ImGui_ImplGlfwGL3_Shutdown();
    glfwDestroyWindow(window);
    glfwTerminate();
 }
 
-void single_quad_app::draw_quad()
+void single_quad_app::draw_quad(const frame_values& frame, const render_settings& settings)
 {
-   glUniform1f(gl_state.elapsed_time_uniform, GLfloat(glfwGetTime()));
-   GLfloat res[2] = { GLfloat(screen_w), GLfloat(screen_h) };
-   glUniform2fv(gl_state.resolution_uniform, 1, res);
-   float mouse_pos[2] = { float(mouse_x), float(mouse_y) };
-   glUniform2fv(gl_state.mouse_uniform, 1, mouse_pos);
-   glUseProgram(gl_state.program);
-   glBindVertexArray(gl_state.vao);
-   glDrawArrays(GL_TRIANGLES, 0, 6);
+   begin_frame_uniforms(frame.time, frame.drag, frame.repeat);
+   if (settings.history_generation != drawn_history_generation)
+   {
+      discard_history();
+      drawn_history_generation = settings.history_generation;
+   }
+   glBindVertexArray(vao);
+   settings.channels.bind();
+   project_buffers.update(settings.project_generation);
+   if (!settings.project.empty())
+   {
+      project_buffers.draw(settings.project, frame, output_framebuffer);
+      return;
+   }
+   ab_pass.set_mode(settings.ab);
+   if (settings.ab != ab_mode::off)
+   {
+      ab_pass.draw(settings.shown, settings.ab_pinned, settings.ab_split, settings.ab_pin, frame, output_framebuffer);
+      return;
+   }
+   const quad_program& main = settings.shown;
+   if (!settings.raymarcher)
+   {
+      if (main.program)
+      {
+         glUseProgram(main.program);
+         set_frame_uniforms(main, frame.width, frame.height, frame.mouse_x, frame.mouse_y, frame.shininess,
+                            frame.object_color);
+         draw_fullscreen();
+      }
+      return;
+   }
+   const quad_program& prepass = settings.prepass;
+   const int scale = settings.cone_prepass_scale;
+   if (settings.cone_prepass && prepass.program)
+      cone_pass.draw(prepass, scale, frame, output_framebuffer);
+   glUseProgram(main.program);
+   set_frame_uniforms(main, frame.width, frame.height, frame.mouse_x, frame.mouse_y, frame.shininess,
+                      frame.object_color);
+   glUniform1i(main.start_depth_scale_uniform, scale);
+   if (main.backend != raymarch_backend::fragment)
+   {
+      compute.draw(main, frame.width, frame.height, settings.persistent_groups, output_framebuffer);
+      return;
+   }
+   if (settings.interleave_cells > 1 && settings.interleave_resolve.program)
+   {
+      interleave_pass.draw(main, settings.interleave_mask, settings.interleave_resolve, settings.interleave_cells,
+                           frame, output_framebuffer);
+      return;
+   }
+   if (settings.temporal)
+      temporal_pass.draw(main, settings.history_blend, frame, output_framebuffer);
+   else
+      draw_fullscreen();
 }
@@ -3,7 +3,28 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <stddef.h>
+
+#include <atomic>
+
+#include "ab_comparison.h"
 #include "clock.h"
+#include "compute_raymarch.h"
+#include "frame_values.h"
+#include "input_latency.h"
+#include "input_log.h"
+#include "project_passes.h"
+#include "quad_program.h"
+#include "raymarch_passes.h"
+#include "raymarcher_programs.h"
+#include "render_handoff.h"
+#include "render_target.h"
+#include "scene_inputs.h"
+#include "session_recording.h"
+#include "shader_channels.h"
+#include "shader_registry.h"
+#include "triple_buffer.h"
+#include "view_windows.h"
 
 class single_quad_app
 {
@@ -12,14 +33,183 @@ public:
    ~single_quad_app();
 
    bool init();
+   // Handle input and the UI on this thread while a render thread draws.
    void run();
    void destroy();
-   void draw_quad();
+   void draw_quad(const frame_values& frame, const render_settings& settings);
+   // Time every shader variant offscreen and print a comparison. Returns
+   // false if no variant could be built.
+   bool run_benchmark();
+   // Draw every frame of the input log at replay_path offscreen, with the
+   // recorded sizes, times, mouse positions and settings, and print their
+   // GPU times. Returns false if the log cannot be replayed.
+   bool run_replay();
+   // Compile every shader of corpus_dir on corpus_threads shared contexts,
+   // time them one at a time and write a table to corpus_out. Returns false
+   // if the corpus could not be run; failing shaders are listed in the table.
+   bool run_corpus();
+   // Body of the render thread, drawing the newest frame the UI thread
+   // published until run() ends. It only reads what the frame hands it.
+   void render_loop(double first_frame_start);
+   // Build the scene's raymarcher and the registered shaders again from
+   // their sources.
+   void reloadShaders();
 
    int screen_w = 1280.f;
    int screen_h = 720.f;
    double mouse_x = 0;
    double mouse_y = 0;
+   float shininess = 10.0f;
+   float object_color[4] = { 0.45f, 0.55f, 0.60f, 1.00f };
    GLFWwindow* window;
    ticker system_ticker;
+
+   // File name of the fragment shader shown first, null for the raymarcher.
+   const char* shader = nullptr;
+
+   // Print a per-phase breakdown of init() and the first frame.
+   bool startup_profile = false;
+   phase_timer startup_timer;
+
+   // Run run_benchmark() in a hidden window instead of the interactive loop.
+   bool benchmark = false;
+
+   // Shadertoy project JSON shown instead of the first shader, null for none.
+   const char* project_path = nullptr;
+
+   // Record every UI frame's inputs to this file, null for none.
+   const char* record_path = nullptr;
+   // Run run_replay() on this input log in a hidden window, null for none.
+   const char* replay_path = nullptr;
+
+   // Run run_corpus() on this directory in hidden windows, null for none.
+   const char* corpus_dir = nullptr;
+   // File the corpus table is written to, null for stdout.
+   const char* corpus_out = nullptr;
+   const char* corpus_resolutions = "640x360,1280x720,1920x1080";
+   // Contexts the corpus is compiled on, 0 for one per hardware thread.
+   // Timing always uses a single context.
+   int corpus_threads = 0;
+
+   // Start with the latency probe on and print its results at exit.
+   bool latency_report = false;
+   int benchmark_frames = 100;
+
+private:
+   void invalidate_history();
+   void discard_history();
+   // Draw registry.shaders[index] from the next frame on.
+   void select_shader(size_t index);
+   // Program drawn by the raymarcher's pipeline or the active registered
+   // shader.
+   const quad_program& shown_program() const;
+   // Build what is shown again as B of the A/B comparison.
+   bool pin_ab();
+   // Select the main program for the permutation and rendering modes, see
+   // raymarcher_programs::select().
+   bool select_main_program();
+   void change_modes();
+   // Program the views draw: the active registered shader, or for the
+   // raymarcher its variant for the selected permutation without the
+   // rendering modes, whose passes keep per-window targets. Null if there is
+   // nothing to draw or a project is shown.
+   const quad_program* view_program();
+   // Select the permutation and rendering modes a frame was recorded with.
+   // Returns false if they cannot be built here.
+   bool apply_recorded_settings(const recorded_frame& frame);
+   // Draw or dispatch prog over target, as it was built. prog is bound with
+   // its frame uniforms set and target is bound for drawing.
+   void run_raymarcher(const quad_program& prog, const render_target& target) const;
+
+   // Copy what the render thread draws with into out. Buffers of out are
+   // reused, so this does not allocate once they are big enough.
+   void take_settings(render_settings& out);
+   // Hand the UI thread what the render thread measured.
+   void publish_report();
+
+   // Follow the left button for Shadertoy's iMouse. Clicks on the UI do not
+   // count.
+   void update_drag(double x, double y);
+
+   // Sections of the properties window.
+   void edit_active_shader();
+   // Returns true if any value of the scene changed.
+   bool edit_scene();
+   void edit_volume();
+   void edit_permutation();
+   void edit_ab();
+   void edit_project();
+   void edit_channels();
+   void edit_video();
+   void edit_latency();
+   void edit_recording();
+   // share is the context current on this thread.
+   void edit_views(GLFWwindow* share);
+
+   // Empty, the vertex shader makes up the positions from gl_VertexID.
+   GLuint vao = 0;
+
+   // Reload the shaders once a file they were built from is saved.
+   bool reload_on_save = true;
+
+   scene_inputs scene;
+   raymarcher_programs raymarcher{ scene };
+   shader_registry registry;
+   compute_raymarcher compute;
+
+   // Images and video sampled by shaders as iChannel0 to iChannel3.
+   shader_channels channels;
+
+   // Passes the rendering modes add around the main program.
+   cone_prepass cone_pass;
+   temporal_reprojection temporal_pass;
+   interleaved_shading interleave_pass;
+
+   // Scene, shader or size changes make the history meaningless. The UI
+   // thread counts them in history_generation; the render thread drops its
+   // history once it draws a frame of a newer generation.
+   unsigned history_generation = 0;
+   unsigned drawn_history_generation = 0;
+
+   // Live comparison of the shown program with a pinned build. The render
+   // thread's side draws and times both.
+   ab_comparison ab;
+   ab_drawing ab_pass;
+
+   // Shadertoy project drawn instead of the active shader while it has
+   // passes, and the render thread's buffers of it.
+   project_passes project;
+   project_drawing project_buffers;
+
+   // Views of the main window's image, and the render thread's side of them.
+   view_windows views;
+   view_drawing view_pass;
+
+   // Measure input-to-display latency on the render thread.
+   bool probing_latency = false;
+   latency_monitor latency;
+   // Sample the cursor until just before the render thread draws instead of
+   // once per UI frame.
+   bool late_input = false;
+   input_sampler latest_input;
+
+   // Input log the UI thread asked to record to, and the render thread's
+   // side writing every frame it draws.
+   recording_request recording;
+   session_recorder recorder;
+
+   // Shadertoy's iMouse as the UI thread last saw it, see frame_values::drag.
+   float ui_drag[4] = {};
+   bool ui_dragging = false;
+
+   // Framebuffer draw_quad() finishes in; replays draw offscreen.
+   GLuint output_framebuffer = 0;
+
+   std::atomic<bool> render_quit{ false };
+   // Moving average of the render thread's frame time.
+   std::atomic<double> render_frame_ms{ 0.0 };
+   // Frames the UI thread publishes for the render thread, and what the
+   // render thread measured, for the properties window.
+   triple_buffer<frame_state> frames;
+   triple_buffer<render_report> reports;
 };
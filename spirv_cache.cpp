@@ -0,0 +1,222 @@
+#include "spirv_cache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <mutex>
+
+#ifdef USE_SPIRV
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+#include <glslang/build_info.h>
+#endif
+
+const char* spirv_cache_dir = "shader_cache";
+
+namespace {
+   // #define names of raymarch.glsl's constant_id declarations.
+   const struct
+   {
+      const char* name;
+      GLuint id;
+      bool is_float;
+   } spec_constants[] = {
+      { "STEPS", 0, false },
+      { "EPSILON", 1, true },
+   };
+}
+
+#ifdef USE_SPIRV
+namespace {
+   // Bump when the way modules are produced changes.
+   const uint64_t cache_format = 1;
+   const uint32_t spirv_magic = 0x07230203;
+
+   uint64_t hash_sources(GLenum type, const shader_source_list& sources)
+   {
+      uint64_t hash = 0xcbf29ce484222325ull;
+      auto mix = [&hash](const void* data, size_t len) {
+         const unsigned char* bytes = static_cast<const unsigned char*>(data);
+         for (size_t i = 0; i < len; ++i)
+         {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+         }
+      };
+      const uint64_t version[] = { cache_format, GLSLANG_VERSION_MAJOR, GLSLANG_VERSION_MINOR, GLSLANG_VERSION_PATCH, type };
+      mix(version, sizeof(version));
+      for (GLsizei i = 0; i < sources.count(); ++i)
+         mix(sources.strings[i], size_t(sources.lengths[i]));
+      return hash;
+   }
+
+   std::string cache_path(uint64_t hash)
+   {
+      char name[32];
+      snprintf(name, sizeof(name), "/%016llx.spv", (unsigned long long)hash);
+      return spirv_cache_dir + std::string(name);
+   }
+
+   bool load_module(const std::string& path, std::vector<unsigned>& words)
+   {
+      FILE* file = fopen(path.c_str(), "rb");
+      if (!file)
+         return false;
+      fseek(file, 0, SEEK_END);
+      const long size = ftell(file);
+      fseek(file, 0, SEEK_SET);
+      bool ok = size >= 20 && size % 4 == 0;
+      if (ok)
+      {
+         words.resize(size / 4);
+         ok = fread(words.data(), 4, words.size(), file) == words.size() && words[0] == spirv_magic;
+      }
+      fclose(file);
+      return ok;
+   }
+
+   // Written under a temporary name first so a concurrent reader never sees
+   // half a module.
+   void save_module(const std::string& path, const std::vector<unsigned>& words)
+   {
+      mkdir(spirv_cache_dir, 0755);
+      const std::string temporary = path + ".tmp";
+      FILE* file = fopen(temporary.c_str(), "wb");
+      if (!file)
+      {
+         fprintf(stderr, "Failed to write %s\n", temporary.c_str());
+         return;
+      }
+      const bool ok = fwrite(words.data(), 4, words.size(), file) == words.size();
+      fclose(file);
+      if (!ok || rename(temporary.c_str(), path.c_str()) != 0)
+      {
+         fprintf(stderr, "Failed to write %s\n", path.c_str());
+         remove(temporary.c_str());
+      }
+   }
+
+   bool compile_module(GLenum type, const shader_source_list& sources, std::vector<unsigned>& words)
+   {
+      static std::once_flag initialized;
+      std::call_once(initialized, [] { glslang::InitializeProcess(); });
+
+      const EShLanguage stage = type == GL_VERTEX_SHADER ? EShLangVertex : EShLangFragment;
+      glslang::TShader shader(stage);
+      shader.setStringsWithLengths(sources.strings.data(), sources.lengths.data(), int(sources.count()));
+      shader.setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientOpenGL, 100);
+      shader.setEnvClient(glslang::EShClientOpenGL, glslang::EShTargetOpenGL_450);
+      shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+      // SPIR-V has no name based binding, so everything gets a location here.
+      shader.setAutoMapLocations(true);
+      shader.setAutoMapBindings(true);
+      const EShMessages messages = EShMessages(EShMsgSpvRules);
+      if (!shader.parse(GetDefaultResources(), 410, false, messages))
+      {
+         fprintf(stderr, "Error with SPIR-V shader %s\n", shader.getInfoLog());
+         return false;
+      }
+      glslang::TProgram program;
+      program.addShader(&shader);
+      if (!program.link(messages) || !program.mapIO())
+      {
+         fprintf(stderr, "Error with SPIR-V shader %s\n", program.getInfoLog());
+         return false;
+      }
+      glslang::GlslangToSpv(*program.getIntermediate(stage), words);
+      return true;
+   }
+}
+#endif
+
+bool spirv_available()
+{
+#ifdef USE_SPIRV
+   return GLEW_ARB_gl_spirv;
+#else
+   return false;
+#endif
+}
+
+std::string extract_spec_constants(const char* prelude, std::vector<spirv_constant>& constants)
+{
+   constants.clear();
+   std::string kept;
+   if (!prelude)
+      return kept;
+   for (const char* line = prelude; *line;)
+   {
+      const char* end = strchr(line, '\n');
+      const size_t len = end ? size_t(end - line) : strlen(line);
+      const std::string text(line, len);
+      bool extracted = false;
+      for (const auto& constant : spec_constants)
+      {
+         const std::string define = std::string("#define ") + constant.name + " ";
+         if (text.compare(0, define.size(), define) != 0)
+            continue;
+         const char* value = text.c_str() + define.size();
+         GLuint bits;
+         if (constant.is_float)
+         {
+            const float f = strtof(value, nullptr);
+            memcpy(&bits, &f, sizeof(bits));
+         }
+         else
+            bits = GLuint(strtol(value, nullptr, 10));
+         constants.push_back({ constant.id, bits });
+         extracted = true;
+      }
+      if (!extracted)
+         kept += text + "\n";
+      line += len + (end ? 1 : 0);
+   }
+   return kept;
+}
+
+GLuint compile_spirv_shader(GLenum type, const shader_source_list& sources,
+                            const std::vector<spirv_constant>& constants)
+{
+#ifdef USE_SPIRV
+   const std::string path = cache_path(hash_sources(type, sources));
+   std::vector<unsigned> words;
+   if (!load_module(path, words))
+   {
+      if (!compile_module(type, sources, words))
+         return 0;
+      save_module(path, words);
+   }
+
+   GLuint shader = glCreateShader(type);
+   glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, words.data(), GLsizei(words.size() * 4));
+   std::vector<GLuint> ids, values;
+   for (const spirv_constant& constant : constants)
+   {
+      ids.push_back(constant.id);
+      values.push_back(constant.value);
+   }
+   glSpecializeShaderARB(shader, "main", GLuint(ids.size()), ids.data(), values.data());
+   GLint success = 0;
+   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+   if (success == GL_FALSE)
+   {
+      GLint lsize = 0;
+      glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &lsize);
+      std::vector<GLchar> log(lsize + 1);
+      glGetShaderInfoLog(shader, lsize, &lsize, log.data());
+      fprintf(stderr, "Error specializing %s: %s\n", path.c_str(), log.data());
+      glDeleteShader(shader);
+      return 0;
+   }
+   return shader;
+#else
+   (void)type;
+   (void)sources;
+   (void)constants;
+   return 0;
+#endif
+}
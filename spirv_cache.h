@@ -0,0 +1,33 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "shader_source.h"
+
+// Directory holding compiled modules, named by the hash of their sources.
+extern const char* spirv_cache_dir;
+
+// Value of a layout(constant_id) constant; floats are passed as their bits.
+struct spirv_constant
+{
+   GLuint id;
+   GLuint value;
+};
+
+// True if built with USE_SPIRV and the context supports GL_ARB_gl_spirv.
+bool spirv_available();
+
+// Remove the #define lines of specializable constants (STEPS and EPSILON in
+// raymarch.glsl) from prelude and return them as constants instead, so every
+// value of them shares one module.
+std::string extract_spec_constants(const char* prelude, std::vector<spirv_constant>& constants);
+
+// Compile sources to SPIR-V with glslang, or load the module from
+// spirv_cache_dir if the same sources were compiled before, and specialize it
+// with constants. Uniform and output locations are assigned automatically.
+// Returns 0 on error, the caller is expected to fall back to GLSL.
+GLuint compile_spirv_shader(GLenum type, const shader_source_list& sources,
+                            const std::vector<spirv_constant>& constants);
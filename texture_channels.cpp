@@ -0,0 +1,275 @@
+#include "texture_channels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "image_decode.h"
+#include "shader_source.h"
+
+namespace {
+   // Staging buffers kept for reuse once their upload is done.
+   const size_t max_free_buffers = 4;
+}
+
+void texture_cache::init()
+{
+   destroy();
+   quit = false;
+   worker = std::thread(&texture_cache::work, this);
+
+   glGenBuffers(1, &pbo);
+   pbo_size = 0;
+   const unsigned char black[4] = { 0, 0, 0, 255 };
+   glGenTextures(1, &placeholder);
+   glBindTexture(GL_TEXTURE_2D, placeholder);
+   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, black);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+   glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void texture_cache::destroy()
+{
+   if (worker.joinable())
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         quit = true;
+      }
+      wake.notify_all();
+      worker.join();
+   }
+   for (auto& item : entries)
+   {
+      if (item.second.texture)
+         glDeleteTextures(1, &item.second.texture);
+   }
+   entries.clear();
+   if (!evicted.empty())
+      glDeleteTextures(GLsizei(evicted.size()), evicted.data());
+   evicted.clear();
+   uploads.clear();
+   requests.clear();
+   done.clear();
+   free_buffers.clear();
+   resident = 0;
+   for (std::string& channel : channels)
+      channel.clear();
+   if (pbo)
+      glDeleteBuffers(1, &pbo);
+   if (placeholder)
+      glDeleteTextures(1, &placeholder);
+   pbo = 0;
+   placeholder = 0;
+}
+
+void texture_cache::set_channel(int channel, const std::string& path)
+{
+   channels[channel] = path;
+   if (path.empty())
+      return;
+   auto found = entries.find(path);
+   if (found != entries.end() && found->second.status != state::failed)
+      return;
+   entry& e = entries[path];
+   e.status = state::decoding;
+   e.last_used = frame;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      requests.push_back(path);
+   }
+   wake.notify_one();
+}
+
+void texture_cache::work()
+{
+   for (;;)
+   {
+      std::string path;
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         wake.wait(lock, [this] { return quit || !requests.empty(); });
+         if (quit)
+            return;
+         path = std::move(requests.front());
+         requests.pop_front();
+      }
+
+      decoded image = { path, 0, 0, acquire_buffer() };
+      mapped_file file;
+      if (!file.map(path.c_str()) || !decode_image(file.data(), file.size(), image.width, image.height, *image.pixels))
+      {
+         fprintf(stderr, "Failed to load image %s\n", path.c_str());
+         release_buffer(std::move(image.pixels));
+      }
+
+      std::lock_guard<std::mutex> lock(mutex);
+      done.push_back(std::move(image));
+   }
+}
+
+std::unique_ptr<texture_cache::staging_buffer> texture_cache::acquire_buffer()
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   if (free_buffers.empty())
+      return std::unique_ptr<staging_buffer>(new staging_buffer);
+   std::unique_ptr<staging_buffer> buffer = std::move(free_buffers.back());
+   free_buffers.pop_back();
+   return buffer;
+}
+
+void texture_cache::release_buffer(std::unique_ptr<staging_buffer> buffer)
+{
+   std::lock_guard<std::mutex> lock(mutex);
+   if (buffer && free_buffers.size() < max_free_buffers)
+      free_buffers.push_back(std::move(buffer));
+}
+
+size_t texture_cache::texture_bytes(const entry& e)
+{
+   // A full mip chain adds a third.
+   return size_t(e.width) * e.height * 4 * 4 / 3;
+}
+
+size_t texture_cache::upload(entry& e, size_t budget)
+{
+   const size_t row_bytes = size_t(e.width) * 4;
+   const int rows = std::min(e.height - e.rows, int(std::max<size_t>(1, budget / row_bytes)));
+   const size_t bytes = row_bytes * rows;
+
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+   if (bytes > pbo_size)
+   {
+      pbo_size = bytes;
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, pbo_size, nullptr, GL_STREAM_DRAW);
+   }
+   // Invalidating orphans the storage the last slice is still read from
+   // instead of waiting for it.
+   void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+   if (staging)
+   {
+      memcpy(staging, e.pixels->data() + row_bytes * e.rows, bytes);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindTexture(GL_TEXTURE_2D, e.texture);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, e.rows, e.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      e.rows += rows;
+   }
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+   return bytes;
+}
+
+void texture_cache::update()
+{
+   ++frame;
+   std::vector<decoded> finished;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished.swap(done);
+   }
+   for (decoded& image : finished)
+   {
+      auto found = entries.find(image.path);
+      if (found == entries.end())
+      {
+         release_buffer(std::move(image.pixels));
+         continue;
+      }
+      entry& e = found->second;
+      if (!image.pixels)
+      {
+         e.status = state::failed;
+         continue;
+      }
+      e.status = state::uploading;
+      e.width = image.width;
+      e.height = image.height;
+      e.rows = 0;
+      e.pixels = std::move(image.pixels);
+      glGenTextures(1, &e.texture);
+      glBindTexture(GL_TEXTURE_2D, e.texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, e.width, e.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+      uploads.push_back(image.path);
+   }
+
+   size_t budget = upload_budget;
+   while (budget > 0 && !uploads.empty())
+   {
+      entry& e = entries[uploads.front()];
+      budget -= std::min(budget, upload(e, budget));
+      if (e.rows < e.height)
+         break;
+      glBindTexture(GL_TEXTURE_2D, e.texture);
+      glGenerateMipmap(GL_TEXTURE_2D);
+      release_buffer(std::move(e.pixels));
+      e.status = state::resident;
+      resident += texture_bytes(e);
+      uploads.pop_front();
+   }
+   glBindTexture(GL_TEXTURE_2D, 0);
+   evict();
+}
+
+void texture_cache::evict()
+{
+   while (resident > residency_budget)
+   {
+      auto victim = entries.end();
+      for (auto it = entries.begin(); it != entries.end(); ++it)
+      {
+         if (it->second.status != state::resident
+             || std::find(channels, channels + channel_count, it->first) != channels + channel_count)
+            continue;
+         if (victim == entries.end() || it->second.last_used < victim->second.last_used)
+            victim = it;
+      }
+      if (victim == entries.end())
+         return;
+      evicted.push_back(victim->second.texture);
+      resident -= texture_bytes(victim->second);
+      entries.erase(victim);
+   }
+}
+
+GLuint texture_cache::texture(int channel)
+{
+   auto found = channels[channel].empty() ? entries.end() : entries.find(channels[channel]);
+   if (found == entries.end() || found->second.status != state::resident)
+      return placeholder;
+   found->second.last_used = frame;
+   return found->second.texture;
+}
+
+std::vector<GLuint> texture_cache::take_evicted()
+{
+   std::vector<GLuint> taken;
+   taken.swap(evicted);
+   return taken;
+}
+
+texture_cache::state texture_cache::channel_state(int channel) const
+{
+   auto found = channels[channel].empty() ? entries.end() : entries.find(channels[channel]);
+   return found == entries.end() ? state::none : found->second.status;
+}
+
+void texture_cache::channel_size(int channel, int& width, int& height) const
+{
+   auto found = channels[channel].empty() ? entries.end() : entries.find(channels[channel]);
+   width = found == entries.end() ? 0 : found->second.width;
+   height = found == entries.end() ? 0 : found->second.height;
+}
+
+int texture_cache::pending() const
+{
+   int count = 0;
+   for (const auto& item : entries)
+      count += item.second.status == state::decoding || item.second.status == state::uploading;
+   return count;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Textures of the iChannel samplers. Images are decoded on a worker thread
+// into pooled staging buffers and uploaded through a pixel buffer a slice per
+// update(), so loading never stalls a frame. Loaded images stay resident,
+// keyed by path, until they exceed residency_budget.
+class texture_cache
+{
+public:
+   static const int channel_count = 4;
+
+   // Bytes of resident textures, mipmaps included, above which the least
+   // recently used ones not shown on a channel are deleted.
+   size_t residency_budget = size_t(256) << 20;
+   // Bytes uploaded per update().
+   size_t upload_budget = size_t(4) << 20;
+
+   texture_cache() = default;
+   texture_cache(const texture_cache&) = delete;
+   texture_cache& operator=(const texture_cache&) = delete;
+
+   // Start the worker and create the GL objects.
+   void init();
+   void destroy();
+
+   // Show the image at path on channel, loading it unless it is resident.
+   // An empty path clears the channel.
+   void set_channel(int channel, const std::string& path);
+   const std::string& channel_path(int channel) const { return channels[channel]; }
+
+   // Upload part of the decoded images and enforce the residency budget.
+   // Called once a frame.
+   void update();
+   // Texture of channel, a black placeholder unless it is resident. Counts as
+   // a use of the image for the residency budget.
+   GLuint texture(int channel);
+   // Textures evicted since the last call. Another thread may still draw
+   // with them, so deleting them is up to the caller.
+   std::vector<GLuint> take_evicted();
+
+   enum class state
+   {
+      none,
+      decoding,
+      uploading,
+      resident,
+      failed,
+   };
+   state channel_state(int channel) const;
+   // Size of the channel's image, 0 until it is decoded.
+   void channel_size(int channel, int& width, int& height) const;
+   size_t resident_bytes() const { return resident; }
+   // Images decoded or uploaded right now.
+   int pending() const;
+
+private:
+   typedef std::vector<unsigned char> staging_buffer;
+
+   struct entry
+   {
+      state status = state::decoding;
+      GLuint texture = 0;
+      int width = 0;
+      int height = 0;
+      // Rows uploaded so far.
+      int rows = 0;
+      std::unique_ptr<staging_buffer> pixels;
+      unsigned last_used = 0;
+   };
+
+   struct decoded
+   {
+      std::string path;
+      int width;
+      int height;
+      // Null if decoding failed.
+      std::unique_ptr<staging_buffer> pixels;
+   };
+
+   void work();
+   std::unique_ptr<staging_buffer> acquire_buffer();
+   void release_buffer(std::unique_ptr<staging_buffer> buffer);
+   // Upload up to budget bytes of e. Returns the bytes uploaded.
+   size_t upload(entry& e, size_t budget);
+   void evict();
+   static size_t texture_bytes(const entry& e);
+
+   std::string channels[channel_count];
+   std::map<std::string, entry> entries;
+   // Paths in the order their uploads are done.
+   std::deque<std::string> uploads;
+   size_t resident = 0;
+   unsigned frame = 0;
+   std::vector<GLuint> evicted;
+
+   GLuint pbo = 0;
+   size_t pbo_size = 0;
+   GLuint placeholder = 0;
+
+   // Shared with the worker.
+   std::thread worker;
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::deque<std::string> requests;
+   std::vector<decoded> done;
+   std::vector<std::unique_ptr<staging_buffer>> free_buffers;
+   bool quit = false;
+};
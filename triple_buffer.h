@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+
+// Hands the newest of a stream of values from one writer thread to one
+// reader thread without locks. Each side owns one of three buffers and the
+// third is swapped in and out atomically, so neither side ever waits and the
+// reader skips values published while it was busy.
+template <typename T>
+class triple_buffer
+{
+public:
+   // The buffer the writer fills. It holds whatever was last written to it,
+   // so its allocations can be reused.
+   T& write_buffer() { return buffers[back]; }
+
+   // Make the write buffer the newest value.
+   void publish() { back = middle.exchange(back | fresh, std::memory_order_acq_rel) & index_mask; }
+
+   // Take the newest value if one was published since the last call.
+   // Returns false if not, read_buffer() then holds the same value as before.
+   bool update()
+   {
+      if (!(middle.load(std::memory_order_acquire) & fresh))
+         return false;
+      front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+      return true;
+   }
+
+   // The buffer the reader uses, default constructed until the first
+   // update().
+   T& read_buffer() { return buffers[front]; }
+
+private:
+   static const unsigned index_mask = 3;
+   // Set in middle when it holds a value the reader has not taken yet.
+   static const unsigned fresh = 4;
+
+   T buffers[3];
+   unsigned back = 0;
+   std::atomic<unsigned> middle{ 1 };
+   unsigned front = 2;
+};
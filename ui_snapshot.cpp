@@ -0,0 +1,47 @@
+#include "ui_snapshot.h"
+
+#include <string.h>
+
+#include "extern/imgui_impl/imgui_impl_glfw_gl3.h"
+
+namespace {
+   template <typename T>
+   void copy_vector(const ImVector<T>& from, ImVector<T>& to)
+   {
+      to.resize(from.Size);
+      if (from.Size)
+         memcpy(to.Data, from.Data, size_t(from.Size) * sizeof(T));
+   }
+}
+
+void ui_snapshot::capture(const ImDrawData* draw_data, const ImVec2& display_size, const ImVec2& framebuffer_scale)
+{
+   this->display_size = display_size;
+   this->framebuffer_scale = framebuffer_scale;
+   const int count = draw_data && draw_data->Valid ? draw_data->CmdListsCount : 0;
+   // The copies only hold the buffers a renderer reads, so they need no
+   // shared data to build further commands.
+   while (int(lists.size()) < count)
+      lists.emplace_back(new ImDrawList(nullptr));
+   list_pointers.resize(count);
+   for (int i = 0; i < count; ++i)
+   {
+      const ImDrawList* from = draw_data->CmdLists[i];
+      ImDrawList* to = lists[i].get();
+      copy_vector(from->CmdBuffer, to->CmdBuffer);
+      copy_vector(from->IdxBuffer, to->IdxBuffer);
+      copy_vector(from->VtxBuffer, to->VtxBuffer);
+      list_pointers[i] = to;
+   }
+   data.Valid = true;
+   data.CmdLists = list_pointers.data();
+   data.CmdListsCount = count;
+   data.TotalVtxCount = count ? draw_data->TotalVtxCount : 0;
+   data.TotalIdxCount = count ? draw_data->TotalIdxCount : 0;
+}
+
+void ui_snapshot::render() const
+{
+   if (data.Valid)
+      ImGui_ImplGlfwGL3_RenderDrawData(&data, display_size, framebuffer_scale);
+}
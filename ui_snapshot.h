@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "extern/imgui/imgui.h"
+
+// A copy of a frame's ImGui draw data, so it can be rendered on another
+// thread while ImGui already builds the next frame. The draw lists are kept
+// between captures, so capturing does not allocate once they are big enough.
+class ui_snapshot
+{
+public:
+   // Copy draw_data, valid after ImGui::Render(), along with the display size
+   // it was laid out for.
+   void capture(const ImDrawData* draw_data, const ImVec2& display_size, const ImVec2& framebuffer_scale);
+   // Whether anything was captured yet.
+   bool valid() const { return data.Valid; }
+   // Render the copy with the ImGui binding's GL objects, which must belong
+   // to the current context.
+   void render() const;
+
+private:
+   std::vector<std::unique_ptr<ImDrawList>> lists;
+   std::vector<ImDrawList*> list_pointers;
+   ImDrawData data;
+   ImVec2 display_size;
+   ImVec2 framebuffer_scale;
+};
@@ -0,0 +1,374 @@
+#include "video_channel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+   const char y4m_magic[] = "YUV4MPEG2 ";
+
+   double elapsed_ms(std::chrono::steady_clock::time_point since)
+   {
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+   }
+
+   void smooth(double& average, double sample)
+   {
+      average = average > 0.0 ? average + (sample - average) * 0.05 : sample;
+   }
+
+   unsigned char clamp_byte(int value)
+   {
+      return (unsigned char)std::min(std::max(value, 0), 255);
+   }
+
+   size_t chroma_plane(const y4m_info& info)
+   {
+      if (!info.chroma_x)
+         return 0;
+      return size_t((info.width + info.chroma_x - 1) / info.chroma_x) * ((info.height + info.chroma_y - 1) / info.chroma_y);
+   }
+}
+
+bool parse_y4m(const char* data, size_t len, y4m_info& info)
+{
+   info = y4m_info();
+   const size_t magic_len = sizeof(y4m_magic) - 1;
+   const char* header_end = static_cast<const char*>(memchr(data, '\n', len));
+   if (len < magic_len || memcmp(data, y4m_magic, magic_len) != 0 || !header_end)
+      return false;
+
+   const std::string header(data + magic_len, header_end);
+   size_t pos = 0;
+   while (pos < header.size())
+   {
+      size_t end = header.find(' ', pos);
+      if (end == std::string::npos)
+         end = header.size();
+      const std::string token = header.substr(pos, end - pos);
+      pos = end + 1;
+      if (token.empty())
+         continue;
+      const char* value = token.c_str() + 1;
+      switch (token[0])
+      {
+      case 'W':
+         info.width = atoi(value);
+         break;
+      case 'H':
+         info.height = atoi(value);
+         break;
+      case 'F':
+      {
+         const double num = atof(value);
+         const char* colon = strchr(value, ':');
+         const double den = colon ? atof(colon + 1) : 1.0;
+         info.fps = den > 0.0 ? num / den : 0.0;
+         break;
+      }
+      case 'C':
+         if (!strcmp(value, "420") || !strcmp(value, "420jpeg") || !strcmp(value, "420paldv") || !strcmp(value, "420mpeg2"))
+            info.chroma_x = info.chroma_y = 2;
+         else if (!strcmp(value, "422"))
+         {
+            info.chroma_x = 2;
+            info.chroma_y = 1;
+         }
+         else if (!strcmp(value, "444"))
+            info.chroma_x = info.chroma_y = 1;
+         else if (!strcmp(value, "mono"))
+            info.chroma_x = info.chroma_y = 0;
+         else
+         {
+            fprintf(stderr, "Unsupported Y4M colorspace %s\n", value);
+            return false;
+         }
+         break;
+      }
+   }
+   if (info.width <= 0 || info.height <= 0)
+      return false;
+   if (info.fps <= 0.0)
+      info.fps = 30.0;
+
+   // Every frame starts with a FRAME line, which may carry parameters.
+   const size_t frame_bytes = size_t(info.width) * info.height + 2 * chroma_plane(info);
+   size_t offset = size_t(header_end - data) + 1;
+   while (offset + 6 <= len && !memcmp(data + offset, "FRAME", 5))
+   {
+      const char* line_end = static_cast<const char*>(memchr(data + offset, '\n', len - offset));
+      if (!line_end)
+         break;
+      const size_t plane = size_t(line_end - data) + 1;
+      if (len - plane < frame_bytes)
+         break;
+      info.frames.push_back(plane);
+      offset = plane + frame_bytes;
+   }
+   return !info.frames.empty();
+}
+
+void y4m_frame_to_rgba(const char* data, const y4m_info& info, size_t frame, unsigned char* rgba)
+{
+   const unsigned char* y_plane = reinterpret_cast<const unsigned char*>(data + info.frames[frame]);
+   const unsigned char* u_plane = y_plane + size_t(info.width) * info.height;
+   const unsigned char* v_plane = u_plane + chroma_plane(info);
+   const int chroma_width = info.chroma_x ? (info.width + info.chroma_x - 1) / info.chroma_x : 0;
+   for (int y = 0; y < info.height; ++y)
+   {
+      const unsigned char* luma = y_plane + size_t(y) * info.width;
+      unsigned char* dst = rgba + size_t(info.height - 1 - y) * info.width * 4;
+      const size_t chroma_row = info.chroma_x ? size_t(y / info.chroma_y) * chroma_width : 0;
+      for (int x = 0; x < info.width; ++x)
+      {
+         const int c = 298 * (int(luma[x]) - 16);
+         int d = 0, e = 0;
+         if (info.chroma_x)
+         {
+            const size_t i = chroma_row + x / info.chroma_x;
+            d = int(u_plane[i]) - 128;
+            e = int(v_plane[i]) - 128;
+         }
+         dst[0] = clamp_byte((c + 409 * e + 128) >> 8);
+         dst[1] = clamp_byte((c - 100 * d - 208 * e + 128) >> 8);
+         dst[2] = clamp_byte((c + 516 * d + 128) >> 8);
+         dst[3] = 255;
+         dst += 4;
+      }
+   }
+}
+
+bool video_channel::open(const char* path, double time)
+{
+   close();
+   if (!file.map(path))
+      return false;
+   if (!parse_y4m(file.data(), file.size(), stream))
+   {
+      fprintf(stderr, "Failed to read %s, only 8 bit Y4M is supported\n", path);
+      file.unmap();
+      return false;
+   }
+
+   const size_t frame_size = size_t(stream.width) * stream.height * 4;
+   for (slot& s : slots)
+   {
+      glGenBuffers(1, &s.pbo);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, frame_size, nullptr, GL_STREAM_DRAW);
+      glGenTextures(1, &s.texture);
+      glBindTexture(GL_TEXTURE_2D, s.texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, stream.width, stream.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+   }
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+   glBindTexture(GL_TEXTURE_2D, 0);
+
+   start_time = time;
+   next_decode = 0;
+   shown = -1;
+   statistics = stats();
+   quit = false;
+   worker = std::thread(&video_channel::work, this);
+   return true;
+}
+
+void video_channel::close()
+{
+   if (worker.joinable())
+   {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         quit = true;
+      }
+      wake.notify_all();
+      worker.join();
+   }
+   jobs.clear();
+   for (slot& s : slots)
+   {
+      if (s.mapped)
+      {
+         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+         glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      }
+      if (s.pbo)
+         glDeleteBuffers(1, &s.pbo);
+      if (s.texture)
+         glDeleteTextures(1, &s.texture);
+      s = slot();
+   }
+   file.unmap();
+   stream = y4m_info();
+   shown = -1;
+}
+
+void video_channel::work()
+{
+   for (;;)
+   {
+      int index;
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         wake.wait(lock, [this] { return quit || !jobs.empty(); });
+         if (quit)
+            return;
+         index = jobs.front();
+         jobs.pop_front();
+      }
+
+      slot& s = slots[index];
+      const auto start = std::chrono::steady_clock::now();
+      if (s.mapped)
+         y4m_frame_to_rgba(file.data(), stream, size_t(s.frame) % stream.frames.size(), static_cast<unsigned char*>(s.mapped));
+      const double ms = elapsed_ms(start);
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         s.decode_ms = ms;
+         s.status = slot_state::decoded;
+      }
+      decoded.notify_all();
+   }
+}
+
+void video_channel::upload(slot& s)
+{
+   const auto start = std::chrono::steady_clock::now();
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+   const bool intact = s.mapped && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+   s.mapped = nullptr;
+   if (intact)
+   {
+      glBindTexture(GL_TEXTURE_2D, s.texture);
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, stream.width, stream.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      glBindTexture(GL_TEXTURE_2D, 0);
+   }
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+   {
+      // A lost mapping leaves the slot to be decoded again.
+      std::lock_guard<std::mutex> lock(mutex);
+      s.status = intact ? slot_state::ready : slot_state::free;
+   }
+   smooth(statistics.decode_ms, s.decode_ms);
+   smooth(statistics.upload_ms, elapsed_ms(start));
+}
+
+long video_channel::due_frame(double time) const
+{
+   return std::max(0L, long(std::floor((time - start_time) * stream.fps)));
+}
+
+void video_channel::update(double time)
+{
+   if (!is_open())
+      return;
+
+   // The worker writes status, so it is only touched under mutex.
+   std::vector<int> finished;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (int i = 0; i < ring_size; ++i)
+      {
+         if (slots[i].status == slot_state::decoded)
+            finished.push_back(i);
+      }
+   }
+   for (int i : finished)
+      upload(slots[i]);
+
+   const long shown_frame = shown >= 0 ? slots[shown].frame : -1;
+   long due = due_frame(time);
+   if (sync == policy::block)
+      due = std::min(due, shown_frame + 1);
+   // Frames already late are not worth decoding.
+   if (sync == policy::drop)
+      next_decode = std::max(next_decode, due);
+
+   const size_t frame_size = size_t(stream.width) * stream.height * 4;
+   std::vector<int> idle;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (int i = 0; i < ring_size; ++i)
+      {
+         if (slots[i].status == slot_state::free)
+            idle.push_back(i);
+      }
+   }
+   for (int i : idle)
+   {
+      slot& s = slots[i];
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+      s.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frame_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+      s.frame = next_decode++;
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         s.status = slot_state::decoding;
+         jobs.push_back(i);
+      }
+      wake.notify_one();
+   }
+   glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+   if (sync == policy::block)
+   {
+      for (slot& s : slots)
+      {
+         if (s.frame != due)
+            continue;
+         std::unique_lock<std::mutex> lock(mutex);
+         if (s.status != slot_state::decoding && s.status != slot_state::decoded)
+            continue;
+         decoded.wait(lock, [&s] { return s.status == slot_state::decoded; });
+         lock.unlock();
+         upload(s);
+      }
+   }
+
+   int best = -1;
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (int i = 0; i < ring_size; ++i)
+      {
+         const slot& s = slots[i];
+         if (s.status == slot_state::ready && s.frame <= due && s.frame > shown_frame
+             && (best < 0 || s.frame > slots[best].frame))
+            best = i;
+      }
+   }
+   if (best >= 0)
+   {
+      const long frame = slots[best].frame;
+      if (shown_frame >= 0)
+         statistics.dropped += frame - shown_frame - 1;
+      smooth(statistics.late_ms, std::max(0.0, (time - start_time - frame / stream.fps) * 1000.0));
+      ++statistics.shown;
+      shown = best;
+   }
+
+   statistics.ahead = 0;
+   const long current = shown >= 0 ? slots[shown].frame : -1;
+   std::lock_guard<std::mutex> lock(mutex);
+   for (slot& s : slots)
+   {
+      if (s.status != slot_state::ready)
+         continue;
+      if (s.frame < current)
+         s.status = slot_state::free;
+      else if (s.frame > current)
+         ++statistics.ahead;
+   }
+}
+
+GLuint video_channel::texture() const
+{
+   return shown >= 0 ? slots[shown].texture : 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shader_source.h"
+
+// Layout of an uncompressed YUV4MPEG2 (.y4m) file.
+struct y4m_info
+{
+   int width = 0;
+   int height = 0;
+   double fps = 0.0;
+   // Chroma planes are (width + chroma_x - 1) / chroma_x by
+   // (height + chroma_y - 1) / chroma_y samples; 0 for monochrome.
+   int chroma_x = 2;
+   int chroma_y = 2;
+   // Offset of each frame's Y plane in the file.
+   std::vector<size_t> frames;
+};
+
+// Parse the stream header of a Y4M file and index its frames. Returns false
+// if data is no 8 bit 4:2:0, 4:2:2, 4:4:4 or mono stream.
+bool parse_y4m(const char* data, size_t len, y4m_info& info);
+
+// Convert frame of a Y4M file to RGBA8 rows, bottom row first, with BT.601
+// studio range coefficients.
+void y4m_frame_to_rgba(const char* data, const y4m_info& info, size_t frame, unsigned char* rgba);
+
+// A Y4M file played on one iChannel, looping, with frame n shown at
+// n / fps seconds after play(). A worker thread decodes frames ahead
+// straight into mapped pixel buffers of a ring of textures; update() unmaps
+// and uploads them. GL calls only happen on the calling thread.
+class video_channel
+{
+public:
+   // What to do when decoding cannot keep up with the clock.
+   enum class policy
+   {
+      // Skip to the frame due and count the skipped ones.
+      drop,
+      // Wait for each next frame, so the video runs slower than the clock.
+      block,
+   };
+
+   static const int ring_size = 4;
+
+   policy sync = policy::drop;
+   // Channel the video is bound to.
+   int channel = 0;
+
+   video_channel() = default;
+   video_channel(const video_channel&) = delete;
+   video_channel& operator=(const video_channel&) = delete;
+
+   // Open path and start playing at time. Returns false on error.
+   bool open(const char* path, double time);
+   void close();
+   bool is_open() const { return worker.joinable(); }
+   const y4m_info& info() const { return stream; }
+
+   // Take over decoded frames and hand free slots to the worker. Called once
+   // a frame with the time iTime is set to.
+   void update(double time);
+   // Texture of the frame shown, 0 until the first one is uploaded.
+   GLuint texture() const;
+
+   // Counters since open().
+   struct stats
+   {
+      // Moving averages of the worker's decode and the upload in update().
+      double decode_ms = 0.0;
+      double upload_ms = 0.0;
+      // Milliseconds between a frame being due and it being shown.
+      double late_ms = 0.0;
+      long shown = 0;
+      long dropped = 0;
+      // Frames decoded beyond the one shown.
+      int ahead = 0;
+   };
+   const stats& counters() const { return statistics; }
+
+private:
+   enum class slot_state
+   {
+      free,
+      decoding,
+      decoded,
+      ready,
+   };
+
+   struct slot
+   {
+      GLuint pbo = 0;
+      GLuint texture = 0;
+      slot_state status = slot_state::free;
+      // Frame number since open(), not wrapped to the file's frame count.
+      long frame = -1;
+      void* mapped = nullptr;
+      double decode_ms = 0.0;
+   };
+
+   void work();
+   void upload(slot& s);
+   long due_frame(double time) const;
+
+   mapped_file file;
+   y4m_info stream;
+   double start_time = 0.0;
+   long next_decode = 0;
+   // Slot shown, -1 before the first frame.
+   int shown = -1;
+   stats statistics;
+
+   // Shared with the worker.
+   std::thread worker;
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable decoded;
+   std::deque<int> jobs;
+   slot slots[ring_size];
+   bool quit = false;
+};
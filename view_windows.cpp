@@ -0,0 +1,95 @@
+#include "view_windows.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+#include "retire_queue.h"
+
+void view_windows::destroy()
+{
+   for (view_window& view : views)
+      glfwDestroyWindow(view.window);
+   views.clear();
+}
+
+void view_windows::open(GLFWwindow* share, int width, int height, double mouse_x, double mouse_y, int screen_w,
+                        int screen_h, GLFWkeyfun on_key)
+{
+   view_window view;
+   const std::string title = "SDF " + std::to_string(width) + "x" + std::to_string(height);
+   view.window = glfwCreateWindow(width, height, title.c_str(), nullptr, share);
+   if (!view.window)
+   {
+      fprintf(stderr, "Failed to create view window\n");
+      return;
+   }
+   glfwSetWindowUserPointer(view.window, glfwGetWindowUserPointer(share));
+   glfwSetKeyCallback(view.window, on_key);
+   glfwGetFramebufferSize(view.window, &view.width, &view.height);
+   view.mouse_x = mouse_x * view.width / std::max(screen_w, 1);
+   view.mouse_y = mouse_y * view.height / std::max(screen_h, 1);
+   views.push_back(view);
+}
+
+void view_windows::update()
+{
+   for (auto it = views.begin(); it != views.end();)
+   {
+      view_window& view = *it;
+      if (glfwWindowShouldClose(view.window))
+      {
+         GLFWwindow* closed = view.window;
+         retire([closed] { glfwDestroyWindow(closed); });
+         it = views.erase(it);
+         continue;
+      }
+      glfwGetFramebufferSize(view.window, &view.width, &view.height);
+      if (glfwGetMouseButton(view.window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+         glfwGetCursorPos(view.window, &view.mouse_x, &view.mouse_y);
+      ++it;
+   }
+}
+
+void view_drawing::draw(GLFWwindow* window, const std::vector<view_window>& views, const quad_program& prog,
+                        const scene_inputs& scene, const channel_bindings& channels, const frame_values& frame)
+{
+   // Closed views are left out of every frame the render thread takes once
+   // their windows may be destroyed.
+   for (auto it = vertex_arrays.begin(); it != vertex_arrays.end();)
+   {
+      const bool open = std::any_of(views.begin(), views.end(),
+                                    [it](const view_window& view) { return view.window == it->first; });
+      it = open ? std::next(it) : vertex_arrays.erase(it);
+   }
+   if (views.empty())
+      return;
+   for (const view_window& view : views)
+   {
+      glfwMakeContextCurrent(view.window);
+      GLuint& vao = vertex_arrays[view.window];
+      if (!vao)
+      {
+         // Only the main window waits for vertical sync, so presenting the
+         // views does not add a wait each.
+         glfwSwapInterval(0);
+         glGenVertexArrays(1, &vao);
+      }
+      glViewport(0, 0, view.width, view.height);
+      glClear(GL_COLOR_BUFFER_BIT);
+      if (prog.program)
+      {
+         glBindVertexArray(vao);
+         scene.bind();
+         channels.bind();
+         glUseProgram(prog.program);
+         set_frame_uniforms(prog, view.width, view.height, view.mouse_x, view.mouse_y, frame.shininess,
+                            frame.object_color);
+         draw_fullscreen();
+      }
+      glfwSwapBuffers(view.window);
+   }
+   glfwMakeContextCurrent(window);
+}
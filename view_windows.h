@@ -0,0 +1,65 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "frame_values.h"
+#include "quad_program.h"
+#include "scene_inputs.h"
+#include "shader_channels.h"
+
+// Another window showing what the main window shows, at its own size and
+// with its own camera. Its context shares objects with the main one, so
+// programs and textures are reused; bindings and vertex arrays are not
+// shared and are set up again in it by the render thread.
+struct view_window
+{
+   GLFWwindow* window = nullptr;
+   int width = 0;
+   int height = 0;
+   // iMouse, which only follows the cursor while dragging in the window.
+   double mouse_x = 0.0;
+   double mouse_y = 0.0;
+};
+
+// The views the UI thread opened. Only the main thread creates, tracks and
+// closes them.
+class view_windows
+{
+public:
+   std::vector<view_window> views;
+
+   void destroy();
+
+   // Open a view of width by height pixels looking where the main window's
+   // camera looks. share is the window whose context is current, on_key the
+   // view's key callback. The view takes the user pointer of share.
+   void open(GLFWwindow* share, int width, int height, double mouse_x, double mouse_y, int screen_w, int screen_h,
+             GLFWkeyfun on_key);
+   // Track the views' sizes and cursors and close the ones asked to close.
+   // The windows are destroyed once the render thread no longer draws them,
+   // which takes their vertex arrays with them.
+   void update();
+};
+
+// The render thread's side: a vertex array in each view's context, created
+// when it first draws the view.
+class view_drawing
+{
+public:
+   void destroy() { vertex_arrays.clear(); }
+
+   // Draw prog with the scene and channels of a frame into views and present
+   // them. Called after the main window is drawn and before it is presented,
+   // so the views' work queues behind the main window's and the only
+   // vertical sync wait is the main window's. Makes window's context current
+   // again.
+   void draw(GLFWwindow* window, const std::vector<view_window>& views, const quad_program& prog,
+             const scene_inputs& scene, const channel_bindings& channels, const frame_values& frame);
+
+private:
+   std::unordered_map<GLFWwindow*, GLuint> vertex_arrays;
+};